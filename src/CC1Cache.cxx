@@ -0,0 +1,333 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "CC1Cache.h"
+#include "Utils.h"
+
+#include <cxsys/SystemTools.hxx>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <map>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+# define CC1CacheEnviron _environ
+#else
+extern char** environ;
+# define CC1CacheEnviron environ
+#endif
+
+//----------------------------------------------------------------------------
+namespace {
+
+/// Environment variables that shells set to track their own state.
+/// They do not reach the driver's decisions and change between
+/// otherwise identical commands.
+const char* const CC1CacheVolatileEnvironment[] = {
+  "_", "OLDPWD", "SHLVL", 0
+};
+
+/// Directories below an installation root that the driver searches
+/// for GCC installations, each holding <triple>/<version>.
+const char* const CC1CacheGCCDirs[] = {
+  "lib/gcc", "lib/gcc-cross", "lib32/gcc", "lib64/gcc", "libx32/gcc",
+  "usr/lib/gcc", "usr/lib/gcc-cross", "usr/lib32/gcc", "usr/lib64/gcc",
+  "usr/libx32/gcc", 0
+};
+
+/// First line of a cache file.  Change it when the format changes.
+const char CC1CacheSignature[] = "castxml-cc1-cache 1\n";
+
+/// Jobs loaded or stored by this process.
+std::map<std::string, CC1Jobs> CC1CacheMemory;
+
+//----------------------------------------------------------------------------
+void hashString(llvm::MD5& md5, llvm::StringRef s)
+{
+  // Terminate each string so adjacent strings cannot run together.
+  md5.update(s);
+  md5.update(llvm::StringRef("", 1));
+}
+
+//----------------------------------------------------------------------------
+/// Hash the whole environment in a stable order.  The driver and the
+/// tools it runs read more variables than can be listed here.
+void hashEnvironment(llvm::MD5& md5)
+{
+  std::vector<std::string> env;
+  for (char** e = CC1CacheEnviron; e && *e; ++e) {
+    const char* eq = strchr(*e, '=');
+    std::string name(*e, eq? eq - *e : strlen(*e));
+    bool skip = false;
+    for (const char* const* v = CC1CacheVolatileEnvironment; *v; ++v) {
+      if (name == *v) {
+        skip = true;
+      }
+    }
+    if (!skip) {
+      env.push_back(*e);
+    }
+  }
+  std::sort(env.begin(), env.end());
+  for (std::string const& e : env) {
+    hashString(md5, e);
+  }
+}
+
+//----------------------------------------------------------------------------
+/// Get the value of a path option given either joined, as in
+/// "--sysroot=<path>", or as the next argument.
+bool pathOption(const char* const*& a, const char* const* argEnd,
+                const char* joined, const char* separate,
+                std::string& value)
+{
+  size_t const n = strlen(joined);
+  if (strncmp(*a, joined, n) == 0 && (*a)[n]) {
+    value = *a + n;
+    return true;
+  }
+  if (separate && strcmp(*a, separate) == 0 && a + 1 != argEnd) {
+    value = *++a;
+    return true;
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+/// Hash a path given to the driver as the file it resolves to, so that
+/// retargeting a symbolic link changes the key.
+void hashResolvedPath(llvm::MD5& md5, std::string const& path)
+{
+  hashString(md5, path);
+  hashString(md5, cxsys::SystemTools::GetRealPath(path));
+}
+
+//----------------------------------------------------------------------------
+/// Hash the GCC installations the driver can detect below a root: the
+/// target triple and version directories it chooses among.
+void hashGCCInstallations(llvm::MD5& md5, std::string const& root)
+{
+  hashResolvedPath(md5, root);
+  for (const char* const* d = CC1CacheGCCDirs; *d; ++d) {
+    llvm::SmallString<256> dir(root);
+    llvm::sys::path::append(dir, *d);
+    std::vector<std::string> found;
+    std::error_code ec;
+    for (llvm::sys::fs::directory_iterator t(dir.str(), ec), e;
+         t != e && !ec; t.increment(ec)) {
+      std::string triple = llvm::sys::path::filename(t->path()).str();
+      found.push_back(triple);
+      std::error_code vec;
+      for (llvm::sys::fs::directory_iterator v(t->path(), vec), ve;
+           v != ve && !vec; v.increment(vec)) {
+        found.push_back(triple + "/" +
+                        llvm::sys::path::filename(v->path()).str());
+      }
+    }
+    std::sort(found.begin(), found.end());
+    hashString(md5, dir.str());
+    for (std::string const& f : found) {
+      hashString(md5, f);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+std::string cacheFile(std::string const& dir, std::string const& key)
+{
+  llvm::SmallString<256> path(dir);
+  llvm::sys::path::append(path, key + ".cc1");
+  return std::string(path.str());
+}
+
+//----------------------------------------------------------------------------
+/// Parse an unsigned decimal number followed by a newline.
+bool parseSize(const char*& p, const char* end, size_t& n)
+{
+  n = 0;
+  const char* b = p;
+  for (; p != end && *p >= '0' && *p <= '9'; ++p) {
+    n = n * 10 + static_cast<size_t>(*p - '0');
+  }
+  if (p == b || p == end || *p != '\n') {
+    return false;
+  }
+  ++p;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+/// Parse a cache file.  It holds the signature and the number of jobs.
+/// Each job holds its number of arguments, and each argument its size
+/// and then its bytes, all on separate lines.
+bool parseJobs(llvm::StringRef data, CC1Jobs& jobs)
+{
+  if (!data.startswith(CC1CacheSignature)) {
+    return false;
+  }
+  const char* p = data.data() + sizeof(CC1CacheSignature) - 1;
+  const char* end = data.data() + data.size();
+  size_t njobs;
+  if (!parseSize(p, end, njobs)) {
+    return false;
+  }
+  jobs.clear();
+  for (size_t j = 0; j < njobs; ++j) {
+    size_t nargs;
+    if (!parseSize(p, end, nargs)) {
+      return false;
+    }
+    jobs.push_back(std::vector<std::string>());
+    std::vector<std::string>& args = jobs.back();
+    for (size_t a = 0; a < nargs; ++a) {
+      size_t size;
+      if (!parseSize(p, end, size) ||
+          static_cast<size_t>(end - p) < size + 1 || p[size] != '\n') {
+        return false;
+      }
+      args.push_back(std::string(p, size));
+      p += size + 1;
+    }
+  }
+  return p == end;
+}
+
+}
+
+//----------------------------------------------------------------------------
+std::string cc1CacheKey(const char* const* argBeg,
+                        const char* const* argEnd)
+{
+  llvm::MD5 md5;
+  hashString(md5, CC1CacheSignature);
+  hashString(md5, getVersionString());
+  hashString(md5, getClangResourceDir());
+  hashString(md5, llvm::sys::getDefaultTargetTriple());
+
+  // Relative paths in the arguments depend on the working directory.
+  llvm::SmallString<256> cwd;
+  if (!llvm::sys::fs::current_path(cwd)) {
+    hashString(md5, cwd);
+  }
+
+  hashEnvironment(md5);
+
+  // The driver finds the toolchain through the sysroot, an explicit
+  // GCC installation and program prefixes.  Hash the paths they
+  // resolve to and the GCC installations it could detect.
+  std::string sysroot;
+  std::string toolchain;
+  for (const char* const* a = argBeg; a != argEnd; ++a) {
+    std::string path;
+    if (pathOption(a, argEnd, "--sysroot=", "--sysroot", path) ||
+        pathOption(a, argEnd, "-isysroot", "-isysroot", path)) {
+      sysroot = path;
+    } else if (pathOption(a, argEnd, "--gcc-toolchain=", "-gcc-toolchain",
+                          path)) {
+      toolchain = path;
+    } else if (pathOption(a, argEnd, "-B", "-B", path)) {
+      hashResolvedPath(md5, path);
+    }
+  }
+  if (!sysroot.empty()) {
+    hashResolvedPath(md5, sysroot);
+  }
+  hashGCCInstallations(md5, !toolchain.empty()? toolchain :
+                       !sysroot.empty()? sysroot : "/");
+
+  hashString(md5, "");
+  for (const char* const* a = argBeg; a != argEnd; ++a) {
+    hashString(md5, *a);
+  }
+
+  llvm::MD5::MD5Result result;
+  md5.final(result);
+  llvm::SmallString<32> key;
+  llvm::MD5::stringifyResult(result, key);
+  return std::string(key.str());
+}
+
+//----------------------------------------------------------------------------
+bool cc1CacheLoad(std::string const& dir, std::string const& key,
+                  CC1Jobs& jobs)
+{
+  std::map<std::string, CC1Jobs>::const_iterator i =
+    CC1CacheMemory.find(key);
+  if (i != CC1CacheMemory.end()) {
+    jobs = i->second;
+    return true;
+  }
+  if (dir.empty()) {
+    return false;
+  }
+
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer> > buf =
+    llvm::MemoryBuffer::getFile(cacheFile(dir, key));
+  if (!buf || !parseJobs((*buf)->getBuffer(), jobs)) {
+    return false;
+  }
+  CC1CacheMemory[key] = jobs;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void cc1CacheStore(std::string const& dir, std::string const& key,
+                   CC1Jobs const& jobs)
+{
+  CC1CacheMemory[key] = jobs;
+  if (dir.empty()) {
+    return;
+  }
+
+  // Write a temporary file and rename it into place so that concurrent
+  // runs never see a partial entry.
+  std::string const file = cacheFile(dir, key);
+  llvm::SmallString<256> tmp;
+  int fd;
+  if (llvm::sys::fs::create_directories(dir) ||
+      llvm::sys::fs::createUniqueFile(file + ".tmp-%%%%%%%%", fd, tmp)) {
+    return;
+  }
+  {
+    llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+    os << CC1CacheSignature << jobs.size() << "\n";
+    for (std::vector<std::string> const& args : jobs) {
+      os << args.size() << "\n";
+      for (std::string const& a : args) {
+        os << a.size() << "\n" << a << "\n";
+      }
+    }
+    os.close();
+    if (os.has_error()) {
+      os.clear_error();
+      llvm::sys::fs::remove(tmp.str());
+      return;
+    }
+  }
+  if (llvm::sys::fs::rename(tmp.str(), file)) {
+    llvm::sys::fs::remove(tmp.str());
+  }
+}
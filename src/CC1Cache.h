@@ -0,0 +1,47 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+#ifndef CASTXML_CC1CACHE_H
+#define CASTXML_CC1CACHE_H
+
+#include <cxsys/Configure.hxx>
+
+#include <string>
+#include <vector>
+
+/// CC1Jobs - The cc1 argument vector of each job the Clang driver
+/// computes for one command line.
+typedef std::vector<std::vector<std::string> > CC1Jobs;
+
+/// cc1CacheKey - Compute the key identifying the driver result for the
+/// given driver command line.  The key also covers the castxml version,
+/// the Clang resource directory, the working directory, the default
+/// target, the environment, the paths the sysroot, GCC toolchain and
+/// program prefix options resolve to, and the GCC installations the
+/// driver can detect below the sysroot or toolchain.
+std::string cc1CacheKey(const char* const* argBeg,
+                        const char* const* argEnd);
+
+/// cc1CacheLoad - Get the jobs stored for a key, first from memory and
+/// then from the directory, if not empty.  Returns false on a miss.
+bool cc1CacheLoad(std::string const& dir, std::string const& key,
+                  CC1Jobs& jobs);
+
+/// cc1CacheStore - Store the jobs for a key in memory and in the
+/// directory, if not empty.  Failure to write the directory is ignored.
+void cc1CacheStore(std::string const& dir, std::string const& key,
+                   CC1Jobs const& jobs);
+
+#endif // CASTXML_CC1CACHE_H
@@ -16,6 +16,7 @@
 
 #include "Detect.h"
 #include "Options.h"
+#include "Probes.h"
 #include "Utils.h"
 
 #include "llvm/ADT/Triple.h"
@@ -55,6 +56,26 @@ static bool failedCC(const char* id,
   return false;
 }
 
+//----------------------------------------------------------------------------
+static bool runProbes(const char* id,
+                      std::vector<std::vector<const char*> >& cmds,
+                      std::vector<CommandResult>& results)
+{
+  // Run all the compiler commands at once.  Each must succeed.
+  for(std::vector<const char*>& cmd : cmds) {
+    cmd.push_back(0);
+  }
+  runCommands(cmds, results);
+  for(size_t i = 0; i < cmds.size(); ++i) {
+    cmds[i].pop_back();
+    CommandResult const& r = results[i];
+    if(!r.Ok || r.Ret != 0) {
+      return failedCC(id, cmds[i], r.Out, r.Err, r.Msg);
+    }
+  }
+  return true;
+}
+
 //----------------------------------------------------------------------------
 static void fixPredefines(Options& opts)
 {
@@ -114,25 +135,27 @@ static void setTriple(Options& opts)
 }
 
 //----------------------------------------------------------------------------
-static bool detectCC_GNU(const char* const* argBeg,
-                         const char* const* argEnd,
-                         Options& opts)
+static bool detectCC_GNU(std::vector<std::vector<const char*> >& cmds,
+                         std::vector<Options*> const& outs)
 {
   std::string const fwExplicitSuffix = " (framework directory)";
   std::string const fwImplicitSuffix = "/Frameworks";
-  std::vector<const char*> cc_args(argBeg, argEnd);
   std::string empty_cpp = getResourceDir() + "/empty.cpp";
-  int ret;
-  std::string out;
-  std::string err;
-  std::string msg;
-  cc_args.push_back("-E");
-  cc_args.push_back("-dM");
-  cc_args.push_back("-v");
-  cc_args.push_back(empty_cpp.c_str());
-  if(runCommand(int(cc_args.size()), &cc_args[0], ret, out, err, msg) &&
-     ret == 0) {
-    opts.Predefines = out;
+  for(std::vector<const char*>& cmd : cmds) {
+    cmd.push_back("-E");
+    cmd.push_back("-dM");
+    cmd.push_back("-v");
+    cmd.push_back(empty_cpp.c_str());
+  }
+  std::vector<CommandResult> results;
+  if(!runProbes("gnu", cmds, results)) {
+    return false;
+  }
+
+  for(size_t t = 0; t < outs.size(); ++t) {
+    Options& opts = *outs[t];
+    opts.Predefines = results[t].Out;
+    std::string const& err = results[t].Err;
     const char* start_line = "#include <...> search starts here:";
     if(const char* c = strstr(err.c_str(), start_line)) {
       if((c = strchr(c, '\n'), c++)) {
@@ -166,29 +189,28 @@ static bool detectCC_GNU(const char* const* argBeg,
     }
     fixPredefines(opts);
     setTriple(opts);
-    return true;
-  } else {
-    return failedCC("gnu", cc_args, out, err, msg);
   }
+  return true;
 }
 
 //----------------------------------------------------------------------------
-static bool detectCC_MSVC(const char* const* argBeg,
-                          const char* const* argEnd,
-                          Options& opts)
+static bool detectCC_MSVC(std::vector<std::vector<const char*> >& cmds,
+                          std::vector<Options*> const& outs)
 {
-  std::vector<const char*> cc_args(argBeg, argEnd);
   std::string detect_vs_cpp = getResourceDir() + "/detect_vs.cpp";
-  int ret;
-  std::string out;
-  std::string err;
-  std::string msg;
-  cc_args.push_back("-c");
-  cc_args.push_back("-FoNUL");
-  cc_args.push_back(detect_vs_cpp.c_str());
-  if(runCommand(int(cc_args.size()), &cc_args[0], ret, out, err, msg) &&
-     ret == 0) {
-    if(const char* predefs = strstr(out.c_str(), "\n#define")) {
+  for(std::vector<const char*>& cmd : cmds) {
+    cmd.push_back("-c");
+    cmd.push_back("-FoNUL");
+    cmd.push_back(detect_vs_cpp.c_str());
+  }
+  std::vector<CommandResult> results;
+  if(!runProbes("msvc", cmds, results)) {
+    return false;
+  }
+
+  for(size_t t = 0; t < outs.size(); ++t) {
+    Options& opts = *outs[t];
+    if(const char* predefs = strstr(results[t].Out.c_str(), "\n#define")) {
       opts.Predefines = predefs+1;
     }
     if(const char* includes_str = cxsys::SystemTools::GetEnv("INCLUDE")) {
@@ -205,10 +227,8 @@ static bool detectCC_MSVC(const char* const* argBeg,
     }
     fixPredefines(opts);
     setTriple(opts);
-    return true;
-  } else {
-    return failedCC("msvc", cc_args, out, err, msg);
   }
+  return true;
 }
 
 //----------------------------------------------------------------------------
@@ -217,12 +237,53 @@ bool detectCC(const char* id,
               const char* const* argEnd,
               Options& opts)
 {
+  CASTXML_PROBE1(detect__start, id);
+
+  // Probe the compiler once, or once for each target with '{triple}'
+  // in its command replaced by the target.  The probes of all targets
+  // run at once.
+  std::vector<std::vector<const char*> > cmds;
+  std::vector<Options*> outs;
+  std::vector<Options> targetOpts(opts.Targets.size());
+  std::vector<std::string> targetArgs;
+  if(opts.Targets.empty()) {
+    cmds.push_back(std::vector<const char*>(argBeg, argEnd));
+    outs.push_back(&opts);
+  } else {
+    targetArgs.reserve(opts.Targets.size() * (argEnd - argBeg));
+    for(size_t t = 0; t < opts.Targets.size(); ++t) {
+      std::vector<const char*> cmd;
+      for(const char* const* a = argBeg; a != argEnd; ++a) {
+        std::string arg = *a;
+        std::string::size_type pos = arg.find("{triple}");
+        if(pos != std::string::npos) {
+          arg.replace(pos, 8, opts.Targets[t]);
+        }
+        targetArgs.push_back(arg);
+        cmd.push_back(targetArgs.back().c_str());
+      }
+      cmds.push_back(cmd);
+      outs.push_back(&targetOpts[t]);
+    }
+  }
+
+  bool ok;
   if(strcmp(id, "gnu") == 0) {
-    return detectCC_GNU(argBeg, argEnd, opts);
+    ok = detectCC_GNU(cmds, outs);
   } else if(strcmp(id, "msvc") == 0) {
-    return detectCC_MSVC(argBeg, argEnd, opts);
+    ok = detectCC_MSVC(cmds, outs);
   } else {
     std::cerr << "error: '--castxml-cc-" << id << "' not known!\n";
-    return false;
+    ok = false;
+  }
+
+  for(Options const& to : targetOpts) {
+    Options::TargetCC cc;
+    cc.Includes = to.Includes;
+    cc.Predefines = to.Predefines;
+    cc.Triple = to.Triple;
+    opts.TargetCCs.push_back(cc);
   }
+  CASTXML_PROBE2(detect__done, id, ok);
+  return ok;
 }
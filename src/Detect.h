@@ -18,7 +18,8 @@
 
 struct Options;
 
-/// detectCC - Detect settings from given compiler command.
+/// detectCC - Detect settings from given compiler command, or into
+/// opts.TargetCCs once for each of opts.Targets.
 
 bool detectCC(const char* id,
               const char* const* argBeg,
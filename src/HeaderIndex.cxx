@@ -0,0 +1,226 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "HeaderIndex.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <fstream>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// The file holds the signature and then, for each directory, a line
+// with its modification time, the time it was listed, and its path,
+// followed by one line per entry name, each starting with a tab.
+static const char HeaderIndexSignature[] = "castxml-header-index 1";
+
+//----------------------------------------------------------------------------
+static llvm::StringRef trimSeparators(llvm::StringRef dir)
+{
+  while (dir.size() > 1 &&
+         llvm::sys::path::is_separator(dir[dir.size() - 1])) {
+    dir = dir.drop_back();
+  }
+  return dir;
+}
+
+//----------------------------------------------------------------------------
+HeaderIndex::HeaderIndex(std::string const& file): File(file), Dirty(false)
+{
+  this->Load();
+}
+
+//----------------------------------------------------------------------------
+void HeaderIndex::AddRoot(std::string const& dir)
+{
+  this->Roots.insert(trimSeparators(dir).str());
+  this->Unrooted.clear();
+}
+
+//----------------------------------------------------------------------------
+void HeaderIndex::Invalidate()
+{
+  for (ListingMap::iterator i = this->Listings.begin(),
+         e = this->Listings.end(); i != e; ++i) {
+    i->second.Checked = false;
+  }
+  this->Unrooted.clear();
+}
+
+//----------------------------------------------------------------------------
+void HeaderIndex::Load()
+{
+  std::ifstream fin(this->File.c_str());
+  std::string line;
+  if (!std::getline(fin, line) || line != HeaderIndexSignature) {
+    return;
+  }
+  Listing* l = 0;
+  while (std::getline(fin, line)) {
+    if (!line.empty() && line[0] == '\t') {
+      if (l) {
+        l->Names.insert(line.substr(1));
+      }
+      continue;
+    }
+    l = 0;
+    long long time;
+    long long listedAt;
+    char path[4096];
+    if (sscanf(line.c_str(), "%lld %lld %4095[^\n]",
+               &time, &listedAt, path) == 3) {
+      l = &this->Listings[path];
+      l->Time = time;
+      l->ListedAt = listedAt;
+      l->Loaded = true;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+bool HeaderIndex::Save()
+{
+  if (!this->Dirty) {
+    return true;
+  }
+  // Write a temporary file and rename it into place so that concurrent
+  // runs never see a partial file.
+  llvm::SmallString<256> tmp;
+  int fd;
+  if (llvm::sys::fs::createUniqueFile(this->File + ".tmp-%%%%%%%%",
+                                      fd, tmp)) {
+    return false;
+  }
+  {
+    llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+    os << HeaderIndexSignature << "\n";
+    for (ListingMap::const_iterator i = this->Listings.begin(),
+           e = this->Listings.end(); i != e; ++i) {
+      Listing const& l = i->second;
+      if (!l.Loaded || l.Missing) {
+        continue;
+      }
+      os << l.Time << " " << l.ListedAt << " " << i->first << "\n";
+      for (std::string const& n : l.Names) {
+        os << "\t" << n << "\n";
+      }
+    }
+    os.close();
+    if (os.has_error()) {
+      os.clear_error();
+      llvm::sys::fs::remove(tmp.str());
+      return false;
+    }
+  }
+  if (llvm::sys::fs::rename(tmp.str(), this->File)) {
+    llvm::sys::fs::remove(tmp.str());
+    return false;
+  }
+  this->Dirty = false;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool HeaderIndex::IsMissing(llvm::StringRef path)
+{
+  llvm::StringRef name = llvm::sys::path::filename(path);
+  if (name.empty() || name == "." || name == "..") {
+    return false;
+  }
+  Listing const* l = this->GetListing(llvm::sys::path::parent_path(path));
+  return l && (l->Missing || (l->Loaded && !l->Names.count(name.str())));
+}
+
+//----------------------------------------------------------------------------
+HeaderIndex::Listing const* HeaderIndex::GetListing(llvm::StringRef dir)
+{
+  dir = trimSeparators(dir);
+  if (dir.empty()) {
+    return 0;
+  }
+  std::string const key = dir.str();
+  ListingMap::iterator i = this->Listings.find(key);
+  if (i != this->Listings.end() && i->second.Checked) {
+    return &i->second;
+  }
+  if (this->Unrooted.count(key)) {
+    return 0;
+  }
+
+  // A directory below a root exists only if listed by its parent.
+  if (!this->Roots.count(key)) {
+    llvm::StringRef name = llvm::sys::path::filename(dir);
+    llvm::StringRef parent = llvm::sys::path::parent_path(dir);
+    Listing const* up = 0;
+    if (name != "." && name != ".." && parent != dir) {
+      up = this->GetListing(parent);
+    }
+    if (!up) {
+      this->Unrooted.insert(key);
+      return 0;
+    }
+    if (up->Missing || (up->Loaded && !up->Names.count(name.str()))) {
+      Listing& l = this->Listings[key];
+      l.Checked = true;
+      l.Missing = true;
+      return &l;
+    }
+  }
+
+  Listing& l = this->Listings[key];
+  this->Refresh(key, l);
+  l.Checked = true;
+  return &l;
+}
+
+//----------------------------------------------------------------------------
+void HeaderIndex::Refresh(std::string const& dir, Listing& l)
+{
+  l.Missing = false;
+  struct stat st;
+  if (stat(dir.c_str(), &st) != 0 || (st.st_mode & S_IFMT) != S_IFDIR) {
+    l.Missing = true;
+    return;
+  }
+
+  // Trust a listing only if taken after the second in which the
+  // directory was last modified, since times have whole seconds.
+  long long time = static_cast<long long>(st.st_mtime);
+  if (l.Loaded && l.Time == time && l.Time < l.ListedAt) {
+    return;
+  }
+
+  l.Names.clear();
+  l.Time = time;
+  l.ListedAt = static_cast<long long>(::time(0));
+  std::error_code ec;
+  for (llvm::sys::fs::directory_iterator d(dir, ec), e; d != e && !ec;
+       d.increment(ec)) {
+    l.Names.insert(llvm::sys::path::filename(d->path()).str());
+  }
+  if (ec) {
+    // Fall back to the file system for this directory.
+    l.Loaded = false;
+    l.Names.clear();
+    return;
+  }
+  l.Loaded = true;
+  this->Dirty = true;
+}
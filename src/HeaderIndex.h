@@ -0,0 +1,75 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+#ifndef CASTXML_HEADERINDEX_H
+#define CASTXML_HEADERINDEX_H
+
+#include <cxsys/Configure.hxx>
+
+#include "llvm/ADT/StringRef.h"
+
+#include <map>
+#include <set>
+#include <string>
+
+/// HeaderIndex - Listings of include directories and the directories
+/// below them, kept in a file across runs.  Used to answer that a path
+/// probed during header search does not exist without asking the file
+/// system.  A listing is reused only while the modification time of its
+/// directory is unchanged.
+class HeaderIndex
+{
+public:
+  HeaderIndex(std::string const& file);
+
+  /// Add an include directory below which paths are answered.
+  void AddRoot(std::string const& dir);
+
+  /// Check directories again on next use, for a process that outlives
+  /// changes to them.
+  void Invalidate();
+
+  /// Whether a path is known not to exist.  False if it exists or if it
+  /// is not below an include directory.
+  bool IsMissing(llvm::StringRef path);
+
+  /// Save listings to the file if any changed.  Returns false on failure.
+  bool Save();
+
+private:
+  struct Listing {
+    Listing(): Time(0), ListedAt(0), Loaded(false), Checked(false),
+               Missing(false) {}
+    long long Time;
+    long long ListedAt;
+    std::set<std::string> Names;
+    bool Loaded;
+    bool Checked;
+    bool Missing;
+  };
+  typedef std::map<std::string, Listing> ListingMap;
+
+  std::string File;
+  std::set<std::string> Roots;
+  ListingMap Listings;
+  std::set<std::string> Unrooted;
+  bool Dirty;
+
+  void Load();
+  Listing const* GetListing(llvm::StringRef dir);
+  void Refresh(std::string const& dir, Listing& l);
+};
+
+#endif // CASTXML_HEADERINDEX_H
@@ -0,0 +1,135 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "InstantiationProfile.h"
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <vector>
+
+#if defined(_WIN32)
+# define NOMINMAX
+# include <windows.h>
+#else
+# include <sys/resource.h>
+# include <sys/time.h>
+#endif
+
+//----------------------------------------------------------------------------
+/// CPU time used by this process so far, in user and system mode, so
+/// that time spent waiting for the processor or for I/O is not counted.
+static double profileSeconds()
+{
+#if defined(_WIN32)
+  FILETIME creation, exited, kernel, user;
+  if(!GetProcessTimes(GetCurrentProcess(), &creation, &exited,
+                      &kernel, &user)) {
+    return 0;
+  }
+  ULARGE_INTEGER k, u;
+  k.LowPart = kernel.dwLowDateTime;
+  k.HighPart = kernel.dwHighDateTime;
+  u.LowPart = user.dwLowDateTime;
+  u.HighPart = user.dwHighDateTime;
+  // FILETIME counts 100 ns units.
+  return double(k.QuadPart + u.QuadPart) * 1e-7;
+#else
+  struct rusage usage;
+  if(getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+    (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+//----------------------------------------------------------------------------
+InstantiationProfile::InstantiationProfile(unsigned long long limit):
+  Limit(limit), Total(0), TotalSeconds(0), Timed(false), Last(0)
+{
+}
+
+//----------------------------------------------------------------------------
+void InstantiationProfile::SetPhase(std::string const& phase, bool timed)
+{
+  this->Phase = phase;
+  this->Timed = timed;
+  this->Last = timed? profileSeconds() : 0;
+}
+
+//----------------------------------------------------------------------------
+bool InstantiationProfile::Record(std::string const& name)
+{
+  Entry& e = this->Entries[name];
+  ++e.Count;
+  ++e.Phases[this->Phase];
+  if (this->Timed) {
+    double now = profileSeconds();
+    e.Seconds += now - this->Last;
+    e.Timed = true;
+    this->TotalSeconds += now - this->Last;
+    this->Last = now;
+  }
+  ++this->Total;
+  return !this->Limit || this->Total <= this->Limit;
+}
+
+//----------------------------------------------------------------------------
+void InstantiationProfile::Report(llvm::raw_ostream& os,
+                                  std::string const& input,
+                                  size_t top) const
+{
+  // Order by count, which is known for every phase, and then by time.
+  std::vector<EntryMap::const_iterator> order;
+  for (EntryMap::const_iterator i = this->Entries.begin();
+       i != this->Entries.end(); ++i) {
+    order.push_back(i);
+  }
+  size_t const n = std::min(top, order.size());
+  std::partial_sort(order.begin(), order.begin() + n, order.end(),
+                    [](EntryMap::const_iterator a,
+                       EntryMap::const_iterator b) {
+                      if (a->second.Count != b->second.Count) {
+                        return a->second.Count > b->second.Count;
+                      }
+                      return a->second.Seconds > b->second.Seconds;
+                    });
+
+  os << "castxml: " << input << ": " << this->Total
+     << " template instantiations of " << this->Entries.size()
+     << " templates in " << llvm::format("%.3f", this->TotalSeconds)
+     << " s of CPU time\n";
+  for (size_t i = 0; i < n; ++i) {
+    Entry const& e = order[i]->second;
+    std::map<std::string, unsigned long long>::const_iterator p =
+      e.Phases.begin();
+    for (std::map<std::string, unsigned long long>::const_iterator
+           j = e.Phases.begin(); j != e.Phases.end(); ++j) {
+      if (j->second > p->second) {
+        p = j;
+      }
+    }
+    if (e.Timed) {
+      os << llvm::format("%10llu %9.3f s  ", e.Count, e.Seconds);
+    } else {
+      os << llvm::format("%10llu         - s  ", e.Count);
+    }
+    os << order[i]->first << "  (" << p->second << " by " << p->first
+       << ")\n";
+  }
+}
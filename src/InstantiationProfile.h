@@ -0,0 +1,75 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+#ifndef CASTXML_INSTANTIATIONPROFILE_H
+#define CASTXML_INSTANTIATIONPROFILE_H
+
+#include <cxsys/Configure.hxx>
+
+#include <map>
+#include <string>
+
+namespace llvm { class raw_ostream; }
+
+/// InstantiationProfile - Count the template instantiations of one
+/// source per template and measure the CPU time spent on them.  Each
+/// is attributed to the phase of processing that triggered it, such as
+/// adding the implicit members of a class.
+class InstantiationProfile
+{
+public:
+  InstantiationProfile(unsigned long long limit);
+
+  /// Start attributing instantiations to the given phase.  Time is
+  /// measured only within phases that are timed, from the start of the
+  /// phase or the previous instantiation to the next instantiation.
+  /// Instantiations are only seen once complete, so an instantiation
+  /// nested in another is counted once, as the self time of the one
+  /// that completed first, and the outer one gets only the rest.
+  void SetPhase(std::string const& phase, bool timed);
+
+  /// Record an instantiation of the named template.  Returns false
+  /// when the limit given to the constructor, if any, is exceeded.
+  bool Record(std::string const& name);
+
+  /// Total number of instantiations recorded.
+  unsigned long long Count() const { return this->Total; }
+
+  /// Write the given number of templates instantiated most often, with
+  /// the time spent on them and the phase that triggered most of their
+  /// instantiations.  Time is shown only for templates instantiated in
+  /// a timed phase.
+  void Report(llvm::raw_ostream& os, std::string const& input,
+              size_t top) const;
+
+private:
+  struct Entry {
+    Entry(): Count(0), Seconds(0), Timed(false) {}
+    unsigned long long Count;
+    double Seconds;
+    bool Timed;
+    std::map<std::string, unsigned long long> Phases;
+  };
+  typedef std::map<std::string, Entry> EntryMap;
+  EntryMap Entries;
+  unsigned long long Limit;
+  unsigned long long Total;
+  double TotalSeconds;
+  std::string Phase;
+  bool Timed;
+  double Last;
+};
+
+#endif // CASTXML_INSTANTIATIONPROFILE_H
@@ -0,0 +1,145 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "JobHistory.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <fstream>
+#include <sstream>
+
+// Each line of a history file holds the seconds, peak memory in KiB,
+// and size in bytes measured for one source file, followed by its path.
+static const char JobHistorySignature[] = "# castxml job history 1";
+
+//----------------------------------------------------------------------------
+static unsigned long long fileSize(std::string const& file)
+{
+  uint64_t size = 0;
+  if (llvm::sys::fs::file_size(file, size)) {
+    return 0;
+  }
+  return size;
+}
+
+//----------------------------------------------------------------------------
+void JobHistory::Load(std::string const& file)
+{
+  std::ifstream fin(file.c_str());
+  std::string line;
+  if (!std::getline(fin, line) || line != JobHistorySignature) {
+    return;
+  }
+  while (std::getline(fin, line)) {
+    std::istringstream in(line);
+    Entry e;
+    std::string path;
+    if (in >> e.Seconds >> e.PeakKB >> e.Size &&
+        in.get() == ' ' && std::getline(in, path) && !path.empty()) {
+      this->Entries[path] = e;
+    }
+  }
+  this->UpdateRate();
+}
+
+//----------------------------------------------------------------------------
+bool JobHistory::Save(std::string const& file) const
+{
+  // Write a temporary file and rename it into place so that a
+  // concurrent run never reads a partial history.
+  llvm::SmallString<256> tmp;
+  int fd;
+  if (llvm::sys::fs::createUniqueFile(file + ".tmp-%%%%%%%%", fd, tmp)) {
+    return false;
+  }
+  {
+    llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+    os << JobHistorySignature << "\n";
+    for (EntryMap::const_iterator i = this->Entries.begin(),
+           e = this->Entries.end(); i != e; ++i) {
+      os << llvm::format("%.3f", i->second.Seconds) << " "
+         << i->second.PeakKB << " " << i->second.Size << " "
+         << i->first << "\n";
+    }
+    os.close();
+    if (os.has_error()) {
+      os.clear_error();
+      llvm::sys::fs::remove(tmp.str());
+      return false;
+    }
+  }
+  if (llvm::sys::fs::rename(tmp.str(), file)) {
+    llvm::sys::fs::remove(tmp.str());
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+double JobHistory::Estimate(std::string const& input) const
+{
+  EntryMap::const_iterator i = this->Entries.find(input);
+  if (i != this->Entries.end()) {
+    return i->second.Seconds;
+  }
+  // Without history the size alone still orders files among themselves.
+  double rate = this->SecondsPerByte > 0? this->SecondsPerByte : 1e-6;
+  return rate * static_cast<double>(fileSize(input));
+}
+
+//----------------------------------------------------------------------------
+unsigned long long
+JobHistory::EstimatePeakKB(std::string const& input) const
+{
+  EntryMap::const_iterator i = this->Entries.find(input);
+  if (i != this->Entries.end() && i->second.PeakKB > 0) {
+    return i->second.PeakKB;
+  }
+  // Assume the worst so that an unknown file cannot overcommit memory.
+  return this->MaxPeakKB;
+}
+
+//----------------------------------------------------------------------------
+void JobHistory::Record(std::string const& input, double seconds,
+                        unsigned long long peakKB)
+{
+  Entry& e = this->Entries[input];
+  e.Seconds = seconds;
+  e.PeakKB = peakKB;
+  e.Size = fileSize(input);
+}
+
+//----------------------------------------------------------------------------
+void JobHistory::UpdateRate()
+{
+  double seconds = 0;
+  double bytes = 0;
+  this->MaxPeakKB = 0;
+  for (EntryMap::const_iterator i = this->Entries.begin(),
+         e = this->Entries.end(); i != e; ++i) {
+    if (i->second.PeakKB > this->MaxPeakKB) {
+      this->MaxPeakKB = i->second.PeakKB;
+    }
+    if (i->second.Size > 0) {
+      seconds += i->second.Seconds;
+      bytes += static_cast<double>(i->second.Size);
+    }
+  }
+  this->SecondsPerByte = bytes > 0? seconds / bytes : 0;
+}
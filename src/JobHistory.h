@@ -0,0 +1,69 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+#ifndef CASTXML_JOBHISTORY_H
+#define CASTXML_JOBHISTORY_H
+
+#include <cxsys/Configure.hxx>
+
+#include <map>
+#include <string>
+
+/// JobHistory - Processing time and peak memory of each source file
+/// measured by earlier runs, stored in a small text file.  Used to
+/// start the most expensive sources of a batch first.
+class JobHistory
+{
+public:
+  JobHistory(): SecondsPerByte(0), MaxPeakKB(0) {}
+
+  /// Load entries from a file.  A missing file is an empty history.
+  void Load(std::string const& file);
+
+  /// Save all entries to a file.  Returns false on failure.
+  bool Save(std::string const& file) const;
+
+  /// Estimate the seconds needed to process a source file.  Files not
+  /// yet measured are estimated from their size.
+  double Estimate(std::string const& input) const;
+
+  /// Estimate the peak memory in KiB needed to process a source file.
+  /// Files not yet measured are estimated by the largest peak recorded
+  /// for any file, or 0 without any.
+  unsigned long long EstimatePeakKB(std::string const& input) const;
+
+  /// Record a measurement for a source file.
+  void Record(std::string const& input, double seconds,
+              unsigned long long peakKB);
+
+private:
+  struct Entry {
+    Entry(): Seconds(0), PeakKB(0), Size(0) {}
+    double Seconds;
+    unsigned long long PeakKB;
+    unsigned long long Size;
+  };
+  typedef std::map<std::string, Entry> EntryMap;
+  EntryMap Entries;
+
+  /// Ratio of measured time to file size over all entries.
+  double SecondsPerByte;
+
+  /// Largest peak memory over all entries.
+  unsigned long long MaxPeakKB;
+  void UpdateRate();
+};
+
+#endif // CASTXML_JOBHISTORY_H
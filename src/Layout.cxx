@@ -0,0 +1,323 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "Layout.h"
+#include "Options.h"
+#include "Output.h"
+#include "Utils.h"
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/AST/RecordLayout.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/Utils.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <memory>
+#include <queue>
+#include <string>
+
+//----------------------------------------------------------------------------
+class LayoutVisitor
+{
+  clang::CompilerInstance& CI;
+  clang::ASTContext const& CTX;
+  llvm::raw_ostream& OS;
+  Options const& Opts;
+
+  /// Map from record definition to the id of its output element.
+  typedef std::map<clang::RecordDecl const*, unsigned int> RecordIdMap;
+  RecordIdMap RecordIds;
+
+  /// Records that have an id but have not yet been printed.
+  std::queue<clang::RecordDecl const*> Queue;
+
+  /// Get the id of a record, queuing it for output on first use.
+  /// Returns 0 for records that have no layout.
+  unsigned int AddRecord(clang::RecordDecl const* rd);
+
+  /// Add the record, if any, whose objects are stored by a value of
+  /// the given type.
+  unsigned int AddType(clang::QualType t);
+
+  /// Add records defined in a context and all nested contexts.
+  void AddContext(clang::DeclContext const* dc);
+
+  /// Add the complete specializations of a class template.
+  void AddClassTemplate(clang::ClassTemplateDecl const* td);
+
+  /// Add records reachable from one starting declaration.
+  void AddStartDecl(clang::Decl const* d);
+
+  /// Lookup and add starting declarations by qualified name.
+
+  /// Print one record and add records it refers to.
+  void OutputRecord(clang::RecordDecl const* rd, unsigned int id);
+
+  /// Print the attribute naming a declaration, if it has a name.
+  void PrintNameAttribute(clang::NamedDecl const* d);
+
+public:
+  LayoutVisitor(clang::CompilerInstance& ci,
+                clang::ASTContext const& ctx,
+                llvm::raw_ostream& os,
+                Options const& opts):
+    CI(ci), CTX(ctx), OS(os), Opts(opts) {}
+
+  /// Visit declarations starting at a translation unit.
+  void HandleTranslationUnit(clang::TranslationUnitDecl const* tu,
+                             std::vector<clang::Decl const*> const& starts);
+};
+
+//----------------------------------------------------------------------------
+unsigned int LayoutVisitor::AddRecord(clang::RecordDecl const* rd)
+{
+  rd = rd->getDefinition();
+  if(!rd || rd->isInvalidDecl() || rd->isDependentType()) {
+    return 0;
+  }
+
+  RecordIdMap::iterator i = this->RecordIds.find(rd);
+  if(i != this->RecordIds.end()) {
+    return i->second;
+  }
+
+  unsigned int id = static_cast<unsigned int>(this->RecordIds.size()) + 1;
+  this->RecordIds[rd] = id;
+  this->Queue.push(rd);
+  return id;
+}
+
+//----------------------------------------------------------------------------
+unsigned int LayoutVisitor::AddType(clang::QualType t)
+{
+  t = this->CTX.getBaseElementType(t);
+  if(clang::RecordType const* rt = t->getAs<clang::RecordType>()) {
+    return this->AddRecord(rt->getDecl());
+  }
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+void LayoutVisitor::AddContext(clang::DeclContext const* dc)
+{
+  for(clang::Decl const* d : dc->decls()) {
+    if(clang::RecordDecl const* rd =
+       clang::dyn_cast<clang::RecordDecl>(d)) {
+      if(rd->isThisDeclarationADefinition() && !rd->isDependentType()) {
+        this->AddRecord(rd);
+        this->AddContext(rd);
+      }
+    } else if(clang::ClassTemplateDecl const* td =
+              clang::dyn_cast<clang::ClassTemplateDecl>(d)) {
+      this->AddClassTemplate(td);
+    } else if(clang::isa<clang::NamespaceDecl>(d) ||
+              clang::isa<clang::LinkageSpecDecl>(d)) {
+      this->AddContext(clang::cast<clang::DeclContext>(d));
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void LayoutVisitor::AddClassTemplate(clang::ClassTemplateDecl const* td)
+{
+  for(clang::ClassTemplateSpecializationDecl const* sd :
+        td->specializations()) {
+    this->AddRecord(sd);
+  }
+}
+
+//----------------------------------------------------------------------------
+void LayoutVisitor::AddStartDecl(clang::Decl const* d)
+{
+  if(clang::RecordDecl const* rd = clang::dyn_cast<clang::RecordDecl>(d)) {
+    if(this->AddRecord(rd)) {
+      this->AddContext(rd->getDefinition());
+    }
+  } else if(clang::ClassTemplateDecl const* td =
+            clang::dyn_cast<clang::ClassTemplateDecl>(d)) {
+    this->AddClassTemplate(td);
+  } else if(clang::TypedefNameDecl const* td =
+            clang::dyn_cast<clang::TypedefNameDecl>(d)) {
+    this->AddType(td->getUnderlyingType());
+  } else if(clang::ValueDecl const* vd =
+            clang::dyn_cast<clang::ValueDecl>(d)) {
+    this->AddType(vd->getType());
+  } else if(clang::UsingDecl const* ud =
+            clang::dyn_cast<clang::UsingDecl>(d)) {
+    for(clang::UsingShadowDecl const* sd : ud->shadows()) {
+      this->AddStartDecl(sd->getTargetDecl());
+    }
+  } else if(clang::isa<clang::TranslationUnitDecl>(d) ||
+            clang::isa<clang::NamespaceDecl>(d) ||
+            clang::isa<clang::LinkageSpecDecl>(d)) {
+    this->AddContext(clang::cast<clang::DeclContext>(d));
+  }
+}
+
+//----------------------------------------------------------------------------
+void LayoutVisitor::PrintNameAttribute(clang::NamedDecl const* d)
+{
+  if(!d->getDeclName()) {
+    return;
+  }
+  std::string s;
+  llvm::raw_string_ostream rso(s);
+  d->getNameForDiagnostic(rso, this->CTX.getPrintingPolicy(), true);
+  this->OS << " name=\"" << encodeXML(rso.str()) << "\"";
+}
+
+//----------------------------------------------------------------------------
+void LayoutVisitor::OutputRecord(clang::RecordDecl const* rd,
+                                 unsigned int id)
+{
+  clang::ASTRecordLayout const& layout = this->CTX.getASTRecordLayout(rd);
+  clang::CXXRecordDecl const* cxx = clang::dyn_cast<clang::CXXRecordDecl>(rd);
+
+  this->OS << "  <Record id=\"" << id << "\"";
+  this->PrintNameAttribute(rd);
+  this->OS <<
+    " kind=\"" << rd->getKindName() << "\""
+    " size=\"" << this->CTX.toBits(layout.getSize()) << "\""
+    " align=\"" << this->CTX.toBits(layout.getAlignment()) << "\"";
+  if(cxx && cxx->getNumVBases()) {
+    this->OS << " nvsize=\"" << this->CTX.toBits(layout.getNonVirtualSize())
+             << "\"";
+  }
+  if(cxx && cxx->isDynamicClass()) {
+    this->OS << " dynamic=\"1\"";
+    if(layout.hasOwnVFPtr()) {
+      this->OS << " vfptr=\"1\"";
+    }
+    if(layout.hasOwnVBPtr()) {
+      this->OS << " vbptr=\"" << this->CTX.toBits(layout.getVBPtrOffset())
+               << "\"";
+    }
+  }
+
+  bool empty = true;
+  if(cxx) {
+    for(clang::CXXBaseSpecifier const& b : cxx->bases()) {
+      if(b.isVirtual()) {
+        continue;
+      }
+      clang::CXXRecordDecl const* bd = b.getType()->getAsCXXRecordDecl();
+      unsigned int bid = this->AddRecord(bd);
+      if(!bid) {
+        continue;
+      }
+      this->OS << (empty? ">\n" : "") <<
+        "    <Base record=\"" << bid << "\""
+        " offset=\"" << this->CTX.toBits(layout.getBaseClassOffset(bd))
+               << "\"/>\n";
+      empty = false;
+    }
+    for(clang::CXXBaseSpecifier const& b : cxx->vbases()) {
+      clang::CXXRecordDecl const* bd = b.getType()->getAsCXXRecordDecl();
+      unsigned int bid = this->AddRecord(bd);
+      if(!bid) {
+        continue;
+      }
+      this->OS << (empty? ">\n" : "") <<
+        "    <Base record=\"" << bid << "\""
+        " offset=\"" << this->CTX.toBits(layout.getVBaseClassOffset(bd))
+               << "\" virtual=\"1\"/>\n";
+      empty = false;
+    }
+  }
+
+  unsigned int index = 0;
+  for(clang::FieldDecl const* f : rd->fields()) {
+    this->OS << (empty? ">\n" : "") << "    <Field";
+    empty = false;
+    this->PrintNameAttribute(f);
+    this->OS << " type=\"" << encodeXML(
+      f->getType().getAsString(this->CTX.getPrintingPolicy())) << "\"";
+    if(unsigned int fid = this->AddType(f->getType())) {
+      this->OS << " record=\"" << fid << "\"";
+    }
+    this->OS << " offset=\"" << layout.getFieldOffset(index++) << "\"";
+    if(f->isBitField()) {
+      this->OS << " bits=\"" << f->getBitWidthValue(this->CTX) << "\"";
+    } else {
+      this->OS << " size=\"" << this->CTX.getTypeSize(f->getType()) << "\"";
+    }
+    this->OS << "/>\n";
+  }
+
+  if(empty) {
+    this->OS << "/>\n";
+  } else {
+    this->OS << "  </Record>\n";
+  }
+}
+
+//----------------------------------------------------------------------------
+void LayoutVisitor::HandleTranslationUnit(
+  clang::TranslationUnitDecl const* tu,
+  std::vector<clang::Decl const*> const& starts)
+{
+  // Add the starting records.
+  if(!this->Opts.StartNames.empty() || !starts.empty()) {
+    std::vector<clang::Decl const*> named;
+    lookupStartNames(this->CI, tu, this->Opts.StartNames, named);
+    for(clang::Decl const* d : named) {
+      this->AddStartDecl(d);
+    }
+    for(clang::Decl const* d : starts) {
+      this->AddStartDecl(d);
+    }
+  } else {
+    this->AddStartDecl(tu);
+  }
+
+  this->OS <<
+    "<?xml version=\"1.0\"?>\n"
+    "<CastXML-Layout version=\"1\">\n"
+    ;
+
+  // Print records in order of their ids.  Printing a record may add
+  // the records of its bases and fields to the end of the queue.
+  while(!this->Queue.empty()) {
+    clang::RecordDecl const* rd = this->Queue.front();
+    this->Queue.pop();
+    this->OutputRecord(rd, this->RecordIds[rd]);
+  }
+
+  this->OS <<
+    "</CastXML-Layout>\n"
+    ;
+}
+
+//----------------------------------------------------------------------------
+void outputLayout(clang::CompilerInstance& ci,
+                  clang::ASTContext& ctx,
+                  llvm::raw_ostream& os,
+                  Options const& opts,
+                  std::vector<clang::Decl const*> const& starts)
+{
+  std::unique_ptr<LayoutVisitor> v(new LayoutVisitor(ci, ctx, os, opts));
+  v->HandleTranslationUnit(ctx.getTranslationUnitDecl(), starts);
+
+  // Leave the visitor to be reclaimed at exit along with the AST when
+  // Clang does not free its state.
+  if(ci.getFrontendOpts().DisableFree) {
+    clang::BuryPointer(std::move(v));
+  }
+}
@@ -0,0 +1,45 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+#ifndef CASTXML_LAYOUT_H
+#define CASTXML_LAYOUT_H
+
+#include <cxsys/Configure.hxx>
+
+#include <vector>
+
+namespace llvm {
+  class raw_ostream;
+}
+
+namespace clang {
+  class CompilerInstance;
+  class ASTContext;
+  class Decl;
+}
+
+struct Options;
+
+/// outputLayout - Print the size, alignment, and base and field offsets
+/// of each complete record reachable from the starting declarations,
+/// which are the given declarations and those named by the options.
+/// Functions, methods and their types are not visited.
+void outputLayout(clang::CompilerInstance& ci,
+                  clang::ASTContext& ctx,
+                  llvm::raw_ostream& os,
+                  Options const& opts,
+                  std::vector<clang::Decl const*> const& starts);
+
+#endif // CASTXML_LAYOUT_H
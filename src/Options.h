@@ -22,11 +22,28 @@
 
 struct Options
 {
-  Options(): PPOnly(false), GccXml(false), HaveCC(false), HaveTarget(false) {}
+  Options(): PPOnly(false), GccXml(false), GccXmlJson(false),
+    Layout(false), HaveCC(false), HaveTarget(false), ScanDeps(false),
+    Watch(false), FreeAtExit(false), Lean(false), MemoryReport(false),
+    ImplicitDeclOnly(false), Fork(0), MaxMemoryKB(0),
+    InstantiationReport(0), MaxInstantiations(0), OutputFd(-1) {}
   bool PPOnly;
   bool GccXml;
+  bool GccXmlJson;
+  bool Layout;
   bool HaveCC;
   bool HaveTarget;
+  bool ScanDeps;
+  bool Watch;
+  bool FreeAtExit;
+  bool Lean;
+  bool MemoryReport;
+  bool ImplicitDeclOnly;
+  unsigned int Fork;
+  unsigned long long MaxMemoryKB;
+  unsigned int InstantiationReport;
+  unsigned long long MaxInstantiations;
+  int OutputFd;
   struct Include {
     Include(std::string const& d, bool f = false):
       Directory(d), Framework(f) {}
@@ -34,10 +51,24 @@ struct Options
     bool Framework;
   };
   std::string OutputFile;
+  std::string GccXmlBase;
+  std::string CC1Cache;
+  std::string HeaderIndex;
+  std::string JobHistory;
+  std::string PreambleCache;
   std::vector<Include> Includes;
   std::string Predefines;
   std::string Triple;
   std::vector<std::string> StartNames;
+  std::vector<std::string> Instantiate;
+  std::vector<std::string> Targets;
+  struct TargetCC {
+    std::vector<Include> Includes;
+    std::string Predefines;
+    std::string Triple;
+  };
+  std::vector<TargetCC> TargetCCs;
+  std::vector<std::string> VFSArchives;
 };
 
 #endif // CASTXML_OPTIONS_H
@@ -15,7 +15,10 @@
 */
 
 #include "Output.h"
+#include "OutputFormat.h"
+#include "OutputJSON.h"
 #include "Options.h"
+#include "Probes.h"
 #include "Utils.h"
 
 #include "clang/AST/ASTContext.h"
@@ -28,27 +31,180 @@
 #include "clang/AST/Mangle.h"
 #include "clang/Basic/Specifiers.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/Utils.h"
+#include "clang/Index/USRGeneration.h"
 #include "clang/Lex/Preprocessor.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <queue>
 #include <set>
 #include <string>
+#include <string.h>
 #include <vector>
 
+//----------------------------------------------------------------------------
+// Forward output to a target stream that may be switched while printing.
+class SwitchOStream: public llvm::raw_ostream
+{
+  llvm::raw_ostream* Target;
+  void write_impl(const char* ptr, size_t size) override {
+    this->Target->write(ptr, size);
+  }
+  uint64_t current_pos() const override {
+    return this->Target->tell();
+  }
+public:
+  SwitchOStream(llvm::raw_ostream& os): Target(&os) {
+    this->SetUnbuffered();
+  }
+  llvm::raw_ostream& SetTarget(llvm::raw_ostream& os) {
+    llvm::raw_ostream& old = *this->Target;
+    this->Target = &os;
+    return old;
+  }
+};
+
+//----------------------------------------------------------------------------
+// Write the node model in the gccxml XML format.
+class OutputFormatXML: public OutputFormat
+{
+  // Tags of the open elements and whether each has children yet.
+  std::vector<std::pair<const char*, bool> > Open;
+
+  void Indent(size_t depth) {
+    for(size_t i = 0; i < depth; ++i) {
+      this->OS << "  ";
+    }
+  }
+  void PrintRef(OutputRef ref) {
+    this->OS << "_" << (ref.Base? "b":"") << ref.Id
+             << ((ref.Qual & 1)? "c":"")
+             << ((ref.Qual & 2)? "v":"")
+             << ((ref.Qual & 4)? "r":"");
+  }
+public:
+  OutputFormatXML(llvm::raw_ostream& os): OutputFormat(os) {}
+
+  void StartDocument(std::string const& base) override {
+    this->OS <<
+      "<?xml version=\"1.0\"?>\n"
+      "<GCC_XML version=\"0.9.0\" cvs_revision=\"1.136\""
+      ;
+    if(!base.empty()) {
+      this->String("base", base);
+    }
+    this->OS << ">\n";
+  }
+  void EndDocument() override {
+    this->OS <<
+      "</GCC_XML>\n"
+      ;
+  }
+  void StartElement(const char* tag) override {
+    if(!this->Open.empty() && !this->Open.back().second) {
+      this->OS << ">\n";
+      this->Open.back().second = true;
+    }
+    this->Open.push_back(std::make_pair(tag, false));
+    this->Indent(this->Open.size());
+    this->OS << "<" << tag;
+  }
+  void EndElement() override {
+    if(this->Open.back().second) {
+      this->Indent(this->Open.size());
+      this->OS << "</" << this->Open.back().first << ">\n";
+    } else {
+      this->OS << "/>\n";
+    }
+    this->Open.pop_back();
+  }
+  void String(const char* name, std::string const& value) override {
+    this->OS << " " << name << "=\"" << encodeXML(value) << "\"";
+  }
+  void Number(const char* name, std::string const& digits) override {
+    this->OS << " " << name << "=\"" << digits << "\"";
+  }
+  void Bool(const char* name, bool value) override {
+    this->OS << " " << name << "=\"" << (value? 1 : 0) << "\"";
+  }
+  void Flag(const char* name) override {
+    this->Bool(name, true);
+  }
+  void Null(const char* name) override {
+    this->OS << " " << name << "=\"\"";
+  }
+  void Ref(const char* name, OutputRef ref) override {
+    this->OS << " " << name << "=\"";
+    this->PrintRef(ref);
+    this->OS << "\"";
+  }
+  void RefList(const char* name,
+               std::vector<OutputRef> const& refs) override {
+    this->OS << " " << name << "=\"";
+    const char* sep = "";
+    for(std::vector<OutputRef>::const_iterator i = refs.begin(),
+          e = refs.end(); i != e; ++i) {
+      this->OS << sep;
+      this->PrintRef(*i);
+      sep = " ";
+    }
+    this->OS << "\"";
+  }
+  void Bases(std::vector<OutputBaseRef> const& bases) override {
+    // Public access is implied.
+    this->OS << " bases=\"";
+    const char* sep = "";
+    for(std::vector<OutputBaseRef>::const_iterator i = bases.begin(),
+          e = bases.end(); i != e; ++i) {
+      this->OS << sep;
+      if(strcmp(i->Access, "public") != 0) {
+        this->OS << i->Access << ":";
+      }
+      this->PrintRef(i->Type);
+      sep = " ";
+    }
+    this->OS << "\"";
+  }
+  void Location(unsigned int file, unsigned int line) override {
+    this->OS <<
+      " location=\"f" << file << ":" << line << "\""
+      " file=\"f" << file << "\""
+      " line=\"" << line << "\"";
+  }
+  void FileId(unsigned int file) override {
+    this->OS << " id=\"f" << file << "\"";
+  }
+  void Marker(char c) override {
+    this->OS << c;
+  }
+};
+
+//----------------------------------------------------------------------------
+/// Print an integer as decimal digits for OutputFormat::Number.
+template <typename T> static std::string toDecimal(T const& value)
+{
+  std::string s;
+  llvm::raw_string_ostream rso(s);
+  rso << value;
+  return rso.str();
+}
+
 //----------------------------------------------------------------------------
 class ASTVisitorBase
 {
 protected:
   clang::CompilerInstance& CI;
   clang::ASTContext const& CTX;
-  llvm::raw_ostream& OS;
+  OutputFormat& Format;
 
   ASTVisitorBase(clang::CompilerInstance& ci,
                  clang::ASTContext const& ctx,
-                 llvm::raw_ostream& os): CI(ci), CTX(ctx), OS(os) {}
+                 OutputFormat& format): CI(ci), CTX(ctx), Format(format) {}
 
   // Represent cv qualifier state of one dump node.
   struct DumpQual {
@@ -60,6 +216,10 @@ protected:
     bool IsVolatile;
     bool IsRestrict;
     DumpQual(): IsConst(false), IsVolatile(false), IsRestrict(false) {}
+    unsigned int Bits() const {
+      return (this->IsConst? 1:0) | (this->IsVolatile? 2:0) |
+        (this->IsRestrict? 4:0);
+    }
     operator bool_type() const {
       return (this->IsConst || this->IsVolatile || this->IsRestrict)?
         &DumpQual::bool_true : nullptr;
@@ -97,13 +257,22 @@ protected:
   public:
     unsigned int Id;
     DumpQual Qual;
-    DumpId(): Id(0), Qual() {}
-    DumpId(unsigned int id, DumpQual dq): Id(id), Qual(dq) {}
+    bool Base;
+    DumpId(): Id(0), Qual(), Base(false) {}
+    DumpId(unsigned int id, DumpQual dq, bool base = false):
+      Id(id), Qual(dq), Base(base) {}
     operator bool_type() const {
       return this->Id != 0? &DumpId::bool_true : nullptr;
     }
+    OutputRef Ref() const {
+      return OutputRef(this->Id, this->Qual.Bits(), this->Base);
+    }
     friend bool operator < (DumpId const& l, DumpId const& r) {
-      if (l.Id < r.Id) {
+      if (!l.Base && r.Base) {
+        return true;
+      } else if (l.Base && !r.Base) {
+        return false;
+      } else if (l.Id < r.Id) {
         return true;
       } else if (l.Id > r.Id) {
         return false;
@@ -113,19 +282,22 @@ protected:
     }
     friend llvm::raw_ostream& operator << (llvm::raw_ostream& os,
                                            DumpId const& id) {
-      return os << id.Id << id.Qual;
+      return os << (id.Base? "b":"") << id.Id << id.Qual;
     }
   };
 
   // Record status of one AST node to be dumped.
   struct DumpNode {
-    DumpNode(): Index(), Complete(false) {}
+    DumpNode(): Index(), Complete(false), BaseNode(nullptr) {}
 
     // Index in nodes ordered by first encounter.
     DumpId Index;
 
     // Whether the node is to be traversed completely.
     bool Complete;
+
+    // The shared base document node, if any.
+    OutputBase::Node* BaseNode;
   };
 
   // Report all decl nodes as unimplemented until overridden.
@@ -137,8 +309,10 @@ protected:
 #include "clang/AST/DeclNodes.inc"
 
   void OutputUnimplementedDecl(clang::Decl const* d, DumpNode const* dn) {
-    this->OS << "  <Unimplemented id=\"_" << dn->Index
-             << "\" kind=\"" << encodeXML(d->getDeclKindName()) << "\"/>\n";
+    this->Format.StartElement("Unimplemented");
+    this->Format.Ref("id", dn->Index.Ref());
+    this->Format.String("kind", d->getDeclKindName());
+    this->Format.EndElement();
   }
 
   // Report all type nodes as unimplemented until overridden.
@@ -150,9 +324,10 @@ protected:
 #include "clang/AST/TypeNodes.def"
 
   void OutputUnimplementedType(clang::Type const* t, DumpNode const* dn) {
-    this->OS << "  <Unimplemented id=\"_" << dn->Index
-             << "\" type_class=\"" << encodeXML(t->getTypeClassName())
-             << "\"/>\n";
+    this->Format.StartElement("Unimplemented");
+    this->Format.Ref("id", dn->Index.Ref());
+    this->Format.String("type_class", t->getTypeClassName());
+    this->Format.EndElement();
   }
 };
 
@@ -217,13 +392,13 @@ class ASTVisitor: public ASTVisitorBase
   };
 
   /** Get the dump status node for a Clang declaration.  */
-  DumpNode* GetDumpNode(clang::Decl const* d) {
-    return &this->DeclNodes[d];
+  DumpNode* GetDumpNode(clang::Decl const* d, bool base) {
+    return base? &this->BaseDeclNodes[d] : &this->DeclNodes[d];
   }
 
   /** Get the dump status node for a Clang type.  */
-  DumpNode* GetDumpNode(DumpType t) {
-    return &this->TypeNodes[t];
+  DumpNode* GetDumpNode(DumpType t, bool base) {
+    return base? &this->BaseTypeNodes[t] : &this->TypeNodes[t];
   }
 
   /** Get the dump status node for a qualified DumpId.  */
@@ -245,6 +420,24 @@ class ASTVisitor: public ASTVisitorBase
   /** Helper common to AddDeclDumpNode and AddTypeDumpNode.  */
   template <typename K> DumpId AddDumpNodeImpl(K k, bool complete);
 
+  /** Return whether a node belongs in the shared base document.  */
+  bool IsBaseNode(clang::Decl const* d);
+  bool IsBaseNode(DumpType dt);
+  bool IsBaseDecl(clang::Decl const* d);
+  bool IsBaseType(clang::QualType t);
+  bool IsBaseTemplateArgs(clang::TemplateArgument const* args,
+                          unsigned int n);
+
+  /** Return whether the members of a node are merged over all
+      translation units in the shared base document.  */
+  static bool MergesMembers(clang::Decl const* d);
+  static bool MergesMembers(DumpType) { return false; }
+  static bool MergesMembers(QueueEntry const& qe);
+
+  /** Get the key identifying a node across translation units.  */
+  std::string GetBaseKey(clang::Decl const* d);
+  std::string GetBaseKey(DumpType dt);
+
   /** Allocate a dump node for a source file entry.  */
   unsigned int AddDumpFile(clang::FileEntry const* f);
 
@@ -265,11 +458,22 @@ class ASTVisitor: public ASTVisitorBase
 
   /** Queue leftover nodes that do not need complete output.  */
   void QueueIncompleteDumpNodes();
+  template <typename M> void QueueIncompleteDumpNodes(M const& nodes);
 
   /** Traverse AST nodes until the queue is empty.  */
   void ProcessQueue();
   void ProcessFileQueue();
 
+  /** Node kind and id of a queue entry, for the node probes.  */
+  static char const* GetKindName(QueueEntry const& qe);
+  static int GetProbeId(QueueEntry const& qe);
+
+  /** Dispatch output of one queued node.  */
+  void OutputQueueEntry(QueueEntry const& qe);
+
+  /** Record output of one queued node in the base document.  */
+  void OutputBaseNode(QueueEntry const& qe, OutputBase::Node* bn);
+
   /** Dispatch output of a declaration.  */
   void OutputDecl(clang::Decl const* d, DumpNode const* dn);
 
@@ -287,13 +491,12 @@ class ASTVisitor: public ASTVisitorBase
       (class, struct, union) of the given method.  */
   std::string GetContextName(clang::CXXMethodDecl const* d);
 
-  /** Print the XML IDREF value referencing the given type.
+  /** Get the reference to the given type.
       If the type has top-level cv-qualifiers, they are
-      appended to the numeric id as single characters (c=const,
-      v=volatile, r=restrict) to reference the XML ID of
-      a CvQualifiedType element describing the qualifiers
-      and referencing the unqualified type.  */
-  void PrintTypeIdRef(clang::QualType t, bool complete);
+      added to the reference (c=const, v=volatile, r=restrict)
+      to reference a CvQualifiedType element describing the
+      qualifiers and referencing the unqualified type.  */
+  OutputRef GetTypeIdRef(clang::QualType t, bool complete);
 
   /** Print an id="_<n>" XML unique ID attribute.  */
   void PrintIdAttribute(DumpNode const* dn);
@@ -325,7 +528,7 @@ class ASTVisitor: public ASTVisitorBase
       the given type for later output.  */
   void PrintReturnsAttribute(clang::QualType t, bool complete);
 
-  /** Print the XML attributes location="fid:line" file="fid" line="line"
+  /** Print the location="fid:line" file="fid" line="line" attributes
       for the given decl.  */
   void PrintLocationAttribute(clang::Decl const* d);
 
@@ -354,6 +557,7 @@ class ASTVisitor: public ASTVisitorBase
       friends of the given class.  Also queues the friends for later
       output.  */
   void PrintBefriendingAttribute(clang::CXXRecordDecl const* dx);
+  void AddBefriendingId(DumpId id, std::vector<OutputRef>& ids);
 
   /** Flags used by function output methods to pass information
       to the OutputFunctionHelper method.  */
@@ -435,7 +639,6 @@ class ASTVisitor: public ASTVisitorBase
   void OutputPointerType(clang::PointerType const* t, DumpNode const* dn);
 
   /** Queue declarations matching given qualified name in given context.  */
-  void LookupStart(clang::DeclContext const* dc, std::string const& name);
 
 private:
   // List of starting declaration names.
@@ -471,6 +674,25 @@ private:
   typedef std::map<DumpId, DumpNode> QualNodesMap;
   QualNodesMap QualNodes;
 
+  // Nodes shared with other translation units, if any.
+  OutputBase* Base;
+
+  // Stream switched to capture base document elements.
+  SwitchOStream* BaseOS;
+
+  // Whether we are printing an element of the base document.
+  bool InBase;
+
+  // Members merged into the base document element being printed.
+  std::set<unsigned int>* BaseMembers;
+
+  // Whether each declaration seen belongs in the base document.
+  std::map<clang::Decl const*, bool> BaseDecls;
+
+  // Dump status nodes for elements of the base document.
+  DeclNodesMap BaseDeclNodes;
+  TypeNodesMap BaseTypeNodes;
+
   // Map from clang file entry to our source file index.
   typedef std::map<clang::FileEntry const*, unsigned int> FileNodesMap;
   FileNodesMap FileNodes;
@@ -484,33 +706,66 @@ private:
 public:
   ASTVisitor(clang::CompilerInstance& ci,
              clang::ASTContext& ctx,
-             llvm::raw_ostream& os,
-             Options const& opts):
-    ASTVisitorBase(ci, ctx, os),
+             OutputFormat& format,
+             Options const& opts,
+             OutputBase* base = 0,
+             SwitchOStream* bos = 0):
+    ASTVisitorBase(ci, ctx, format),
     Opts(opts),
     NodeCount(0), FileCount(0),
     FileBuiltin(false),
     RequireComplete(true),
     MangleContext(ctx.createMangleContext()),
-    PrintingPolicy(ctx.getPrintingPolicy()) {
+    PrintingPolicy(ctx.getPrintingPolicy()),
+    Base(base), BaseOS(bos), InBase(false), BaseMembers(nullptr) {
     this->PrintingPolicy.SuppressUnwrittenScope = true;
   }
 
   /** Visit declarations in the given translation unit.
       This is the main entry point.  */
-  void HandleTranslationUnit(clang::TranslationUnitDecl const* tu);
+  void HandleTranslationUnit(clang::TranslationUnitDecl const* tu,
+                             std::vector<clang::Decl const*> const& starts);
 };
 
 //----------------------------------------------------------------------------
-ASTVisitor::DumpId ASTVisitor::AddDeclDumpNode(clang::Decl const* d,
-                                               bool complete) {
-  // Select the definition or canonical declaration.
+/// Select the definition or canonical declaration of a declaration.
+static clang::Decl const* GetDumpDecl(clang::Decl const* d)
+{
   d = d->getCanonicalDecl();
   if(clang::RecordDecl const* rd = clang::dyn_cast<clang::RecordDecl>(d)) {
     if(clang::RecordDecl const* rdd = rd->getDefinition()) {
       d = rdd;
     }
   }
+  return d;
+}
+
+//----------------------------------------------------------------------------
+/// Whether a TypedefType refers to a non-dependent TypedefDecl member
+/// of a class template.  Since gccxml format does not include
+/// uninstantiated templates such a type is replaced by its desugared
+/// type so that we do not end up referencing a class template as
+/// context.
+static bool IsClassTemplateMemberTypedef(clang::TypedefType const* tdt)
+{
+  if(!tdt->isInstantiationDependentType() && tdt->isSugared()) {
+    if(clang::DeclContext const* tdc = tdt->getDecl()->getDeclContext()) {
+      if(clang::CXXRecordDecl const* tdx =
+         clang::dyn_cast<clang::CXXRecordDecl>(tdc)) {
+        return (tdx->getDescribedClassTemplate() ||
+                clang::isa<clang::ClassTemplatePartialSpecializationDecl>(
+                  tdx));
+      }
+    }
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+ASTVisitor::DumpId ASTVisitor::AddDeclDumpNode(clang::Decl const* d,
+                                               bool complete) {
+  // Select the definition or canonical declaration.
+  d = GetDumpDecl(d);
 
   // Replace some decls with those they reference.
   switch (d->getKind()) {
@@ -569,7 +824,7 @@ ASTVisitor::DumpId ASTVisitor::AddDeclDumpNode(clang::Decl const* d,
   // If any qualifiers were collected through layers of desugaring
   // then get the id of the qualified type referencing this decl.
   if (id && dq) {
-    id = this->AddQualDumpNode(DumpId(id.Id, dq));
+    id = this->AddQualDumpNode(DumpId(id.Id, dq, id.Base));
   }
 
   return id;
@@ -632,22 +887,8 @@ ASTVisitor::DumpId ASTVisitor::AddTypeDumpNode(DumpType dt, bool complete,
   } break;
   case clang::Type::Typedef: {
     clang::TypedefType const* tdt = t->getAs<clang::TypedefType>();
-    if(!tdt->isInstantiationDependentType() && tdt->isSugared()) {
-      if(clang::DeclContext const* tdc = tdt->getDecl()->getDeclContext()) {
-        if(clang::CXXRecordDecl const* tdx =
-           clang::dyn_cast<clang::CXXRecordDecl>(tdc)) {
-          if(tdx->getDescribedClassTemplate() ||
-             clang::isa<clang::ClassTemplatePartialSpecializationDecl>(tdx)
-             ) {
-            // This TypedefType refers to a non-dependent
-            // TypedefDecl member of a class template.  Since gccxml
-            // format does not include uninstantiated templates we
-            // must use the desugared type so that we do not end up
-            // referencing a class template as context.
-            return this->AddTypeDumpNode(tdt->desugar(), complete, dq);
-          }
-        }
-      }
+    if(IsClassTemplateMemberTypedef(tdt)) {
+      return this->AddTypeDumpNode(tdt->desugar(), complete, dq);
     }
     return this->AddDeclDumpNode(tdt->getDecl(), complete, dq);
   } break;
@@ -661,7 +902,7 @@ ASTVisitor::DumpId ASTVisitor::AddTypeDumpNode(DumpType dt, bool complete,
   // If any qualifiers were collected through layers of desugaring
   // then get the id of the qualified type.
   if (id && dq) {
-    id = this->AddQualDumpNode(DumpId(id.Id, dq));
+    id = this->AddQualDumpNode(DumpId(id.Id, dq, id.Base));
   }
 
   return id;
@@ -674,6 +915,17 @@ ASTVisitor::DumpId ASTVisitor::AddQualDumpNode(DumpId id) {
     dn->Index = id;
     // Always treat CvQualifiedType nodes as complete.
     dn->Complete = true;
+    if (id.Base) {
+      // Qualify a node of the base document there too.
+      std::string key;
+      llvm::raw_string_ostream rso(key);
+      rso << "_" << id;
+      dn->BaseNode = &this->Base->Nodes[rso.str()];
+      dn->BaseNode->Id = id.Id;
+      if (dn->BaseNode->Written) {
+        return dn->Index;
+      }
+    }
     this->Queue.insert(QueueEntry(dn));
   }
   return dn->Index;
@@ -684,7 +936,8 @@ template <typename K>
 ASTVisitor::DumpId ASTVisitor::AddDumpNodeImpl(K k, bool complete)
 {
   // Update an existing node or add one.
-  DumpNode* dn = this->GetDumpNode(k);
+  bool base = this->IsBaseNode(k);
+  DumpNode* dn = this->GetDumpNode(k, base);
   if (dn->Index) {
     // Node was already encountered.  See if it is now complete.
     if(complete && !dn->Complete) {
@@ -692,6 +945,24 @@ ASTVisitor::DumpId ASTVisitor::AddDumpNodeImpl(K k, bool complete)
       dn->Complete = true;
       this->Queue.insert(QueueEntry(k, dn));
     }
+  } else if (base) {
+    // This is a new node of the base document.  Use its shared index.
+    OutputBase::Node* bn = &this->Base->Nodes[this->GetBaseKey(k)];
+    if (!bn->Id) {
+      bn->Id = ++this->Base->NodeCount;
+    }
+    dn->Index = DumpId(bn->Id, DumpQual(), true);
+    dn->BaseNode = bn;
+    if (bn->Written && (bn->Complete || !complete) &&
+        !this->MergesMembers(k)) {
+      // Another translation unit already wrote the node.
+      dn->Complete = bn->Complete;
+    } else {
+      dn->Complete = complete;
+      if(complete || !this->RequireComplete) {
+        this->Queue.insert(QueueEntry(k, dn));
+      }
+    }
   } else {
     // This is a new node.  Assign it an index.
     dn->Index.Id = ++this->NodeCount;
@@ -705,9 +976,321 @@ ASTVisitor::DumpId ASTVisitor::AddDumpNodeImpl(K k, bool complete)
   return dn->Index;
 }
 
+//----------------------------------------------------------------------------
+bool ASTVisitor::IsBaseNode(clang::Decl const* d)
+{
+  if (!this->Base) {
+    return false;
+  }
+  std::map<clang::Decl const*, bool>::iterator i = this->BaseDecls.find(d);
+  if (i != this->BaseDecls.end()) {
+    return i->second;
+  }
+  // Assume the node is shared while deciding in case it refers to itself.
+  this->BaseDecls[d] = true;
+  bool base = this->IsBaseDecl(d);
+  this->BaseDecls[d] = base;
+  return base;
+}
+
+//----------------------------------------------------------------------------
+bool ASTVisitor::IsBaseNode(DumpType dt)
+{
+  return (this->Base && this->IsBaseType(dt.Type) &&
+          (!dt.Class || this->IsBaseType(clang::QualType(dt.Class, 0))));
+}
+
+//----------------------------------------------------------------------------
+bool ASTVisitor::IsBaseDecl(clang::Decl const* d)
+{
+  // The global namespace is shared by all translation units.
+  if (clang::isa<clang::TranslationUnitDecl>(d)) {
+    return true;
+  }
+
+  // Share declarations from included files, which other translation
+  // units may include too and then declare with the same USR.  Those of
+  // the main source file, or of no file, belong to this one.
+  clang::SourceManager const& sm = this->CI.getSourceManager();
+  clang::SourceLocation sl = d->getLocation();
+  if (!sl.isValid()) {
+    return false;
+  }
+  sl = sm.getExpansionLoc(sl);
+  if (sm.isInMainFile(sl) || !sm.getFileEntryForID(sm.getFileID(sl))) {
+    return false;
+  }
+
+  // A shared element may reference only shared elements, so its context
+  // and every node named by its template arguments or type must be
+  // shared too.  A specialization of a shared template for a type of
+  // this translation unit is not.
+  clang::DeclContext const* dc = d->getDeclContext();
+  while (dc->isInlineNamespace() || clang::isa<clang::LinkageSpecDecl>(dc)) {
+    dc = dc->getParent();
+  }
+  if (!this->IsBaseNode(GetDumpDecl(clang::Decl::castFromDeclContext(dc)))) {
+    return false;
+  }
+  if (clang::ClassTemplateSpecializationDecl const* sd =
+      clang::dyn_cast<clang::ClassTemplateSpecializationDecl>(d)) {
+    clang::TemplateArgumentList const& args = sd->getTemplateArgs();
+    if (!this->IsBaseTemplateArgs(args.data(), args.size())) {
+      return false;
+    }
+  }
+  if (clang::FunctionDecl const* fd =
+      clang::dyn_cast<clang::FunctionDecl>(d)) {
+    if (clang::TemplateArgumentList const* args =
+        fd->getTemplateSpecializationArgs()) {
+      if (!this->IsBaseTemplateArgs(args->data(), args->size())) {
+        return false;
+      }
+    }
+  }
+  if (clang::TypedefNameDecl const* td =
+      clang::dyn_cast<clang::TypedefNameDecl>(d)) {
+    return this->IsBaseType(td->getUnderlyingType());
+  }
+  if (clang::ValueDecl const* vd = clang::dyn_cast<clang::ValueDecl>(d)) {
+    return this->IsBaseType(vd->getType());
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool ASTVisitor::IsBaseTemplateArgs(clang::TemplateArgument const* args,
+                                    unsigned int n)
+{
+  for (unsigned int i = 0; i < n; ++i) {
+    clang::TemplateArgument const& a = args[i];
+    switch (a.getKind()) {
+    case clang::TemplateArgument::Type:
+      if (!this->IsBaseType(a.getAsType())) {
+        return false;
+      }
+      break;
+    case clang::TemplateArgument::Declaration:
+      if (!this->IsBaseNode(GetDumpDecl(a.getAsDecl()))) {
+        return false;
+      }
+      break;
+    case clang::TemplateArgument::Template:
+      if (clang::TemplateDecl const* td =
+          a.getAsTemplate().getAsTemplateDecl()) {
+        if (!this->IsBaseNode(GetDumpDecl(td))) {
+          return false;
+        }
+      }
+      break;
+    case clang::TemplateArgument::Pack:
+      if (!this->IsBaseTemplateArgs(a.pack_begin(), a.pack_size())) {
+        return false;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool ASTVisitor::IsBaseType(clang::QualType t)
+{
+  // Follow the type as AddTypeDumpNode does to the nodes it references.
+  if (t.isNull()) {
+    return true;
+  }
+  clang::Type const* tp = t.getTypePtr();
+  switch (tp->getTypeClass()) {
+  case clang::Type::Adjusted:
+    return this->IsBaseType(
+      clang::cast<clang::AdjustedType>(tp)->getAdjustedType());
+  case clang::Type::Attributed:
+    return this->IsBaseType(
+      clang::cast<clang::AttributedType>(tp)->getEquivalentType());
+  case clang::Type::Decayed:
+    return this->IsBaseType(
+      clang::cast<clang::DecayedType>(tp)->getDecayedType());
+  case clang::Type::Elaborated:
+    return this->IsBaseType(
+      clang::cast<clang::ElaboratedType>(tp)->getNamedType());
+  case clang::Type::Paren:
+    return this->IsBaseType(
+      clang::cast<clang::ParenType>(tp)->getInnerType());
+  case clang::Type::SubstTemplateTypeParm:
+    return this->IsBaseType(
+      clang::cast<clang::SubstTemplateTypeParmType>(tp)
+      ->getReplacementType());
+  case clang::Type::TemplateSpecialization: {
+    clang::TemplateSpecializationType const* tst =
+      clang::cast<clang::TemplateSpecializationType>(tp);
+    return !tst->isSugared() || this->IsBaseType(tst->desugar());
+  }
+  case clang::Type::Typedef: {
+    clang::TypedefType const* tdt = clang::cast<clang::TypedefType>(tp);
+    if (IsClassTemplateMemberTypedef(tdt)) {
+      return this->IsBaseType(tdt->desugar());
+    }
+    return this->IsBaseNode(GetDumpDecl(tdt->getDecl()));
+  }
+  case clang::Type::Enum:
+  case clang::Type::Record:
+    return this->IsBaseNode(
+      GetDumpDecl(clang::cast<clang::TagType>(tp)->getDecl()));
+  case clang::Type::Pointer:
+  case clang::Type::LValueReference:
+  case clang::Type::RValueReference:
+    return this->IsBaseType(tp->getPointeeType());
+  case clang::Type::ConstantArray:
+  case clang::Type::IncompleteArray:
+    return this->IsBaseType(
+      clang::cast<clang::ArrayType>(tp)->getElementType());
+  case clang::Type::MemberPointer: {
+    clang::MemberPointerType const* mpt =
+      clang::cast<clang::MemberPointerType>(tp);
+    return (this->IsBaseType(mpt->getPointeeType()) &&
+            this->IsBaseType(clang::QualType(mpt->getClass(), 0)));
+  }
+  case clang::Type::FunctionProto: {
+    clang::FunctionProtoType const* fpt =
+      clang::cast<clang::FunctionProtoType>(tp);
+    if (!this->IsBaseType(fpt->getReturnType())) {
+      return false;
+    }
+    for (clang::FunctionProtoType::param_type_iterator
+           i = fpt->param_type_begin(), e = fpt->param_type_end();
+         i != e; ++i) {
+      if (!this->IsBaseType(*i)) {
+        return false;
+      }
+    }
+    for (clang::FunctionProtoType::exception_iterator
+           i = fpt->exception_begin(), e = fpt->exception_end();
+         i != e; ++i) {
+      if (!this->IsBaseType(*i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  default:
+    // Builtin types, and types not written out in detail.
+    return true;
+  }
+}
+
+//----------------------------------------------------------------------------
+bool ASTVisitor::MergesMembers(clang::Decl const* d)
+{
+  // Every translation unit may add members to a namespace.
+  return (clang::isa<clang::NamespaceDecl>(d) ||
+          clang::isa<clang::TranslationUnitDecl>(d));
+}
+
+//----------------------------------------------------------------------------
+bool ASTVisitor::MergesMembers(QueueEntry const& qe)
+{
+  return qe.Kind == QueueEntry::KindDecl && MergesMembers(qe.Decl);
+}
+
+//----------------------------------------------------------------------------
+std::string ASTVisitor::GetBaseKey(clang::Decl const* d)
+{
+  if (clang::isa<clang::TranslationUnitDecl>(d)) {
+    return "::";
+  }
+
+  llvm::SmallString<128> usr;
+  if (!clang::index::generateUSRForDecl(d, usr)) {
+    return usr.str();
+  }
+
+  // Fall back to the qualified name and location.
+  std::string key = "@";
+  llvm::raw_string_ostream rso(key);
+  if (clang::NamedDecl const* nd = clang::dyn_cast<clang::NamedDecl>(d)) {
+    nd->printQualifiedName(rso, this->PrintingPolicy);
+  }
+  rso << "@";
+  d->getLocation().print(rso, this->CI.getSourceManager());
+  return rso.str();
+}
+
+//----------------------------------------------------------------------------
+std::string ASTVisitor::GetBaseKey(DumpType dt)
+{
+  // Identify a type that references other nodes by the ids of those
+  // nodes, so that types spelled through different typedefs, which
+  // reference different nodes, stay distinct.
+  std::string key;
+  llvm::raw_string_ostream rso(key);
+  if (dt.Class) {
+    rso << "M_"
+        << this->AddTypeDumpNode(clang::QualType(dt.Class, 0), false) << "|";
+  }
+  clang::Type const* t = dt.Type.getTypePtr();
+  switch (t->getTypeClass()) {
+  case clang::Type::Pointer:
+    rso << "P_" << this->AddTypeDumpNode(t->getPointeeType(), false);
+    break;
+  case clang::Type::LValueReference:
+    rso << "R_" << this->AddTypeDumpNode(t->getPointeeType(), false);
+    break;
+  case clang::Type::ConstantArray: {
+    clang::ConstantArrayType const* at =
+      clang::cast<clang::ConstantArrayType>(t);
+    rso << "A" << at->getSize() << "_"
+        << this->AddTypeDumpNode(at->getElementType(), false);
+  } break;
+  case clang::Type::IncompleteArray:
+    rso << "A_" << this->AddTypeDumpNode(
+      clang::cast<clang::ArrayType>(t)->getElementType(), false);
+    break;
+  case clang::Type::MemberPointer: {
+    clang::MemberPointerType const* mpt =
+      clang::cast<clang::MemberPointerType>(t);
+    rso << "O_"
+        << this->AddTypeDumpNode(clang::QualType(mpt->getClass(), 0), false)
+        << "_"
+        << this->AddTypeDumpNode(
+          DumpType(mpt->getPointeeType(),
+                   mpt->isMemberDataPointerType()? 0 : mpt->getClass()),
+          false);
+  } break;
+  case clang::Type::FunctionProto: {
+    clang::FunctionProtoType const* fpt =
+      clang::cast<clang::FunctionProtoType>(t);
+    rso << "F" << fpt->getTypeQuals()
+        << "_" << unsigned(fpt->getExtInfo().getCC())
+        << (fpt->isVariadic()? "." : "")
+        << "_" << this->AddTypeDumpNode(fpt->getReturnType(), false);
+    for (clang::FunctionProtoType::param_type_iterator
+           i = fpt->param_type_begin(), e = fpt->param_type_end();
+         i != e; ++i) {
+      rso << "_" << this->AddTypeDumpNode(*i, false);
+    }
+  } break;
+  default:
+    // Other types reference no nodes.
+    rso << "T" << dt.Type.getCanonicalType().getAsString(this->PrintingPolicy);
+    break;
+  }
+  return rso.str();
+}
+
 //----------------------------------------------------------------------------
 unsigned int ASTVisitor::AddDumpFile(clang::FileEntry const* f)
 {
+  if (this->InBase) {
+    unsigned int& index = this->Base->Files[f->getName()];
+    if(index == 0) {
+      index = ++this->Base->FileCount;
+    }
+    return index;
+  }
+
   unsigned int& index = this->FileNodes[f];
   if(index == 0) {
     index = ++this->FileCount;
@@ -852,18 +1435,24 @@ void ASTVisitor::AddStartDecl(clang::Decl const* d)
 void ASTVisitor::QueueIncompleteDumpNodes()
 {
   // Queue declaration nodes that do not need complete output.
-  for(DeclNodesMap::const_iterator i = this->DeclNodes.begin(),
-        e = this->DeclNodes.end(); i != e; ++i) {
-    if(!i->second.Complete) {
-      this->Queue.insert(QueueEntry(i->first, &i->second));
-    }
-  }
+  this->QueueIncompleteDumpNodes(this->DeclNodes);
+  this->QueueIncompleteDumpNodes(this->BaseDeclNodes);
 
   // Queue type nodes that do not need complete output.
-  for(TypeNodesMap::const_iterator i = this->TypeNodes.begin(),
-        e = this->TypeNodes.end(); i != e; ++i) {
-    if(!i->second.Complete) {
-      this->Queue.insert(QueueEntry(i->first, &i->second));
+  this->QueueIncompleteDumpNodes(this->TypeNodes);
+  this->QueueIncompleteDumpNodes(this->BaseTypeNodes);
+}
+
+//----------------------------------------------------------------------------
+template <typename M>
+void ASTVisitor::QueueIncompleteDumpNodes(M const& nodes)
+{
+  for(typename M::const_iterator i = nodes.begin(), e = nodes.end();
+      i != e; ++i) {
+    DumpNode const* dn = &i->second;
+    // Skip nodes another translation unit already wrote.
+    if(!dn->Complete && !(dn->BaseNode && dn->BaseNode->Written)) {
+      this->Queue.insert(QueueEntry(i->first, dn));
     }
   }
 }
@@ -875,37 +1464,106 @@ void ASTVisitor::ProcessQueue()
   while(!this->Queue.empty()) {
     QueueEntry qe = *this->Queue.begin();
     this->Queue.erase(this->Queue.begin());
-    switch(qe.Kind) {
-    case QueueEntry::KindQual:
-      this->OutputCvQualifiedType(qe.DN);
-      break;
-    case QueueEntry::KindDecl:
-      this->OutputDecl(qe.Decl, qe.DN);
-      break;
-    case QueueEntry::KindType:
-      this->OutputType(qe.Type, qe.DN);
-      break;
+    if(CASTXML_PROBE_ENABLED(node__start)) {
+      CASTXML_PROBE2(node__start, this->GetKindName(qe),
+                     this->GetProbeId(qe));
+    }
+    if(OutputBase::Node* bn = qe.DN->BaseNode) {
+      this->OutputBaseNode(qe, bn);
+    } else {
+      this->OutputQueueEntry(qe);
+    }
+    if(CASTXML_PROBE_ENABLED(node__done)) {
+      CASTXML_PROBE2(node__done, this->GetKindName(qe),
+                     this->GetProbeId(qe));
     }
   }
 }
 
+//----------------------------------------------------------------------------
+char const* ASTVisitor::GetKindName(QueueEntry const& qe)
+{
+  switch(qe.Kind) {
+  case QueueEntry::KindQual:
+    return "CvQualifiedType";
+  case QueueEntry::KindDecl:
+    return qe.Decl->getDeclKindName();
+  case QueueEntry::KindType:
+    return qe.Type.Type->getTypeClassName();
+  }
+  return "";
+}
+
+//----------------------------------------------------------------------------
+int ASTVisitor::GetProbeId(QueueEntry const& qe)
+{
+  // Number ids in the base document negatively, as the JSON output does.
+  DumpId const& id = qe.DN->Index;
+  return id.Base? -int(id.Id) : int(id.Id);
+}
+
+//----------------------------------------------------------------------------
+void ASTVisitor::OutputQueueEntry(QueueEntry const& qe)
+{
+  switch(qe.Kind) {
+  case QueueEntry::KindQual:
+    this->OutputCvQualifiedType(qe.DN);
+    break;
+  case QueueEntry::KindDecl:
+    this->OutputDecl(qe.Decl, qe.DN);
+    break;
+  case QueueEntry::KindType:
+    this->OutputType(qe.Type, qe.DN);
+    break;
+  }
+}
+
+//----------------------------------------------------------------------------
+void ASTVisitor::OutputBaseNode(QueueEntry const& qe, OutputBase::Node* bn)
+{
+  // Skip nodes another translation unit already wrote completely,
+  // except to add the members this one declares to a namespace.
+  bool const merge = qe.DN->Complete && this->MergesMembers(qe);
+  if(bn->Written && (bn->Complete || !qe.DN->Complete) && !merge) {
+    return;
+  }
+
+  // Capture the element for the base document instead of our output.
+  std::string element;
+  {
+    llvm::raw_string_ostream rso(element);
+    llvm::raw_ostream& os = this->BaseOS->SetTarget(rso);
+    this->InBase = true;
+    this->BaseMembers = merge? &bn->Members : nullptr;
+    this->OutputQueueEntry(qe);
+    this->BaseMembers = nullptr;
+    this->InBase = false;
+    this->BaseOS->SetTarget(os);
+  }
+  if(bn->Written && bn->Complete) {
+    return;
+  }
+  bn->Element = element;
+  bn->Written = true;
+  bn->Complete = qe.DN->Complete;
+}
+
 //----------------------------------------------------------------------------
 void ASTVisitor::ProcessFileQueue()
 {
   if(this->FileBuiltin) {
-    this->OS <<
-      "  <File id=\"f0\" name=\"" << encodeXML("<builtin>") << "\"/>\n"
-      ;
+    this->Format.StartElement("File");
+    this->Format.FileId(0);
+    this->Format.String("name", "<builtin>");
+    this->Format.EndElement();
   }
   while(!this->FileQueue.empty()) {
     clang::FileEntry const* f = this->FileQueue.front();
     this->FileQueue.pop();
-    this->OS <<
-      "  <File"
-      " id=\"f" << this->FileNodes[f] << "\""
-      " name=\"" << encodeXML(f->getName()) << "\""
-      "/>\n"
-      ;
+    this->Format.StartElement("File");
+    this->Format.FileId(this->FileNodes[f]);
+    this->Format.String("name", f->getName());
+    this->Format.EndElement();
   }
 }
 
@@ -954,22 +1612,23 @@ void ASTVisitor::OutputCvQualifiedType(DumpNode const* dn)
 
   // Create a special CvQualifiedType element to hold top-level
   // cv-qualifiers for a real type node.
-  this->OS << "  <CvQualifiedType id=\"_" << id << "\"";
+  this->Format.StartElement("CvQualifiedType");
+  this->Format.Ref("id", id.Ref());
 
   // Refer to the unqualified type.
-  this->OS << " type=\"_" << id.Id << "\"";
+  this->Format.Ref("type", DumpId(id.Id, DumpQual(), id.Base).Ref());
 
   // Add the cv-qualification attributes.
   if (id.Qual.IsConst) {
-    this->OS << " const=\"1\"";
+    this->Format.Flag("const");
   }
   if (id.Qual.IsVolatile) {
-    this->OS << " volatile=\"1\"";
+    this->Format.Flag("volatile");
   }
   if (id.Qual.IsRestrict) {
-    this->OS << " restrict=\"1\"";
+    this->Format.Flag("restrict");
   }
-  this->OS << "/>\n";
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
@@ -997,25 +1656,22 @@ std::string ASTVisitor::GetContextName(clang::CXXMethodDecl const* d)
 }
 
 //----------------------------------------------------------------------------
-void ASTVisitor::PrintTypeIdRef(clang::QualType t, bool complete)
+OutputRef ASTVisitor::GetTypeIdRef(clang::QualType t, bool complete)
 {
   // Add the type node.
-  DumpId id = this->AddTypeDumpNode(t, complete);
-
-  // Print the reference.
-  this->OS << "_" << id;
+  return this->AddTypeDumpNode(t, complete).Ref();
 }
 
 //----------------------------------------------------------------------------
 void ASTVisitor::PrintIdAttribute(DumpNode const* dn)
 {
-  this->OS << " id=\"_" << dn->Index << "\"";
+  this->Format.Ref("id", dn->Index.Ref());
 }
 
 //----------------------------------------------------------------------------
 void ASTVisitor::PrintNameAttribute(std::string const& name)
 {
-  this->OS << " name=\"" << encodeXML(name) << "\"";
+  this->Format.String("name", name);
 }
 
 //----------------------------------------------------------------------------
@@ -1033,13 +1689,13 @@ void ASTVisitor::PrintMangledAttribute(clang::NamedDecl const* d)
     s = s.substr(1);
   }
 
-  this->OS << " mangled=\"" << encodeXML(s) << "\"";
+  this->Format.String("mangled", s);
 }
 
 //----------------------------------------------------------------------------
 void ASTVisitor::PrintOffsetAttribute(unsigned int const& offset)
 {
-  this->OS << " offset=\"" << offset << "\"";
+  this->Format.Number("offset", toDecimal(offset));
 }
 
 //----------------------------------------------------------------------------
@@ -1056,32 +1712,27 @@ void ASTVisitor::PrintABIAttributes(clang::TypeDecl const* d)
 //----------------------------------------------------------------------------
 void ASTVisitor::PrintABIAttributes(clang::TypeInfo const& t)
 {
-  this->OS << " size=\"" << t.Width << "\"";
-  this->OS << " align=\"" << t.Align << "\"";
+  this->Format.Number("size", toDecimal(t.Width));
+  this->Format.Number("align", toDecimal(t.Align));
 }
 
 //----------------------------------------------------------------------------
 void ASTVisitor::PrintBaseTypeAttribute(clang::Type const* c, bool complete)
 {
-  this->OS << " basetype=\"";
-  this->PrintTypeIdRef(clang::QualType(c, 0), complete);
-  this->OS << "\"";
+  this->Format.Ref("basetype", this->GetTypeIdRef(clang::QualType(c, 0),
+                                                 complete));
 }
 
 //----------------------------------------------------------------------------
 void ASTVisitor::PrintTypeAttribute(clang::QualType t, bool complete)
 {
-  this->OS << " type=\"";
-  this->PrintTypeIdRef(t, complete);
-  this->OS << "\"";
+  this->Format.Ref("type", this->GetTypeIdRef(t, complete));
 }
 
 //----------------------------------------------------------------------------
 void ASTVisitor::PrintReturnsAttribute(clang::QualType t, bool complete)
 {
-  this->OS << " returns=\"";
-  this->PrintTypeIdRef(t, complete);
-  this->OS << "\"";
+  this->Format.Ref("returns", this->GetTypeIdRef(t, complete));
 }
 
 //----------------------------------------------------------------------------
@@ -1094,16 +1745,17 @@ void ASTVisitor::PrintLocationAttribute(clang::Decl const* d)
         this->CI.getSourceManager().getFileEntryForID(fsl.getFileID())) {
       unsigned int id = this->AddDumpFile(f);
       unsigned int line = fsl.getExpansionLineNumber();
-      this->OS <<
-        " location=\"f" << id << ":" << line << "\""
-        " file=\"f" << id << "\""
-        " line=\"" << line << "\"";
+      this->Format.Location(id, line);
       return;
     }
   }
   if(d->isImplicit()) {
-    this->FileBuiltin = true;
-    this->OS << " location=\"f0:0\" file=\"f0\" line=\"0\"";
+    if(this->InBase) {
+      this->Base->FileBuiltin = true;
+    } else {
+      this->FileBuiltin = true;
+    }
+    this->Format.Location(0, 0);
   }
 }
 
@@ -1111,11 +1763,11 @@ void ASTVisitor::PrintLocationAttribute(clang::Decl const* d)
 void ASTVisitor::PrintAccessAttribute(clang::AccessSpecifier as)
 {
   if (as == clang::AS_private) {
-    this->OS << " access=\"private\"";
+    this->Format.String("access", "private");
   } else if (as == clang::AS_protected) {
-    this->OS << " access=\"protected\"";
+    this->Format.String("access", "protected");
   } else {
-    this->OS << " access=\"public\"";
+    this->Format.String("access", "public");
   }
 }
 
@@ -1124,7 +1776,7 @@ void ASTVisitor::PrintContextAttribute(clang::Decl const* d)
 {
   clang::DeclContext const* dc = d->getDeclContext();
   if(DumpId id = this->GetContextIdRef(dc)) {
-    this->OS << " context=\"_" << id << "\"";
+    this->Format.Ref("context", id.Ref());
     if (dc->isRecord()) {
       this->PrintAccessAttribute(d->getAccess());
     }
@@ -1142,35 +1794,57 @@ void ASTVisitor::PrintMembersAttribute(clang::DeclContext const* dc)
 //----------------------------------------------------------------------------
 void ASTVisitor::PrintMembersAttribute(std::set<DumpId> const& emitted)
 {
-  if(!emitted.empty()) {
-    this->OS << " members=\"";
-    const char* sep = "";
+  std::set<DumpId> shared;
+  std::set<DumpId> const* members = &emitted;
+  if(this->InBase) {
+    // An element of the base document lists only shared members.  The
+    // others refer to it only through their context attribute.
     for(std::set<DumpId>::const_iterator i = emitted.begin(),
           e = emitted.end(); i != e; ++i) {
-      this->OS << sep << "_" << *i;
-      sep = " ";
+      if(i->Base) {
+        shared.insert(*i);
+      }
+    }
+    members = &shared;
+
+    // The members of a namespace are merged over all translation units
+    // and listed in place of a marker when the base document is written.
+    if(this->BaseMembers) {
+      for(std::set<DumpId>::const_iterator i = shared.begin(),
+            e = shared.end(); i != e; ++i) {
+        this->BaseMembers->insert(i->Id);
+      }
+      this->Format.Marker(OutputBase::MembersMarker);
+      return;
     }
-    this->OS << "\"";
+  }
+
+  if(!members->empty()) {
+    std::vector<OutputRef> refs;
+    for(std::set<DumpId>::const_iterator i = members->begin(),
+          e = members->end(); i != e; ++i) {
+      refs.push_back(i->Ref());
+    }
+    this->Format.RefList("members", refs);
   }
 }
 
 //----------------------------------------------------------------------------
 void ASTVisitor::PrintBasesAttribute(clang::CXXRecordDecl const* dx)
 {
-  this->OS << " bases=\"";
-  const char* sep = "";
+  std::vector<OutputBaseRef> bases;
   for(clang::CXXRecordDecl::base_class_const_iterator i = dx->bases_begin(),
         e = dx->bases_end(); i != e; ++i) {
-    this->OS << sep;
-    sep = " ";
+    const char* access;
     switch (i->getAccessSpecifier()) {
-    case clang::AS_private: this->OS << "private:"; break;
-    case clang::AS_protected: this->OS << "protected:"; break;
-    default: break;
+    case clang::AS_private: access = "private"; break;
+    case clang::AS_protected: access = "protected"; break;
+    default: access = "public"; break;
     }
-    this->PrintTypeIdRef(i->getType().getCanonicalType(), true);
+    bases.push_back(OutputBaseRef(access, this->GetTypeIdRef(
+                                    i->getType().getCanonicalType(), true)));
   }
-  this->OS << "\"";
+  this->Format.Bases(bases);
 }
 
 //----------------------------------------------------------------------------
@@ -1180,13 +1854,13 @@ void ASTVisitor::PrintFunctionTypeAttributes(clang::FunctionProtoType const* t)
   case clang::CallingConv::CC_C:
     break;
   case clang::CallingConv::CC_X86StdCall:
-    this->OS << " attributes=\"__stdcall__\"";
+    this->Format.String("attributes", "__stdcall__");
     break;
   case clang::CallingConv::CC_X86FastCall:
-    this->OS << " attributes=\"__fastcall__\"";
+    this->Format.String("attributes", "__fastcall__");
     break;
   case clang::CallingConv::CC_X86ThisCall:
-    this->OS << " attributes=\"__thiscall__\"";
+    this->Format.String("attributes", "__thiscall__");
     break;
   default:
     break;
@@ -1200,14 +1874,11 @@ void ASTVisitor::PrintThrowsAttribute(clang::FunctionProtoType const* fpt,
   if(fpt && fpt->hasDynamicExceptionSpec()) {
     clang::FunctionProtoType::exception_iterator i = fpt->exception_begin();
     clang::FunctionProtoType::exception_iterator e = fpt->exception_end();
-    this->OS << " throw=\"";
-    const char* sep = "";
+    std::vector<OutputRef> refs;
     for(;i != e; ++i) {
-      this->OS << sep;
-      this->PrintTypeIdRef(*i, complete);
-      sep = " ";
+      refs.push_back(this->GetTypeIdRef(*i, complete));
     }
-    this->OS << "\"";
+    this->Format.RefList("throw", refs);
   }
 }
 
@@ -1215,8 +1886,7 @@ void ASTVisitor::PrintThrowsAttribute(clang::FunctionProtoType const* fpt,
 void ASTVisitor::PrintBefriendingAttribute(clang::CXXRecordDecl const* dx)
 {
   if(dx && dx->hasFriends()) {
-    this->OS << " befriending=\"";
-    const char* sep = "";
+    std::vector<OutputRef> refs;
     for(clang::CXXRecordDecl::friend_iterator i = dx->friend_begin(),
           e = dx->friend_end(); i != e; ++i) {
       clang::FriendDecl const* fd = *i;
@@ -1227,19 +1897,27 @@ void ASTVisitor::PrintBefriendingAttribute(clang::CXXRecordDecl const* dx)
         }
 
         if(DumpId id = this->AddDeclDumpNode(nd, false)) {
-          this->OS << sep << "_" << id;
-          sep = " ";
+          this->AddBefriendingId(id, refs);
         }
       } else if(clang::TypeSourceInfo const* tsi = fd->getFriendType()) {
-        this->OS << sep;
-        this->PrintTypeIdRef(tsi->getType(), false);
-        sep = " ";
+        this->AddBefriendingId(
+          this->AddTypeDumpNode(tsi->getType(), false), refs);
       }
     }
-    this->OS << "\"";
+    this->Format.RefList("befriending", refs);
   }
 }
 
+//----------------------------------------------------------------------------
+void ASTVisitor::AddBefriendingId(DumpId id, std::vector<OutputRef>& ids)
+{
+  // An element of the base document may not reference unshared nodes.
+  if(this->InBase && !id.Base) {
+    return;
+  }
+  ids.push_back(id.Ref());
+}
+
 //----------------------------------------------------------------------------
 void ASTVisitor::OutputFunctionHelper(clang::FunctionDecl const* d,
                                       DumpNode const* dn,
@@ -1247,7 +1925,7 @@ void ASTVisitor::OutputFunctionHelper(clang::FunctionDecl const* d,
                                       std::string const& name,
                                       unsigned int flags)
 {
-  this->OS << "  <" << tag;
+  this->Format.StartElement(tag);
   this->PrintIdAttribute(dn);
   if(!name.empty()) {
     this->PrintNameAttribute(name);
@@ -1259,28 +1937,28 @@ void ASTVisitor::OutputFunctionHelper(clang::FunctionDecl const* d,
   this->PrintLocationAttribute(d);
 
   if(flags & FH_Static) {
-    this->OS << " static=\"1\"";
+    this->Format.Flag("static");
   }
   if(flags & FH_Explicit) {
-    this->OS << " explicit=\"1\"";
+    this->Format.Flag("explicit");
   }
   if(flags & FH_Const) {
-    this->OS << " const=\"1\"";
+    this->Format.Flag("const");
   }
   if(flags & FH_Virtual) {
-    this->OS << " virtual=\"1\"";
+    this->Format.Flag("virtual");
   }
   if(flags & FH_Pure) {
-    this->OS << " pure_virtual=\"1\"";
+    this->Format.Flag("pure_virtual");
   }
   if(d->isInlined()) {
-    this->OS << " inline=\"1\"";
+    this->Format.Flag("inline");
   }
   if(d->getStorageClass() == clang::SC_Extern) {
-    this->OS << " extern=\"1\"";
+    this->Format.Flag("extern");
   }
   if(d->isImplicit()) {
-    this->OS << " artificial=\"1\"";
+    this->Format.Flag("artificial");
   }
 
   if (clang::FunctionProtoType const* fpt =
@@ -1294,7 +1972,6 @@ void ASTVisitor::OutputFunctionHelper(clang::FunctionDecl const* d,
   }
 
   if(unsigned np = d->getNumParams()) {
-    this->OS << ">\n";
     for (unsigned i = 0; i < np; ++i) {
       // Use the default argument from the most recent declaration.
       // Clang accumulates the defaults and only the last one has
@@ -1309,12 +1986,11 @@ void ASTVisitor::OutputFunctionHelper(clang::FunctionDecl const* d,
       this->OutputFunctionArgument(d->getParamDecl(i), dn->Complete, def);
     }
     if(d->isVariadic()) {
-      this->OS << "    <Ellipsis/>\n";
+      this->Format.StartElement("Ellipsis");
+      this->Format.EndElement();
     }
-    this->OS << "  </" << tag << ">\n";
-  } else {
-    this->OS << "/>\n";
   }
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
@@ -1322,44 +1998,42 @@ void ASTVisitor::OutputFunctionTypeHelper(clang::FunctionProtoType const* t,
                                           DumpNode const* dn, const char* tag,
                                           clang::Type const* c)
 {
-  this->OS << "  <" << tag;
+  this->Format.StartElement(tag);
   this->PrintIdAttribute(dn);
   if(c) {
     this->PrintBaseTypeAttribute(c, dn->Complete);
   }
   this->PrintReturnsAttribute(t->getReturnType(), dn->Complete);
   if(t->isConst()) {
-    this->OS << " const=\"1\"";
+    this->Format.Flag("const");
   }
   if(t->isVolatile()) {
-    this->OS << " volatile=\"1\"";
+    this->Format.Flag("volatile");
   }
   if(t->isRestrict()) {
-    this->OS << " restrict=\"1\"";
+    this->Format.Flag("restrict");
   }
   this->PrintFunctionTypeAttributes(t);
   if(t->param_type_begin() != t->param_type_end()) {
-    this->OS << ">\n";
     for (clang::FunctionProtoType::param_type_iterator
            i = t->param_type_begin(), e = t->param_type_end(); i != e; ++i) {
-      this->OS << "    <Argument";
+      this->Format.StartElement("Argument");
       this->PrintTypeAttribute(*i, dn->Complete);
-      this->OS << "/>\n";
+      this->Format.EndElement();
     }
     if(t->isVariadic()) {
-      this->OS << "    <Ellipsis/>\n";
+      this->Format.StartElement("Ellipsis");
+      this->Format.EndElement();
     }
-    this->OS << "  </" << tag << ">\n";
-  } else {
-    this->OS << "/>\n";
   }
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
 void ASTVisitor::OutputFunctionArgument(clang::ParmVarDecl const* a,
                                         bool complete, clang::Expr const* def)
 {
-  this->OS << "    <Argument";
+  this->Format.StartElement("Argument");
   std::string name = a->getName().str();
   if(!name.empty()) {
     this->PrintNameAttribute(name);
@@ -1367,34 +2041,32 @@ void ASTVisitor::OutputFunctionArgument(clang::ParmVarDecl const* a,
   this->PrintTypeAttribute(a->getType(), complete);
   this->PrintLocationAttribute(a);
   if(def) {
-    this->OS << " default=\"";
     std::string s;
     llvm::raw_string_ostream rso(s);
     def->printPretty(rso, 0, this->PrintingPolicy);
-    this->OS << encodeXML(rso.str());
-    this->OS << "\"";
+    this->Format.String("default", rso.str());
   }
-  this->OS << "/>\n";
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
 void ASTVisitor::OutputTranslationUnitDecl(
   clang::TranslationUnitDecl const* d, DumpNode const* dn)
 {
-  this->OS << "  <Namespace";
+  this->Format.StartElement("Namespace");
   this->PrintIdAttribute(dn);
   this->PrintNameAttribute("::");
   if(dn->Complete) {
     this->PrintMembersAttribute(d);
   }
-  this->OS << "/>\n";
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
 void ASTVisitor::OutputNamespaceDecl(
   clang::NamespaceDecl const* d, DumpNode const* dn)
 {
-  this->OS << "  <Namespace";
+  this->Format.StartElement("Namespace");
   this->PrintIdAttribute(dn);
   std::string name = d->getName().str();
   if (!name.empty()) {
@@ -1408,7 +2080,7 @@ void ASTVisitor::OutputNamespaceDecl(
     }
     this->PrintMembersAttribute(emitted);
   }
-  this->OS << "/>\n";
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
@@ -1426,7 +2098,7 @@ void ASTVisitor::OutputRecordDecl(clang::RecordDecl const* d,
   clang::CXXRecordDecl const* dx = clang::dyn_cast<clang::CXXRecordDecl>(d);
   bool doBases = false;
 
-  this->OS << "  <" << tag;
+  this->Format.StartElement(tag);
   this->PrintIdAttribute(dn);
   if(!d->isAnonymousStructOrUnion()) {
     std::string s;
@@ -1438,7 +2110,7 @@ void ASTVisitor::OutputRecordDecl(clang::RecordDecl const* d,
   this->PrintLocationAttribute(d);
   if(d->getDefinition()) {
     if(dx && dx->isAbstract()) {
-      this->OS << " abstract=\"1\"";
+      this->Format.Flag("abstract");
     }
     if(dn->Complete) {
       this->PrintMembersAttribute(d);
@@ -1449,23 +2121,20 @@ void ASTVisitor::OutputRecordDecl(clang::RecordDecl const* d,
       this->PrintBefriendingAttribute(dx);
     }
   } else {
-    this->OS << " incomplete=\"1\"";
+    this->Format.Flag("incomplete");
   }
   this->PrintABIAttributes(d);
   if(doBases) {
-    this->OS << ">\n";
     for(clang::CXXRecordDecl::base_class_const_iterator i = dx->bases_begin(),
           e = dx->bases_end(); i != e; ++i) {
-      this->OS << "    <Base";
+      this->Format.StartElement("Base");
       this->PrintTypeAttribute(i->getType().getCanonicalType(), true);
       this->PrintAccessAttribute(i->getAccessSpecifier());
-      this->OS << " virtual=\"" << (i->isVirtual()? 1 : 0) << "\"";
-      this->OS << "/>\n";
+      this->Format.Bool("virtual", i->isVirtual());
+      this->Format.EndElement();
     }
-    this->OS << "  </" << tag << ">\n";
-  } else {
-    this->OS << "/>\n";
   }
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
@@ -1492,19 +2161,19 @@ void ASTVisitor::OutputClassTemplateSpecializationDecl(
 void ASTVisitor::OutputTypedefDecl(clang::TypedefDecl const* d,
                                    DumpNode const* dn)
 {
-  this->OS << "  <Typedef";
+  this->Format.StartElement("Typedef");
   this->PrintIdAttribute(dn);
   this->PrintNameAttribute(d->getName().str());
   this->PrintTypeAttribute(d->getUnderlyingType(), dn->Complete);
   this->PrintContextAttribute(d);
   this->PrintLocationAttribute(d);
-  this->OS << "/>\n";
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
 void ASTVisitor::OutputEnumDecl(clang::EnumDecl const* d, DumpNode const* dn)
 {
-  this->OS << "  <Enumeration";
+  this->Format.StartElement("Enumeration");
   this->PrintIdAttribute(dn);
   std::string name = d->getName().str();
   if(name.empty()) {
@@ -1517,69 +2186,62 @@ void ASTVisitor::OutputEnumDecl(clang::EnumDecl const* d, DumpNode const* dn)
   this->PrintLocationAttribute(d);
   clang::EnumDecl::enumerator_iterator enum_begin = d->enumerator_begin();
   clang::EnumDecl::enumerator_iterator enum_end = d->enumerator_end();
-  if(enum_begin != enum_end) {
-    this->OS << ">\n";
-    for(clang::EnumDecl::enumerator_iterator i = enum_begin;
-        i != enum_end; ++i) {
-      clang::EnumConstantDecl const* ecd = *i;
-      this->OS << "    <EnumValue";
-      this->PrintNameAttribute(ecd->getName());
-      this->OS << " init=\"" << ecd->getInitVal() << "\"";
-      this->OS << "/>\n";
-    }
-    this->OS << "  </Enumeration>\n";
-  } else {
-    this->OS << "/>\n";
+  for(clang::EnumDecl::enumerator_iterator i = enum_begin;
+      i != enum_end; ++i) {
+    clang::EnumConstantDecl const* ecd = *i;
+    this->Format.StartElement("EnumValue");
+    this->PrintNameAttribute(ecd->getName());
+    this->Format.Number("init", toDecimal(ecd->getInitVal()));
+    this->Format.EndElement();
   }
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
 void ASTVisitor::OutputFieldDecl(clang::FieldDecl const* d, DumpNode const* dn)
 {
-  this->OS << "  <Field";
+  this->Format.StartElement("Field");
   this->PrintIdAttribute(dn);
   this->PrintNameAttribute(d->getName().str());
   this->PrintTypeAttribute(d->getType(), dn->Complete);
   if(d->isBitField()) {
     unsigned bits = d->getBitWidthValue(this->CTX);
-    this->OS << " bits=\"" << bits << "\"";
+    this->Format.Number("bits", toDecimal(bits));
   }
   this->PrintContextAttribute(d);
   this->PrintLocationAttribute(d);
   this->PrintOffsetAttribute(this->CTX.getFieldOffset(d));
   if(d->isMutable()) {
-    this->OS << " mutable=\"1\"";
+    this->Format.Flag("mutable");
   }
 
-  this->OS << "/>\n";
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
 void ASTVisitor::OutputVarDecl(clang::VarDecl const* d, DumpNode const* dn)
 {
-  this->OS << "  <Variable";
+  this->Format.StartElement("Variable");
   this->PrintIdAttribute(dn);
   this->PrintNameAttribute(d->getName().str());
   this->PrintTypeAttribute(d->getType(), dn->Complete);
   if(clang::Expr const* init = d->getInit()) {
-    this->OS << " init=\"";
     std::string s;
     llvm::raw_string_ostream rso(s);
     init->printPretty(rso, 0, this->PrintingPolicy);
-    this->OS << encodeXML(rso.str());
-    this->OS << "\"";
+    this->Format.String("init", rso.str());
   }
   this->PrintContextAttribute(d);
   this->PrintLocationAttribute(d);
   if(d->getStorageClass() == clang::SC_Static) {
-    this->OS << " static=\"1\"";
+    this->Format.Flag("static");
   }
   if(d->getStorageClass() == clang::SC_Extern) {
-    this->OS << " extern=\"1\"";
+    this->Format.Flag("extern");
   }
   this->PrintMangledAttribute(d);
 
-  this->OS << "/>\n";
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
@@ -1701,7 +2363,7 @@ void ASTVisitor::OutputCXXDestructorDecl(clang::CXXDestructorDecl const* d,
 void ASTVisitor::OutputBuiltinType(clang::BuiltinType const* t,
                                    DumpNode const* dn)
 {
-  this->OS << "  <FundamentalType";
+  this->Format.StartElement("FundamentalType");
   this->PrintIdAttribute(dn);
 
   // gccxml used different name variants than Clang for some types
@@ -1718,29 +2380,31 @@ void ASTVisitor::OutputBuiltinType(clang::BuiltinType const* t,
   this->PrintNameAttribute(name);
   this->PrintABIAttributes(this->CTX.getTypeInfo(t));
 
-  this->OS << "/>\n";
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
 void ASTVisitor::OutputConstantArrayType(clang::ConstantArrayType const* t,
                                          DumpNode const* dn)
 {
-  this->OS << "  <ArrayType";
+  this->Format.StartElement("ArrayType");
   this->PrintIdAttribute(dn);
-  this->OS << " min=\"0\" max=\"" << (t->getSize()-1) << "\"";
+  this->Format.Number("min", "0");
+  this->Format.Number("max", toDecimal(t->getSize()-1));
   this->PrintTypeAttribute(t->getElementType(), dn->Complete);
-  this->OS << "/>\n";
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
 void ASTVisitor::OutputIncompleteArrayType(clang::IncompleteArrayType const* t,
                                            DumpNode const* dn)
 {
-  this->OS << "  <ArrayType";
+  this->Format.StartElement("ArrayType");
   this->PrintIdAttribute(dn);
-  this->OS << " min=\"0\" max=\"\"";
+  this->Format.Number("min", "0");
+  this->Format.Null("max");
   this->PrintTypeAttribute(t->getElementType(), dn->Complete);
-  this->OS << "/>\n";
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
@@ -1754,10 +2418,10 @@ void ASTVisitor::OutputFunctionProtoType(clang::FunctionProtoType const* t,
 void ASTVisitor::OutputLValueReferenceType(clang::LValueReferenceType const* t,
                                            DumpNode const* dn)
 {
-  this->OS << "  <ReferenceType";
+  this->Format.StartElement("ReferenceType");
   this->PrintIdAttribute(dn);
   this->PrintTypeAttribute(t->getPointeeType(), false);
-  this->OS << "/>\n";
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
@@ -1767,12 +2431,12 @@ void ASTVisitor::OutputMemberPointerType(clang::MemberPointerType const* t,
   if(t->isMemberDataPointerType()) {
     this->OutputOffsetType(t->getPointeeType(), t->getClass(), dn);
   } else {
-    this->OS << "  <PointerType";
+    this->Format.StartElement("PointerType");
     this->PrintIdAttribute(dn);
     DumpId id = this->AddTypeDumpNode(
       DumpType(t->getPointeeType(), t->getClass()), false);
-    this->OS << " type=\"_" << id << "\"";
-    this->OS << "/>\n";
+    this->Format.Ref("type", id.Ref());
+    this->Format.EndElement();
   }
 }
 
@@ -1787,72 +2451,47 @@ void ASTVisitor::OutputMethodType(clang::FunctionProtoType const* t,
 void ASTVisitor::OutputOffsetType(clang::QualType t, clang::Type const* c,
                                   DumpNode const* dn)
 {
-  this->OS << "  <OffsetType";
+  this->Format.StartElement("OffsetType");
   this->PrintIdAttribute(dn);
   this->PrintBaseTypeAttribute(c, dn->Complete);
   this->PrintTypeAttribute(t, dn->Complete);
-  this->OS << "/>\n";
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
 void ASTVisitor::OutputPointerType(clang::PointerType const* t,
                                    DumpNode const* dn)
 {
-  this->OS << "  <PointerType";
+  this->Format.StartElement("PointerType");
   this->PrintIdAttribute(dn);
   this->PrintTypeAttribute(t->getPointeeType(), false);
-  this->OS << "/>\n";
+  this->Format.EndElement();
 }
 
 //----------------------------------------------------------------------------
-void ASTVisitor::LookupStart(clang::DeclContext const* dc,
-                             std::string const& name)
-{
-  std::string::size_type pos = name.find("::");
-  std::string cur = name.substr(0, pos);
-
-  clang::IdentifierTable& ids = CI.getPreprocessor().getIdentifierTable();
-  auto const& result = dc->lookup(clang::DeclarationName(&ids.get(cur)));
-  if(pos == name.npos) {
-    for (clang::NamedDecl const* n: result) {
-      this->AddStartDecl(n);
-    }
-  } else {
-    std::string rest = name.substr(pos+2);
-    for (clang::NamedDecl const* n: result) {
-      if (clang::DeclContext const* idc =
-          clang::dyn_cast<clang::DeclContext const>(n)) {
-        this->LookupStart(idc, rest);
-      }
-    }
-  }
-
-  for (clang::UsingDirectiveDecl const* i : dc->using_directives()) {
-    this->LookupStart(i->getNominatedNamespace(), name);
-  }
-}
-
-//----------------------------------------------------------------------------
-void ASTVisitor::HandleTranslationUnit(clang::TranslationUnitDecl const* tu)
+void ASTVisitor::HandleTranslationUnit(
+  clang::TranslationUnitDecl const* tu,
+  std::vector<clang::Decl const*> const& starts)
 {
   // Add the starting nodes for the dump.
-  if(!this->Opts.StartNames.empty()) {
+  if(!this->Opts.StartNames.empty() || !starts.empty()) {
     // Use the specified starting locations.
-    for(std::vector<std::string>::const_iterator
-          i = this->Opts.StartNames.begin(), e = this->Opts.StartNames.end();
-        i != e; ++i) {
-      this->LookupStart(tu, *i);
+    std::vector<clang::Decl const*> named;
+    lookupStartNames(this->CI, tu, this->Opts.StartNames, named);
+    for(clang::Decl const* d : named) {
+      this->AddStartDecl(d);
+    }
+    for(clang::Decl const* d : starts) {
+      this->AddStartDecl(d);
     }
   } else {
     // No start specified.  Use whole translation unit.
     this->AddStartDecl(tu);
   }
 
-  // Start dump with gccxml-compatible format.
-  this->OS <<
-    "<?xml version=\"1.0\"?>\n"
-    "<GCC_XML version=\"0.9.0\" cvs_revision=\"1.136\">\n"
-    ;
+  // Start dump with gccxml-compatible format.  Name the base document
+  // that the _b<n> ids refer to, if any.
+  this->Format.StartDocument(this->Base? this->Opts.GccXmlBase : "");
 
   // Dump the complete nodes.
   this->ProcessQueue();
@@ -1868,17 +2507,161 @@ void ASTVisitor::HandleTranslationUnit(clang::TranslationUnitDecl const* tu)
   this->ProcessFileQueue();
 
   // Finish dump.
-  this->OS <<
-    "</GCC_XML>\n"
-    ;
+  this->Format.EndDocument();
+}
+
+//----------------------------------------------------------------------------
+static std::unique_ptr<OutputFormat> createOutputFormat(llvm::raw_ostream& os,
+                                                       Options const& opts)
+{
+  if(opts.GccXmlJson) {
+    return std::unique_ptr<OutputFormat>(new OutputFormatJSON(os));
+  }
+  return std::unique_ptr<OutputFormat>(new OutputFormatXML(os));
 }
 
 //----------------------------------------------------------------------------
 void outputXML(clang::CompilerInstance& ci,
                clang::ASTContext& ctx,
                llvm::raw_ostream& os,
-               Options const& opts)
+               Options const& opts,
+               std::vector<clang::Decl const*> const& starts,
+               OutputBase* base)
+{
+  // Route output through a stream we can switch to the base document.
+  std::unique_ptr<SwitchOStream> bos;
+  std::unique_ptr<OutputFormat> format;
+  std::unique_ptr<ASTVisitor> v;
+  if(base) {
+    bos.reset(new SwitchOStream(os));
+    format = createOutputFormat(*bos, opts);
+    v.reset(new ASTVisitor(ci, ctx, *format, opts, base, bos.get()));
+  } else {
+    format = createOutputFormat(os, opts);
+    v.reset(new ASTVisitor(ci, ctx, *format, opts));
+  }
+  v->HandleTranslationUnit(ctx.getTranslationUnitDecl(), starts);
+
+  std::string const& error = format->GetError();
+  if(!error.empty()) {
+    clang::DiagnosticsEngine& diags = ci.getDiagnostics();
+    diags.Report(diags.getCustomDiagID(
+                   clang::DiagnosticsEngine::Error,
+                   "cannot write output as JSON: %0")) << error;
+  }
+
+  // Leave the maps built by the visitor to be reclaimed at exit along
+  // with the AST when Clang does not free its state.
+  if(ci.getFrontendOpts().DisableFree) {
+    clang::BuryPointer(std::move(v));
+  }
+}
+
+//----------------------------------------------------------------------------
+static void lookupStartName(clang::CompilerInstance& ci,
+                            clang::DeclContext const* dc,
+                            std::string const& name,
+                            std::vector<clang::Decl const*>& decls)
 {
-  ASTVisitor v(ci, ctx, os, opts);
-  v.HandleTranslationUnit(ctx.getTranslationUnitDecl());
+  std::string::size_type pos = name.find("::");
+  std::string cur = name.substr(0, pos);
+
+  clang::IdentifierTable& ids = ci.getPreprocessor().getIdentifierTable();
+  auto const& result = dc->lookup(clang::DeclarationName(&ids.get(cur)));
+  if(pos == name.npos) {
+    for (clang::NamedDecl const* n: result) {
+      decls.push_back(n);
+    }
+  } else {
+    std::string rest = name.substr(pos+2);
+    for (clang::NamedDecl const* n: result) {
+      if (clang::DeclContext const* idc =
+          clang::dyn_cast<clang::DeclContext const>(n)) {
+        lookupStartName(ci, idc, rest, decls);
+      }
+    }
+  }
+
+  for (clang::UsingDirectiveDecl const* i : dc->using_directives()) {
+    lookupStartName(ci, i->getNominatedNamespace(), name, decls);
+  }
+}
+
+//----------------------------------------------------------------------------
+void lookupStartNames(clang::CompilerInstance& ci,
+                      clang::TranslationUnitDecl const* tu,
+                      std::vector<std::string> const& names,
+                      std::vector<clang::Decl const*>& decls)
+{
+  for(std::string const& name : names) {
+    lookupStartName(ci, tu, name, decls);
+  }
+}
+
+//----------------------------------------------------------------------------
+static bool OrderBaseNodes(OutputBase::Node const* l,
+                           OutputBase::Node const* r)
+{
+  return l->Id < r->Id;
+}
+
+//----------------------------------------------------------------------------
+bool outputXMLBase(OutputBase const& base, llvm::raw_ostream& os,
+                   Options const& opts, std::string& error)
+{
+  // Order the written nodes by index.
+  std::vector<OutputBase::Node const*> nodes;
+  for(OutputBase::NodesMap::const_iterator i = base.Nodes.begin(),
+        e = base.Nodes.end(); i != e; ++i) {
+    if(i->second.Written) {
+      nodes.push_back(&i->second);
+    }
+  }
+  std::stable_sort(nodes.begin(), nodes.end(), OrderBaseNodes);
+
+  // Order the file names by index.
+  std::vector<std::string const*> files(base.FileCount + 1);
+  for(OutputBase::FilesMap::const_iterator i = base.Files.begin(),
+        e = base.Files.end(); i != e; ++i) {
+    files[i->second] = &i->first;
+  }
+
+  // The elements were written in the requested format when captured.
+  std::unique_ptr<OutputFormat> format = createOutputFormat(os, opts);
+  format->StartDocument("");
+  for(std::vector<OutputBase::Node const*>::const_iterator
+        i = nodes.begin(), e = nodes.end(); i != e; ++i) {
+    OutputBase::Node const* n = *i;
+    std::string::size_type pos = n->Element.find(OutputBase::MembersMarker);
+    if(pos == std::string::npos) {
+      os << n->Element;
+      continue;
+    }
+    // List the members merged over all translation units.
+    os << n->Element.substr(0, pos);
+    if(!n->Members.empty()) {
+      std::vector<OutputRef> refs;
+      for(std::set<unsigned int>::const_iterator j = n->Members.begin(),
+            je = n->Members.end(); j != je; ++j) {
+        refs.push_back(OutputRef(*j, 0, true));
+      }
+      format->RefList("members", refs);
+    }
+    os << n->Element.substr(pos + 1);
+  }
+  if(base.FileBuiltin) {
+    format->StartElement("File");
+    format->FileId(0);
+    format->String("name", "<builtin>");
+    format->EndElement();
+  }
+  for(unsigned int i = 1; i <= base.FileCount; ++i) {
+    format->StartElement("File");
+    format->FileId(i);
+    format->String("name", *files[i]);
+    format->EndElement();
+  }
+  format->EndDocument();
+  error = format->GetError();
+  return error.empty();
 }
@@ -18,6 +18,11 @@
 
 #include <cxsys/Configure.hxx>
 
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
 namespace llvm {
   class raw_ostream;
 }
@@ -25,14 +30,71 @@ namespace llvm {
 namespace clang {
   class CompilerInstance;
   class ASTContext;
+  class Decl;
+  class TranslationUnitDecl;
 }
 
 struct Options;
 
-/// outputXML - Print a gccxml-compatible AST dump.
+/// OutputBase - Nodes shared by the gccxml-format outputs of several
+/// translation units.  Nodes are identified across translation units
+/// by the USR of their declaration and written once to a base document.
+/// Members of a namespace are merged over all translation units.
+struct OutputBase
+{
+  OutputBase(): NodeCount(0), FileCount(0), FileBuiltin(false) {}
+
+  /// One element of the base document.
+  struct Node {
+    Node(): Id(0), Written(false), Complete(false) {}
+    unsigned int Id;
+    bool Written;
+    bool Complete;
+    std::string Element;
+
+    /// Merged members, listed in place of MembersMarker in Element.
+    std::set<unsigned int> Members;
+  };
+
+  /// Marks where the merged members of a node are listed.
+  static char const MembersMarker = '\1';
+
+  /// Map from USR (or type key) to node.
+  typedef std::map<std::string, Node> NodesMap;
+  NodesMap Nodes;
+  unsigned int NodeCount;
+
+  /// Map from file name to file index within the base document.
+  typedef std::map<std::string, unsigned int> FilesMap;
+  FilesMap Files;
+  unsigned int FileCount;
+  bool FileBuiltin;
+};
+
+/// outputXML - Print a gccxml-compatible AST dump.  The dump starts at
+/// the given declarations in addition to those named by the options.
+/// If a base is given then nodes declared in included headers are
+/// recorded there instead.  The dump is written as JSON lines if the
+/// options request it, and a string that JSON cannot represent is
+/// reported as an error diagnostic.
 void outputXML(clang::CompilerInstance& ci,
                clang::ASTContext& ctx,
                llvm::raw_ostream& os,
-               Options const& opts);
+               Options const& opts,
+               std::vector<clang::Decl const*> const& starts,
+               OutputBase* base = 0);
+
+/// lookupStartNames - Find the declarations with the given qualified
+/// names, looking through using-directives, and append them to decls.
+void lookupStartNames(clang::CompilerInstance& ci,
+                      clang::TranslationUnitDecl const* tu,
+                      std::vector<std::string> const& names,
+                      std::vector<clang::Decl const*>& decls);
+
+/// outputXMLBase - Print the gccxml-compatible base document in the
+/// output format requested by the options.  Returns false with an error
+/// message if the document cannot be written in that format.
+bool outputXMLBase(OutputBase const& base, llvm::raw_ostream& os,
+                   Options const& opts, std::string& error);
 
 #endif // CASTXML_OUTPUT_H
@@ -0,0 +1,99 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+#ifndef CASTXML_OUTPUTFORMAT_H
+#define CASTXML_OUTPUTFORMAT_H
+
+#include <cxsys/Configure.hxx>
+
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class raw_ostream;
+}
+
+/// OutputRef - Reference to a node of the gccxml node model, written
+/// "_<n>" in XML.  Qual holds the cv-qualifiers of a CvQualifiedType
+/// id, 1 for const, 2 for volatile and 4 for restrict, written "c",
+/// "v" and "r".  A node of a base document, "_b<n>", has Base set.
+struct OutputRef
+{
+  OutputRef(unsigned int id, unsigned int qual, bool base):
+    Id(id), Qual(qual), Base(base) {}
+  unsigned int Id;
+  unsigned int Qual;
+  bool Base;
+};
+
+/// OutputBaseRef - One base class listed by a bases attribute.
+struct OutputBaseRef
+{
+  OutputBaseRef(const char* access, OutputRef type):
+    Access(access), Type(type) {}
+  const char* Access;
+  OutputRef Type;
+};
+
+/// OutputFormat - Write the elements of the gccxml node model in one
+/// concrete syntax.  An element started while another is open becomes
+/// its child.  Attributes belong to the element started last and are
+/// given before any of its children.
+class OutputFormat
+{
+public:
+  OutputFormat(llvm::raw_ostream& os): OS(os) {}
+  virtual ~OutputFormat() {}
+
+  /// Start the document with its root element, naming the base
+  /// document its _b<n> ids refer to, if any.
+  virtual void StartDocument(std::string const& base) = 0;
+  virtual void EndDocument() = 0;
+
+  virtual void StartElement(const char* tag) = 0;
+  virtual void EndElement() = 0;
+
+  /// Attribute values by type.  A number is given as decimal digits,
+  /// possibly negative.  A flag is written only when it is set.  A
+  /// null value is not known, such as the bound of an incomplete array.
+  virtual void String(const char* name, std::string const& value) = 0;
+  virtual void Number(const char* name, std::string const& digits) = 0;
+  virtual void Bool(const char* name, bool value) = 0;
+  virtual void Flag(const char* name) = 0;
+  virtual void Null(const char* name) = 0;
+  virtual void Ref(const char* name, OutputRef ref) = 0;
+  virtual void RefList(const char* name,
+                       std::vector<OutputRef> const& refs) = 0;
+  virtual void Bases(std::vector<OutputBaseRef> const& bases) = 0;
+
+  /// Write the location, file and line attributes of a declaration.
+  virtual void Location(unsigned int file, unsigned int line) = 0;
+
+  /// Write the id attribute of the File element with the given index.
+  virtual void FileId(unsigned int file) = 0;
+
+  /// Write a character to be replaced by attributes later, outside of
+  /// any element, such as the merged members of a base document node.
+  virtual void Marker(char c) = 0;
+
+  /// Get the first error that stopped the output, if any.
+  std::string const& GetError() const { return this->Error; }
+
+protected:
+  llvm::raw_ostream& OS;
+  std::string Error;
+};
+
+#endif // CASTXML_OUTPUTFORMAT_H
@@ -0,0 +1,281 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "OutputJSON.h"
+
+//----------------------------------------------------------------------------
+namespace {
+
+//----------------------------------------------------------------------------
+/// Check that text is valid UTF-8, which JSON requires of strings.
+bool isUTF8(const char* p, const char* end)
+{
+  while (p != end) {
+    unsigned char c = static_cast<unsigned char>(*p++);
+    if (c < 0x80) {
+      continue;
+    }
+    unsigned int n;
+    unsigned int min;
+    unsigned int u;
+    if ((c & 0xE0) == 0xC0) {
+      n = 1;
+      min = 0x80;
+      u = c & 0x1F;
+    } else if ((c & 0xF0) == 0xE0) {
+      n = 2;
+      min = 0x800;
+      u = c & 0x0F;
+    } else if ((c & 0xF8) == 0xF0) {
+      n = 3;
+      min = 0x10000;
+      u = c & 0x07;
+    } else {
+      return false;
+    }
+    if (static_cast<unsigned int>(end - p) < n) {
+      return false;
+    }
+    for (; n; --n) {
+      c = static_cast<unsigned char>(*p++);
+      if ((c & 0xC0) != 0x80) {
+        return false;
+      }
+      u = (u << 6) | (c & 0x3F);
+    }
+    if (u < min || u > 0x10FFFF || (u >= 0xD800 && u <= 0xDFFF)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+/// Print a node reference as an integer.  The number of "_<n>" is
+/// shifted left by 3 and the low bits hold the qualifiers.  References
+/// to nodes of a base document are negated.
+void printRef(llvm::raw_ostream& os, OutputRef ref)
+{
+  unsigned long long n = ref.Id;
+  n = (n << 3) | ref.Qual;
+  if (ref.Base) {
+    os << "-";
+  }
+  os << n;
+}
+
+//----------------------------------------------------------------------------
+void printString(llvm::raw_ostream& os, std::string const& s)
+{
+  static const char hex[] = "0123456789abcdef";
+  os << '"';
+  const char* last = s.c_str();
+  for (const char* c = last; *c; ++c) {
+    unsigned char u = static_cast<unsigned char>(*c);
+    if (u >= 0x20 && u != '"' && u != '\\') {
+      continue;
+    }
+    os.write(last, c - last);
+    last = c + 1;
+    switch (u) {
+      case '"': os << "\\\""; break;
+      case '\\': os << "\\\\"; break;
+      case '\n': os << "\\n"; break;
+      case '\t': os << "\\t"; break;
+      case '\r': os << "\\r"; break;
+      default:
+        os << "\\u00" << hex[u >> 4] << hex[u & 0xF];
+        break;
+    }
+  }
+  os << last << '"';
+}
+
+}
+
+//----------------------------------------------------------------------------
+OutputFormatJSON::OutputFormatJSON(llvm::raw_ostream& os):
+  OutputFormat(os), LineOS(Line)
+{
+}
+
+//----------------------------------------------------------------------------
+llvm::raw_ostream& OutputFormatJSON::Out()
+{
+  // Collect a top-level element so it can be dropped on error.
+  if (this->Open.empty()) {
+    return this->OS;
+  }
+  return this->LineOS;
+}
+
+//----------------------------------------------------------------------------
+void OutputFormatJSON::Name(const char* name)
+{
+  this->Out() << ",\"" << name << "\":";
+}
+
+//----------------------------------------------------------------------------
+void OutputFormatJSON::StartDocument(std::string const& base)
+{
+  // The root element attributes are the first object.
+  this->StartElement("GCC_XML");
+  this->String("version", "0.9.0");
+  this->String("cvs_revision", "1.136");
+  if (!base.empty()) {
+    this->String("base", base);
+  }
+  this->EndElement();
+}
+
+//----------------------------------------------------------------------------
+void OutputFormatJSON::EndDocument()
+{
+}
+
+//----------------------------------------------------------------------------
+void OutputFormatJSON::StartElement(const char* tag)
+{
+  if (this->Open.empty()) {
+    this->Tag = tag;
+  } else if (!this->Open.back()) {
+    this->LineOS << ",\"children\":[";
+    this->Open.back() = true;
+  } else {
+    this->LineOS << ",";
+  }
+  this->Open.push_back(false);
+  this->LineOS << "{\"tag\":\"" << tag << "\"";
+}
+
+//----------------------------------------------------------------------------
+void OutputFormatJSON::EndElement()
+{
+  if (this->Open.back()) {
+    this->LineOS << "]";
+  }
+  this->LineOS << "}";
+  this->Open.pop_back();
+  if (this->Open.empty()) {
+    this->LineOS.flush();
+    // Stop at the first error rather than write a partial document.
+    if (this->Error.empty()) {
+      this->OS << this->Line << "\n";
+    }
+    this->Line.clear();
+  }
+}
+
+//----------------------------------------------------------------------------
+void OutputFormatJSON::String(const char* name, std::string const& value)
+{
+  if (!isUTF8(value.data(), value.data() + value.size()) &&
+      this->Error.empty()) {
+    this->Error = "<" + this->Tag + "> element is not valid UTF-8";
+  }
+  this->Name(name);
+  printString(this->Out(), value);
+}
+
+//----------------------------------------------------------------------------
+void OutputFormatJSON::Number(const char* name, std::string const& digits)
+{
+  this->Name(name);
+  this->Out() << digits;
+}
+
+//----------------------------------------------------------------------------
+void OutputFormatJSON::Bool(const char* name, bool value)
+{
+  this->Name(name);
+  this->Out() << (value? "true" : "false");
+}
+
+//----------------------------------------------------------------------------
+void OutputFormatJSON::Flag(const char* name)
+{
+  this->Bool(name, true);
+}
+
+//----------------------------------------------------------------------------
+void OutputFormatJSON::Null(const char* name)
+{
+  this->Name(name);
+  this->Out() << "null";
+}
+
+//----------------------------------------------------------------------------
+void OutputFormatJSON::Ref(const char* name, OutputRef ref)
+{
+  this->Name(name);
+  printRef(this->Out(), ref);
+}
+
+//----------------------------------------------------------------------------
+void OutputFormatJSON::RefList(const char* name,
+                               std::vector<OutputRef> const& refs)
+{
+  this->Name(name);
+  llvm::raw_ostream& os = this->Out();
+  os << "[";
+  const char* sep = "";
+  for (std::vector<OutputRef>::const_iterator i = refs.begin(),
+         e = refs.end(); i != e; ++i) {
+    os << sep;
+    printRef(os, *i);
+    sep = ",";
+  }
+  os << "]";
+}
+
+//----------------------------------------------------------------------------
+void OutputFormatJSON::Bases(std::vector<OutputBaseRef> const& bases)
+{
+  this->Name("bases");
+  llvm::raw_ostream& os = this->Out();
+  os << "[";
+  const char* sep = "";
+  for (std::vector<OutputBaseRef>::const_iterator i = bases.begin(),
+         e = bases.end(); i != e; ++i) {
+    os << sep << "{\"access\":\"" << i->Access << "\",\"type\":";
+    printRef(os, i->Type);
+    os << "}";
+    sep = ",";
+  }
+  os << "]";
+}
+
+//----------------------------------------------------------------------------
+void OutputFormatJSON::Location(unsigned int file, unsigned int line)
+{
+  this->Out() <<
+    ",\"location\":[" << file << "," << line << "]"
+    ",\"file\":" << file <<
+    ",\"line\":" << line;
+}
+
+//----------------------------------------------------------------------------
+void OutputFormatJSON::FileId(unsigned int file)
+{
+  this->Name("id");
+  this->Out() << file;
+}
+
+//----------------------------------------------------------------------------
+void OutputFormatJSON::Marker(char c)
+{
+  this->Out() << c;
+}
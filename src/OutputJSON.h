@@ -0,0 +1,70 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+#ifndef CASTXML_OUTPUTJSON_H
+#define CASTXML_OUTPUTJSON_H
+
+#include <cxsys/Configure.hxx>
+
+#include "OutputFormat.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+#include <vector>
+
+/// OutputFormatJSON - Write the gccxml node model as newline-delimited
+/// JSON.  Each top-level element is one JSON object on its own line,
+/// written when the element ends, with nested elements in a children
+/// array.  References to other nodes are integers.  Output stops at the
+/// first string that is not valid UTF-8, which JSON cannot represent.
+class OutputFormatJSON: public OutputFormat
+{
+public:
+  OutputFormatJSON(llvm::raw_ostream& os);
+
+  void StartDocument(std::string const& base) override;
+  void EndDocument() override;
+  void StartElement(const char* tag) override;
+  void EndElement() override;
+  void String(const char* name, std::string const& value) override;
+  void Number(const char* name, std::string const& digits) override;
+  void Bool(const char* name, bool value) override;
+  void Flag(const char* name) override;
+  void Null(const char* name) override;
+  void Ref(const char* name, OutputRef ref) override;
+  void RefList(const char* name,
+               std::vector<OutputRef> const& refs) override;
+  void Bases(std::vector<OutputBaseRef> const& bases) override;
+  void Location(unsigned int file, unsigned int line) override;
+  void FileId(unsigned int file) override;
+  void Marker(char c) override;
+
+private:
+  llvm::raw_ostream& Out();
+  void Name(const char* name);
+
+  // The line of the top-level element being written.
+  std::string Line;
+  llvm::raw_string_ostream LineOS;
+
+  // Tag of the top-level element, for errors.
+  std::string Tag;
+
+  // Whether each open element has children yet.
+  std::vector<bool> Open;
+};
+
+#endif // CASTXML_OUTPUTJSON_H
@@ -0,0 +1,107 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "Preamble.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+// A dependency file holds the signature, the hash of the preamble text,
+// and then the size, modification time, and path of each file read.
+static const char PreambleSignature[] = "castxml-preamble 1";
+
+//----------------------------------------------------------------------------
+std::string preambleHash(std::vector<std::string> const& parts)
+{
+  llvm::MD5 md5;
+  for (std::string const& p : parts) {
+    // Terminate each string so adjacent strings cannot run together.
+    md5.update(p);
+    md5.update(llvm::StringRef("", 1));
+  }
+  llvm::MD5::MD5Result result;
+  md5.final(result);
+  llvm::SmallString<32> hex;
+  llvm::MD5::stringifyResult(result, hex);
+  return std::string(hex.str());
+}
+
+//----------------------------------------------------------------------------
+bool preambleValid(std::string const& depsFile, std::string const& hash)
+{
+  std::ifstream fin(depsFile.c_str());
+  std::string line;
+  if (!std::getline(fin, line) || line != PreambleSignature ||
+      !std::getline(fin, line) || line != hash) {
+    return false;
+  }
+  while (std::getline(fin, line)) {
+    std::istringstream in(line);
+    unsigned long long size;
+    long long time;
+    std::string path;
+    if (!(in >> size >> time) || in.get() != ' ' ||
+        !std::getline(in, path)) {
+      return false;
+    }
+    // Compare as Clang's FileManager does when validating a PCH.
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 ||
+        static_cast<unsigned long long>(st.st_size) != size ||
+        static_cast<long long>(st.st_mtime) != time) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool preambleStore(std::string const& depsFile, std::string const& hash,
+                   std::vector<PreambleDep> const& deps)
+{
+  // Write a temporary file and rename it into place so that concurrent
+  // runs never see a partial file.
+  llvm::SmallString<256> tmp;
+  int fd;
+  if (llvm::sys::fs::createUniqueFile(depsFile + ".tmp-%%%%%%%%", fd, tmp)) {
+    return false;
+  }
+  {
+    llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+    os << PreambleSignature << "\n" << hash << "\n";
+    for (PreambleDep const& d : deps) {
+      os << d.Size << " " << d.Time << " " << d.Path << "\n";
+    }
+    os.close();
+    if (os.has_error()) {
+      os.clear_error();
+      llvm::sys::fs::remove(tmp.str());
+      return false;
+    }
+  }
+  if (llvm::sys::fs::rename(tmp.str(), depsFile)) {
+    llvm::sys::fs::remove(tmp.str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,49 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+#ifndef CASTXML_PREAMBLE_H
+#define CASTXML_PREAMBLE_H
+
+#include <cxsys/Configure.hxx>
+
+#include <string>
+#include <vector>
+
+/// PreambleDep - A file read while building a precompiled preamble,
+/// with the size and modification time it had when read.
+struct PreambleDep
+{
+  PreambleDep(std::string const& path, unsigned long long size,
+              long long time): Path(path), Size(size), Time(time) {}
+  std::string Path;
+  unsigned long long Size;
+  long long Time;
+};
+
+/// preambleHash - Compute a hex digest of a list of strings, used to
+/// name a cached preamble and to identify the text it was built from.
+std::string preambleHash(std::vector<std::string> const& parts);
+
+/// preambleValid - Check that the preamble recorded in the dependency
+/// file was built from text with the given hash and that none of the
+/// files it read has changed size or modification time since.
+bool preambleValid(std::string const& depsFile, std::string const& hash);
+
+/// preambleStore - Write the dependency file of a preamble built from
+/// text with the given hash.  Returns false on failure.
+bool preambleStore(std::string const& depsFile, std::string const& hash,
+                   std::vector<PreambleDep> const& deps);
+
+#endif // CASTXML_PREAMBLE_H
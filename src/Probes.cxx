@@ -0,0 +1,23 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "Probes.h"
+
+#if defined(CASTXML_HAVE_SDT)
+# define CASTXML_PROBE_DEFINE_SEMAPHORE(name)                           \
+  CASTXML_SDT_SEMAPHORE(castxml, name);
+CASTXML_PROBE_NAMES(CASTXML_PROBE_DEFINE_SEMAPHORE)
+#endif
@@ -0,0 +1,59 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+#ifndef CASTXML_PROBES_H
+#define CASTXML_PROBES_H
+
+#include "ProbesSDT.h"
+
+// Static tracepoints of provider "castxml" for perf, bpftrace, and
+// SystemTap.  Each probe is a single no-op instruction plus a note
+// describing where to find its arguments.  The arguments are evaluated
+// wherever the probe is reached, traced or not, like those of a call.
+// Compute an argument that costs anything only where
+// CASTXML_PROBE_ENABLED(name) is true, that is while a tracer is
+// attached to the probe.  Where probes are not supported they and
+// their arguments compile to nothing.  A '__' in a probe name reads as
+// '-' in the tracers.
+
+// Every probe, each with a semaphore defined in Probes.cxx.
+#define CASTXML_PROBE_NAMES(X)                                          \
+  X(main__start)                                                        \
+  X(clang__start) X(clang__done)                                        \
+  X(detect__start) X(detect__done)                                      \
+  X(source__start) X(source__done)                                      \
+  X(tu__start) X(members__start) X(tu__done)                            \
+  X(output__start) X(output__done)                                      \
+  X(node__start) X(node__done)
+
+#if defined(CASTXML_HAVE_SDT)
+# define CASTXML_PROBE_DECLARE_SEMAPHORE(name)                          \
+  extern CASTXML_SDT_SEMAPHORE(castxml, name);
+CASTXML_PROBE_NAMES(CASTXML_PROBE_DECLARE_SEMAPHORE)
+# undef CASTXML_PROBE_DECLARE_SEMAPHORE
+
+# define CASTXML_PROBE_ENABLED(name) CASTXML_SDT_ENABLED(castxml, name)
+# define CASTXML_PROBE(name) CASTXML_SDT_PROBE(castxml, name)
+# define CASTXML_PROBE1(name, a1) CASTXML_SDT_PROBE1(castxml, name, a1)
+# define CASTXML_PROBE2(name, a1, a2) \
+  CASTXML_SDT_PROBE2(castxml, name, a1, a2)
+#else
+# define CASTXML_PROBE_ENABLED(name) false
+# define CASTXML_PROBE(name) do {} while(0)
+# define CASTXML_PROBE1(name, a1) do {} while(0)
+# define CASTXML_PROBE2(name, a1, a2) do {} while(0)
+#endif
+
+#endif // CASTXML_PROBES_H
@@ -0,0 +1,111 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+#ifndef CASTXML_PROBESSDT_H
+#define CASTXML_PROBESSDT_H
+
+// Header-only static tracepoints in the format of SystemTap's
+// <sys/sdt.h>, so that they need nothing installed at build time.  Each
+// probe is a no-op instruction described by a version 3 note in the
+// .note.stapsdt section: its address, the address of the .stapsdt.base
+// section to adjust for prelinking, the address of its semaphore, the
+// provider and probe names, and each argument as <size>@<operand>,
+// with a negative size for signed types.  Only ELF targets built by
+// GCC or Clang on x86 and AArch64 are supported, where the tracers
+// understand the assembler operands.
+
+#if defined(__ELF__) && defined(__GNUC__) && \
+  (defined(__x86_64__) || defined(__i386__) || defined(__aarch64__))
+# define CASTXML_HAVE_SDT
+
+# include <type_traits>
+
+# if defined(__LP64__)
+#  define CASTXML_SDT_ADDR ".8byte"
+# else
+#  define CASTXML_SDT_ADDR ".4byte"
+# endif
+
+// The size of an argument, negated by the '%n' operand modifier, so
+// that it is printed negative for signed types.
+# define CASTXML_SDT_SIZE(x)                                           \
+  ((std::is_signed<typename std::decay<decltype(x)>::type>::value?     \
+    1 : -1) * static_cast<int>(sizeof(x)))
+
+# define CASTXML_SDT_ARG(n, x)                                          \
+  [castxml_sdt_s##n] "n" (CASTXML_SDT_SIZE(x)),                         \
+  [castxml_sdt_a##n] "nor" (x)
+
+# define CASTXML_SDT_ARGFMT(n)                                         \
+  "%n[castxml_sdt_s" #n "]@%[castxml_sdt_a" #n "]"
+
+# define CASTXML_SDT_NOTE(provider, name, semaphore, args)             \
+  "990: nop\n"                                                          \
+  ".pushsection .note.stapsdt,\"?\",\"note\"\n"                         \
+  ".balign 4\n"                                                         \
+  ".4byte 992f-991f,994f-993f,3\n"                                      \
+  "991: .asciz \"stapsdt\"\n"                                           \
+  "992: .balign 4\n"                                                    \
+  "993: " CASTXML_SDT_ADDR " 990b\n"                                    \
+  CASTXML_SDT_ADDR " _.stapsdt.base\n"                                  \
+  CASTXML_SDT_ADDR " " semaphore "\n"                                   \
+  ".asciz \"" #provider "\"\n"                                          \
+  ".asciz \"" #name "\"\n"                                              \
+  ".asciz \"" args "\"\n"                                               \
+  "994: .balign 4\n"                                                    \
+  ".popsection\n"                                                       \
+  ".ifndef _.stapsdt.base\n"                                            \
+  ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"\
+  ".weak _.stapsdt.base\n"                                              \
+  ".hidden _.stapsdt.base\n"                                            \
+  "_.stapsdt.base: .space 1\n"                                          \
+  ".size _.stapsdt.base,1\n"                                            \
+  ".popsection\n"                                                       \
+  ".endif\n"
+
+// The semaphore of a probe, a counter that tracers increment while
+// attached to it.  It must be defined once with CASTXML_SDT_SEMAPHORE.
+# define CASTXML_SDT_SEMAPHORE_NAME(provider, name)                    \
+  provider##_##name##_semaphore
+# define CASTXML_SDT_SEMAPHORE(provider, name)                         \
+  unsigned short CASTXML_SDT_SEMAPHORE_NAME(provider, name)             \
+    __attribute__((unused, section(".probes")))
+# define CASTXML_SDT_ENABLED(provider, name)                           \
+  __builtin_expect(CASTXML_SDT_SEMAPHORE_NAME(provider, name) != 0, 0)
+
+# define CASTXML_SDT_STR(x) #x
+# define CASTXML_SDT_SEMAPHORE_STR(provider, name)                     \
+  CASTXML_SDT_STR(provider##_##name##_semaphore)
+
+# define CASTXML_SDT_PROBE(provider, name)                             \
+  __asm__ __volatile__(                                                 \
+    CASTXML_SDT_NOTE(provider, name,                                    \
+                     CASTXML_SDT_SEMAPHORE_STR(provider, name), "")     \
+    :: )
+# define CASTXML_SDT_PROBE1(provider, name, a1)                        \
+  __asm__ __volatile__(                                                 \
+    CASTXML_SDT_NOTE(provider, name,                                    \
+                     CASTXML_SDT_SEMAPHORE_STR(provider, name),         \
+                     CASTXML_SDT_ARGFMT(1))                             \
+    :: CASTXML_SDT_ARG(1, a1))
+# define CASTXML_SDT_PROBE2(provider, name, a1, a2)                    \
+  __asm__ __volatile__(                                                 \
+    CASTXML_SDT_NOTE(provider, name,                                    \
+                     CASTXML_SDT_SEMAPHORE_STR(provider, name),         \
+                     CASTXML_SDT_ARGFMT(1) " " CASTXML_SDT_ARGFMT(2))   \
+    :: CASTXML_SDT_ARG(1, a1), CASTXML_SDT_ARG(2, a2))
+#endif
+
+#endif // CASTXML_PROBESSDT_H
@@ -0,0 +1,586 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "Reader.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define CASTXML_READER_SSE2
+# include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+# include <intrin.h>
+#endif
+
+#if defined(_WIN32)
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+//----------------------------------------------------------------------------
+namespace {
+
+/// FileMapping - Read-only view of a whole file.
+class FileMapping
+{
+public:
+  FileMapping(): Data(0), Size(0)
+#if defined(_WIN32)
+    , File(INVALID_HANDLE_VALUE), Map(0)
+#endif
+    {}
+  ~FileMapping();
+  bool Open(std::string const& fname, std::string& error);
+  const char* Data;
+  size_t Size;
+private:
+#if defined(_WIN32)
+  HANDLE File;
+  HANDLE Map;
+#endif
+};
+
+//----------------------------------------------------------------------------
+bool FileMapping::Open(std::string const& fname, std::string& error)
+{
+#if defined(_WIN32)
+  this->File = CreateFileA(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+  if (this->File == INVALID_HANDLE_VALUE) {
+    error = "could not open \"" + fname + "\"";
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(this->File, &size)) {
+    error = "could not get size of \"" + fname + "\"";
+    return false;
+  }
+  this->Size = static_cast<size_t>(size.QuadPart);
+  if (this->Size == 0) {
+    this->Data = "";
+    return true;
+  }
+  this->Map = CreateFileMappingA(this->File, 0, PAGE_READONLY, 0, 0, 0);
+  if (!this->Map) {
+    error = "could not map \"" + fname + "\"";
+    return false;
+  }
+  this->Data = static_cast<const char*>(
+    MapViewOfFile(this->Map, FILE_MAP_READ, 0, 0, 0));
+  if (!this->Data) {
+    error = "could not map \"" + fname + "\"";
+    return false;
+  }
+  return true;
+#else
+  int fd = open(fname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error = "could not open \"" + fname + "\"";
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    error = "could not get size of \"" + fname + "\"";
+    return false;
+  }
+  this->Size = static_cast<size_t>(st.st_size);
+  if (this->Size == 0) {
+    close(fd);
+    this->Data = "";
+    return true;
+  }
+  void* p = mmap(0, this->Size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    this->Size = 0;
+    error = "could not map \"" + fname + "\"";
+    return false;
+  }
+# if defined(MADV_SEQUENTIAL)
+  madvise(p, this->Size, MADV_SEQUENTIAL);
+# endif
+  this->Data = static_cast<const char*>(p);
+  return true;
+#endif
+}
+
+//----------------------------------------------------------------------------
+FileMapping::~FileMapping()
+{
+#if defined(_WIN32)
+  if (this->Data && this->Size) {
+    UnmapViewOfFile(this->Data);
+  }
+  if (this->Map) {
+    CloseHandle(this->Map);
+  }
+  if (this->File != INVALID_HANDLE_VALUE) {
+    CloseHandle(this->File);
+  }
+#else
+  if (this->Data && this->Size) {
+    munmap(const_cast<char*>(this->Data), this->Size);
+  }
+#endif
+}
+
+//----------------------------------------------------------------------------
+inline bool isSpace(char c)
+{
+  return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+//----------------------------------------------------------------------------
+inline bool isNameEnd(char c)
+{
+  return static_cast<unsigned char>(c) <= ' ' ||
+    c == '/' || c == '>' || c == '=';
+}
+
+#if defined(CASTXML_READER_SSE2)
+//----------------------------------------------------------------------------
+inline unsigned int firstBit(unsigned int mask)
+{
+# if defined(_MSC_VER)
+  unsigned long i;
+  _BitScanForward(&i, mask);
+  return static_cast<unsigned int>(i);
+# else
+  return static_cast<unsigned int>(__builtin_ctz(mask));
+# endif
+}
+#endif
+
+//----------------------------------------------------------------------------
+/// Find the end of a name: whitespace, '/', '>' or '='.  Scan 16 bytes
+/// at a time where supported since most names fit in one block.
+inline const char* scanName(const char* p, const char* end)
+{
+#if defined(CASTXML_READER_SSE2)
+  __m128i const minusOne = _mm_set1_epi8(-1);
+  __m128i const bang = _mm_set1_epi8('!');
+  __m128i const slash = _mm_set1_epi8('/');
+  __m128i const gt = _mm_set1_epi8('>');
+  __m128i const eq = _mm_set1_epi8('=');
+  while (end - p >= 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+    __m128i ctl = _mm_and_si128(_mm_cmpgt_epi8(x, minusOne),
+                                _mm_cmplt_epi8(x, bang));
+    __m128i sep = _mm_or_si128(_mm_cmpeq_epi8(x, slash),
+                               _mm_or_si128(_mm_cmpeq_epi8(x, gt),
+                                            _mm_cmpeq_epi8(x, eq)));
+    unsigned int mask = static_cast<unsigned int>(
+      _mm_movemask_epi8(_mm_or_si128(ctl, sep)));
+    if (mask) {
+      return p + firstBit(mask);
+    }
+    p += 16;
+  }
+#endif
+  while (p != end && !isNameEnd(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+//----------------------------------------------------------------------------
+/// Find the first occurrence of a character, or the end.  Attribute
+/// values are mostly short, so avoid the call overhead of memchr.
+inline const char* scanChar(const char* p, const char* end, char c)
+{
+#if defined(CASTXML_READER_SSE2)
+  __m128i const x = _mm_set1_epi8(c);
+  while (end - p >= 16) {
+    __m128i y = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+    unsigned int mask =
+      static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+    if (mask) {
+      return p + firstBit(mask);
+    }
+    p += 16;
+  }
+#endif
+  while (p != end && *p != c) {
+    ++p;
+  }
+  return p;
+}
+
+//----------------------------------------------------------------------------
+inline size_t hashString(ReaderString s)
+{
+  // FNV-1a
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < s.Size; ++i) {
+    h = (h ^ static_cast<unsigned char>(s.Data[i])) * 1099511628211ULL;
+  }
+  return static_cast<size_t>(h ^ (h >> 32));
+}
+
+//----------------------------------------------------------------------------
+const char* findString(const char* p, const char* end, const char* s)
+{
+  size_t n = strlen(s);
+  while (static_cast<size_t>(end - p) >= n) {
+    p = static_cast<const char*>(memchr(p, s[0], end - p));
+    if (!p || static_cast<size_t>(end - p) < n) {
+      return 0;
+    }
+    if (memcmp(p, s, n) == 0) {
+      return p;
+    }
+    ++p;
+  }
+  return 0;
+}
+
+}
+
+unsigned int const Reader::None;
+
+//----------------------------------------------------------------------------
+Reader::Reader(): Data(0), Size(0), Mapping(0)
+{
+}
+
+//----------------------------------------------------------------------------
+Reader::~Reader()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+void Reader::Close()
+{
+  delete static_cast<FileMapping*>(this->Mapping);
+  this->Mapping = 0;
+  this->Data = 0;
+  this->Size = 0;
+  this->Elements.clear();
+  this->Attributes.clear();
+  this->IdTable.clear();
+  this->IdList.clear();
+}
+
+//----------------------------------------------------------------------------
+bool Reader::Open(std::string const& fname, std::string& error)
+{
+  this->Close();
+  this->FileName = fname;
+  FileMapping* m = new FileMapping;
+  this->Mapping = m;
+  if (!m->Open(fname, error)) {
+    this->Close();
+    return false;
+  }
+  this->Data = m->Data;
+  this->Size = m->Size;
+  return this->ParseDocument(error);
+}
+
+//----------------------------------------------------------------------------
+bool Reader::Parse(const char* data, size_t size, std::string& error)
+{
+  this->Close();
+  this->FileName = "<memory>";
+  this->Data = data;
+  this->Size = size;
+  return this->ParseDocument(error);
+}
+
+//----------------------------------------------------------------------------
+bool Reader::Fail(const char* pos, const char* what, std::string& error)
+{
+  size_t line = 1 + std::count(this->Data, pos, '\n');
+  std::ostringstream e;
+  e << this->FileName << ":" << line << ": " << what;
+  error = e.str();
+  return false;
+}
+
+//----------------------------------------------------------------------------
+bool Reader::ParseDocument(std::string& error)
+{
+  const char* p = this->Data;
+  const char* end = this->Data + this->Size;
+
+  // Reserve assuming a typical ratio of markup to elements.
+  this->Elements.reserve(this->Size / 96);
+  this->Attributes.reserve(this->Size / 24);
+
+  std::vector<unsigned int> open;
+  std::vector<unsigned int> last;
+  while ((p = static_cast<const char*>(memchr(p, '<', end - p)))) {
+    const char* start = p++;
+    if (p == end) {
+      return this->Fail(start, "unexpected end of document", error);
+    }
+    if (*p == '?') {
+      // Processing instruction or XML declaration.
+      p = findString(p, end, "?>");
+      if (!p) {
+        return this->Fail(start, "unterminated declaration", error);
+      }
+      p += 2;
+      continue;
+    }
+    if (*p == '!') {
+      const char* close = "]]>";
+      if (end - p >= 3 && p[1] == '-' && p[2] == '-') {
+        close = "-->";
+      } else if (end - p < 8 || memcmp(p, "![CDATA[", 8) != 0) {
+        close = ">";
+      }
+      p = findString(p, end, close);
+      if (!p) {
+        return this->Fail(start, "unterminated markup", error);
+      }
+      p += strlen(close);
+      continue;
+    }
+    if (*p == '/') {
+      // End tag.
+      const char* name = ++p;
+      p = scanName(p, end);
+      ReaderString tag(name, p - name);
+      while (p != end && isSpace(*p)) {
+        ++p;
+      }
+      if (p == end || *p != '>') {
+        return this->Fail(start, "expected '>'", error);
+      }
+      ++p;
+      if (open.empty() || !(this->Elements[open.back()].Tag == tag)) {
+        return this->Fail(start, "mismatched end tag", error);
+      }
+      open.pop_back();
+      last.pop_back();
+      continue;
+    }
+
+    // Start tag.
+    const char* name = p;
+    p = scanName(p, end);
+    if (p == name) {
+      return this->Fail(start, "expected element name", error);
+    }
+    unsigned int index = static_cast<unsigned int>(this->Elements.size());
+    Element e;
+    e.Tag = ReaderString(name, p - name);
+    e.Parent = open.empty()? None : open.back();
+    e.FirstChild = None;
+    e.NextSibling = None;
+    e.AttrBegin = static_cast<unsigned int>(this->Attributes.size());
+    if (!open.empty()) {
+      if (last.back() == None) {
+        this->Elements[open.back()].FirstChild = index;
+      } else {
+        this->Elements[last.back()].NextSibling = index;
+      }
+      last.back() = index;
+    } else if (index != 0) {
+      return this->Fail(start, "multiple root elements", error);
+    }
+
+    bool empty = false;
+    for (;;) {
+      while (p != end && isSpace(*p)) {
+        ++p;
+      }
+      if (p == end) {
+        return this->Fail(start, "unterminated start tag", error);
+      }
+      if (*p == '>') {
+        ++p;
+        break;
+      }
+      if (*p == '/') {
+        if (++p == end || *p != '>') {
+          return this->Fail(start, "expected '>'", error);
+        }
+        ++p;
+        empty = true;
+        break;
+      }
+      Attribute a;
+      const char* aname = p;
+      p = scanName(p, end);
+      a.Name = ReaderString(aname, p - aname);
+      while (p != end && isSpace(*p)) {
+        ++p;
+      }
+      if (a.Name.empty() || p == end || *p != '=') {
+        return this->Fail(p, "expected attribute", error);
+      }
+      ++p;
+      while (p != end && isSpace(*p)) {
+        ++p;
+      }
+      if (p == end || (*p != '"' && *p != '\'')) {
+        return this->Fail(p, "expected quoted attribute value", error);
+      }
+      char q = *p++;
+      const char* value = p;
+      p = scanChar(p, end, q);
+      if (p == end) {
+        return this->Fail(value, "unterminated attribute value", error);
+      }
+      a.Value = ReaderString(value, p - value);
+      ++p;
+      if (a.Name.Size == 2 && a.Name.Data[0] == 'i' && a.Name.Data[1] == 'd') {
+        IdEntry id = { index,
+                       static_cast<unsigned int>(this->Attributes.size()) };
+        this->IdList.push_back(id);
+      }
+      this->Attributes.push_back(a);
+    }
+    e.AttrEnd = static_cast<unsigned int>(this->Attributes.size());
+    this->Elements.push_back(e);
+    if (!empty) {
+      open.push_back(index);
+      last.push_back(None);
+    }
+  }
+
+  if (!open.empty()) {
+    return this->Fail(end, "unexpected end of document", error);
+  }
+  if (this->Elements.empty()) {
+    return this->Fail(end, "no root element", error);
+  }
+
+  this->BuildIdIndex();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void Reader::BuildIdIndex()
+{
+  size_t n = 16;
+  while (n < 2 * this->IdList.size()) {
+    n *= 2;
+  }
+  IdEntry empty = { None, None };
+  this->IdTable.assign(n, empty);
+  size_t const mask = n - 1;
+  for (std::vector<IdEntry>::const_iterator i = this->IdList.begin(),
+         ie = this->IdList.end(); i != ie; ++i) {
+    size_t h = hashString(this->Attributes[i->Attr].Value) & mask;
+    while (this->IdTable[h].Element != None) {
+      h = (h + 1) & mask;
+    }
+    this->IdTable[h] = *i;
+  }
+  std::vector<IdEntry>().swap(this->IdList);
+}
+
+//----------------------------------------------------------------------------
+ReaderString Reader::GetAttribute(Element const& e, const char* name) const
+{
+  for (Attribute const* a = this->AttrBegin(e), *ae = this->AttrEnd(e);
+       a != ae; ++a) {
+    if (a->Name == name) {
+      return a->Value;
+    }
+  }
+  return ReaderString();
+}
+
+//----------------------------------------------------------------------------
+unsigned int Reader::FindId(ReaderString id) const
+{
+  if (this->IdTable.empty()) {
+    return None;
+  }
+  size_t const mask = this->IdTable.size() - 1;
+  for (size_t h = hashString(id) & mask;
+       this->IdTable[h].Element != None; h = (h + 1) & mask) {
+    if (this->Attributes[this->IdTable[h].Attr].Value == id) {
+      return this->IdTable[h].Element;
+    }
+  }
+  return None;
+}
+
+//----------------------------------------------------------------------------
+std::string Reader::Decode(ReaderString value)
+{
+  std::string out;
+  out.reserve(value.Size);
+  const char* p = value.Data;
+  const char* end = value.Data + value.Size;
+  while (p != end) {
+    const char* amp = static_cast<const char*>(memchr(p, '&', end - p));
+    if (!amp) {
+      out.append(p, end);
+      break;
+    }
+    out.append(p, amp);
+    const char* semi = static_cast<const char*>(memchr(amp, ';', end - amp));
+    if (!semi) {
+      out.append(amp, end);
+      break;
+    }
+    ReaderString ref(amp + 1, semi - amp - 1);
+    if (ref == "lt") {
+      out += '<';
+    } else if (ref == "gt") {
+      out += '>';
+    } else if (ref == "amp") {
+      out += '&';
+    } else if (ref == "quot") {
+      out += '"';
+    } else if (ref == "apos") {
+      out += '\'';
+    } else if (ref.Size > 1 && ref.Data[0] == '#') {
+      unsigned long c = ref.Data[1] == 'x'?
+        strtoul(std::string(ref.Data + 2, ref.Size - 2).c_str(), 0, 16) :
+        strtoul(std::string(ref.Data + 1, ref.Size - 1).c_str(), 0, 10);
+      // Encode the code point as UTF-8.
+      if (c < 0x80) {
+        out += static_cast<char>(c);
+      } else if (c < 0x800) {
+        out += static_cast<char>(0xC0 | (c >> 6));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+      } else if (c < 0x10000) {
+        out += static_cast<char>(0xE0 | (c >> 12));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+      } else {
+        out += static_cast<char>(0xF0 | (c >> 18));
+        out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+      }
+    } else {
+      out.append(amp, semi + 1);
+    }
+    p = semi + 1;
+  }
+  return out;
+}
@@ -0,0 +1,128 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+#ifndef CASTXML_READER_H
+#define CASTXML_READER_H
+
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/// ReaderString - View of characters within a document held by a Reader.
+struct ReaderString
+{
+  ReaderString(): Data(0), Size(0) {}
+  ReaderString(const char* d, size_t s): Data(d), Size(s) {}
+  const char* Data;
+  size_t Size;
+  bool empty() const { return this->Size == 0; }
+  std::string str() const { return std::string(this->Data, this->Size); }
+  friend bool operator == (ReaderString const& l, ReaderString const& r) {
+    return l.Size == r.Size && memcmp(l.Data, r.Data, l.Size) == 0;
+  }
+  friend bool operator == (ReaderString const& l, const char* r) {
+    return l.Size == strlen(r) && memcmp(l.Data, r, l.Size) == 0;
+  }
+  friend bool operator != (ReaderString const& l, const char* r) {
+    return !(l == r);
+  }
+};
+
+/// Reader - Map a castxml output file into memory and index its elements.
+/// Element tags and attribute names and values refer directly to the
+/// mapped document and remain valid until the reader is closed.
+/// Attribute values are not decoded from their XML representation.
+class Reader
+{
+public:
+  /// Index value meaning "no element".
+  static unsigned int const None = ~0u;
+
+  struct Attribute {
+    ReaderString Name;
+    ReaderString Value;
+  };
+
+  struct Element {
+    ReaderString Tag;
+    unsigned int Parent;
+    unsigned int FirstChild;
+    unsigned int NextSibling;
+    unsigned int AttrBegin;
+    unsigned int AttrEnd;
+  };
+
+  Reader();
+  ~Reader();
+
+  /// Open - Map the named file and parse it.  On failure returns
+  /// false and stores a message in the error string.
+  bool Open(std::string const& fname, std::string& error);
+
+  /// Parse - Parse a document held in memory owned by the caller.
+  bool Parse(const char* data, size_t size, std::string& error);
+
+  /// Close - Release the document and all elements.
+  void Close();
+
+  /// Elements in document order.  The root element is first.
+  std::vector<Element> const& GetElements() const { return this->Elements; }
+  Element const& GetElement(unsigned int i) const {
+    return this->Elements[i];
+  }
+
+  /// Attributes of all elements.  Each element refers to a range.
+  Attribute const* AttrBegin(Element const& e) const {
+    return this->Attributes.data() + e.AttrBegin;
+  }
+  Attribute const* AttrEnd(Element const& e) const {
+    return this->Attributes.data() + e.AttrEnd;
+  }
+
+  /// GetAttribute - Get the value of the named attribute of an element.
+  /// Returns an empty string if the element has no such attribute.
+  ReaderString GetAttribute(Element const& e, const char* name) const;
+
+  /// FindId - Get the index of the element with the given id attribute.
+  unsigned int FindId(ReaderString id) const;
+
+  /// Decode - Replace XML character and entity references in a value.
+  static std::string Decode(ReaderString value);
+
+private:
+  bool ParseDocument(std::string& error);
+  bool Fail(const char* pos, const char* what, std::string& error);
+
+  void BuildIdIndex();
+
+  std::string FileName;
+  const char* Data;
+  size_t Size;
+  void* Mapping;
+  std::vector<Element> Elements;
+  std::vector<Attribute> Attributes;
+
+  // Open-addressed hash table of elements by id.  Each entry holds
+  // the index of an element and of its id attribute.
+  struct IdEntry {
+    unsigned int Element;
+    unsigned int Attr;
+  };
+  std::vector<IdEntry> IdTable;
+  std::vector<IdEntry> IdList;
+};
+
+#endif // CASTXML_READER_H
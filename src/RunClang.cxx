@@ -15,15 +15,30 @@
 */
 
 #include "RunClang.h"
+#include "CC1Cache.h"
+#include "HeaderIndex.h"
+#include "InstantiationProfile.h"
+#include "JobHistory.h"
+#include "Layout.h"
 #include "Options.h"
 #include "Output.h"
+#include "Preamble.h"
+#include "Probes.h"
+#include "ScanDeps.h"
 #include "Utils.h"
+#include "VFSArchive.h"
+#include "Watch.h"
 
 #include <cxsys/SystemTools.hxx>
 
 #include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/FileSystemStatCache.h"
+#include "clang/Basic/VirtualFileSystem.h"
 #include "clang/Driver/Compilation.h"
 #include "clang/Driver/Driver.h"
 #include "clang/Driver/DriverDiagnostic.h"
@@ -34,17 +49,112 @@
 #include "clang/Frontend/FrontendDiagnostic.h"
 #include "clang/Frontend/TextDiagnosticPrinter.h"
 #include "clang/Frontend/Utils.h"
+#include "clang/Lex/HeaderSearch.h"
+#include "clang/Lex/HeaderSearchOptions.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "clang/Lex/Lexer.h"
 #include "clang/Lex/Preprocessor.h"
+#include "clang/Lex/PreprocessorOptions.h"
+#include "clang/Parse/Parser.h"
 #include "clang/Sema/Sema.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Option/ArgList.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <queue>
+#include <set>
+
+#if !defined(_WIN32)
+# include <errno.h>
+# include <signal.h>
+# include <string.h>
+# include <sys/resource.h>
+# include <sys/time.h>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
+
+#if !defined(_WIN32)
+//----------------------------------------------------------------------------
+/// Peak resident set size in KiB from a resource usage report.
+static unsigned long long maxrssKB(struct rusage const& usage)
+{
+#if defined(__APPLE__)
+  // Darwin reports the resident set size in bytes.
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+#endif
+
+//----------------------------------------------------------------------------
+/// Peak resident set size of this process so far in KiB, or 0 where
+/// the system does not report it.
+static unsigned long long peakRSSKB()
+{
+#if !defined(_WIN32)
+  struct rusage usage;
+  if(getrusage(RUSAGE_SELF, &usage) == 0) {
+    return maxrssKB(usage);
+  }
+#endif
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+/// Name of the typedef generated for one '--castxml-instantiate' type.
+static std::string instantiateName(size_t i)
+{
+  return "__castxml_instantiate_" + llvm::utostr(i);
+}
+
+//----------------------------------------------------------------------------
+/// Source declaring a typedef for each '--castxml-instantiate' type.
+/// It is parsed after the end of the main source file.
+static std::string instantiateSource(Options const& opts)
+{
+  std::string src;
+  for(size_t i = 0; i < opts.Instantiate.size(); ++i) {
+    src += "typedef " + opts.Instantiate[i] + " " + instantiateName(i) +
+      ";\n";
+  }
+  return src;
+}
+
+//----------------------------------------------------------------------------
+/// Name of the template of which a declaration is an instantiation, or
+/// an empty string if it is not one.
+static std::string instantiatedTemplateName(clang::Decl const* d)
+{
+  if(clang::FunctionDecl const* fd = clang::dyn_cast<clang::FunctionDecl>(d)) {
+    if(clang::FunctionDecl const* p = fd->getTemplateInstantiationPattern()) {
+      return p->getQualifiedNameAsString();
+    }
+  } else if(clang::ClassTemplateSpecializationDecl const* sd =
+            clang::dyn_cast<clang::ClassTemplateSpecializationDecl>(d)) {
+    if(clang::isTemplateInstantiation(sd->getSpecializationKind())) {
+      return sd->getSpecializedTemplate()->getQualifiedNameAsString();
+    }
+  } else if(clang::CXXRecordDecl const* rd =
+            clang::dyn_cast<clang::CXXRecordDecl>(d)) {
+    if(clang::CXXRecordDecl const* p = rd->getInstantiatedFromMemberClass()) {
+      return p->getQualifiedNameAsString();
+    }
+  }
+  return std::string();
+}
 
 //----------------------------------------------------------------------------
 class ASTConsumer: public clang::ASTConsumer
@@ -52,16 +162,123 @@ class ASTConsumer: public clang::ASTConsumer
   clang::CompilerInstance& CI;
   llvm::raw_ostream& OS;
   Options const& Opts;
+  OutputBase* Base;
   std::queue<clang::CXXRecordDecl*> Classes;
+  std::map<clang::CXXRecordDecl const*, bool> MayInstantiateMap;
+  std::vector<clang::Decl const*> StartDecls;
+  clang::ASTContext* Deferred;
+  std::unique_ptr<InstantiationProfile> Profile;
+  unsigned long long PeakBeforeOutputKB;
+  bool TooManyInstantiations;
 public:
   ASTConsumer(clang::CompilerInstance& ci, llvm::raw_ostream& os,
-              Options const& opts):
-    CI(ci), OS(os), Opts(opts) {}
+              Options const& opts, OutputBase* base):
+    CI(ci), OS(os), Opts(opts), Base(base), Deferred(0),
+    PeakBeforeOutputKB(0), TooManyInstantiations(false) {
+    if(opts.InstantiationReport || opts.MaxInstantiations) {
+      this->Profile.reset(
+        new InstantiationProfile(opts.MaxInstantiations));
+      this->Profile->SetPhase("parsing", false);
+    }
+  }
+
+  /// Record an instantiation for '--castxml-instantiation-report'.
+  /// Once '--castxml-max-instantiations' is exceeded report a fatal
+  /// error with the report and drop the pending instantiations so that
+  /// the translation unit ends without finishing them.
+  void RecordInstantiation(clang::Decl const* d) {
+    if(this->TooManyInstantiations) {
+      return;
+    }
+    std::string const name = instantiatedTemplateName(d);
+    if(name.empty() || this->Profile->Record(name)) {
+      return;
+    }
+    this->TooManyInstantiations = true;
+
+    // Implicit members are added with diagnostics suppressed.
+    clang::Sema& sema = this->CI.getSema();
+    clang::DiagnosticsEngine& diags = sema.getDiagnostics();
+    bool const suppress = diags.getSuppressAllDiagnostics();
+    diags.setSuppressAllDiagnostics(false);
+    diags.Report(diags.getCustomDiagID(
+                   clang::DiagnosticsEngine::Fatal,
+                   "more than %0 template instantiations"))
+      << llvm::utostr(this->Opts.MaxInstantiations);
+    diags.setSuppressAllDiagnostics(suppress);
+    this->ReportInstantiations();
+
+    sema.PendingInstantiations.clear();
+    sema.PendingLocalImplicitInstantiations.clear();
+  }
+
+  void ReportInstantiations() {
+    this->Profile->Report(llvm::errs(),
+                          this->CI.getFrontendOpts().Inputs[0].getFile(),
+                          this->Opts.InstantiationReport?
+                          this->Opts.InstantiationReport : 20);
+  }
+
+  bool HandleTopLevelDecl(clang::DeclGroupRef dg) {
+    // Sema passes each function it instantiates here too.  Classes it
+    // instantiates are passed to HandleTagDeclDefinition.
+    if(this->Profile) {
+      for(clang::Decl const* d : dg) {
+        if(clang::isa<clang::FunctionDecl>(d)) {
+          this->RecordInstantiation(d);
+        }
+      }
+    }
+    return true;
+  }
+
+  /// Whether defining an implicit member of a class may instantiate a
+  /// template, which may fail and leave members out of the output.
+  /// That is so if the class, or a class it contains as a base or
+  /// field, is a template specialization or has member templates.
+  /// Other members these definitions call were checked when parsed.
+  bool MayInstantiate(clang::CXXRecordDecl const* rd) {
+    rd = rd->getDefinition();
+    if(!rd) {
+      return false;
+    }
+    std::map<clang::CXXRecordDecl const*, bool>::iterator i =
+      this->MayInstantiateMap.find(rd);
+    if(i != this->MayInstantiateMap.end()) {
+      return i->second;
+    }
+    bool may = rd->getTemplateSpecializationKind() != clang::TSK_Undeclared;
+    for(clang::DeclContext::decl_iterator d = rd->decls_begin(),
+          e = rd->decls_end(); !may && d != e; ++d) {
+      may = clang::isa<clang::FunctionTemplateDecl>(*d);
+    }
+    for(clang::CXXRecordDecl::base_class_const_iterator
+          b = rd->bases_begin(), e = rd->bases_end(); !may && b != e; ++b) {
+      if(clang::CXXRecordDecl const* brd =
+         b->getType()->getAsCXXRecordDecl()) {
+        may = this->MayInstantiate(brd);
+      }
+    }
+    for(clang::RecordDecl::field_iterator
+          f = rd->field_begin(), e = rd->field_end(); !may && f != e; ++f) {
+      if(clang::CXXRecordDecl const* frd =
+         f->getType()->getBaseElementTypeUnsafe()->getAsCXXRecordDecl()) {
+        may = this->MayInstantiate(frd);
+      }
+    }
+    this->MayInstantiateMap[rd] = may;
+    return may;
+  }
 
   void AddImplicitMembers(clang::CXXRecordDecl* rd) {
     clang::Sema& sema = this->CI.getSema();
     sema.ForceDeclarationOfImplicitMembers(rd);
 
+    // Define the implicit members unless asked not to and that cannot
+    // change the output.
+    bool const declOnly =
+      this->Opts.ImplicitDeclOnly && !this->MayInstantiate(rd);
+
     for(clang::DeclContext::decl_iterator i = rd->decls_begin(),
           e = rd->decls_end(); i != e; ++i) {
       clang::CXXMethodDecl* m = clang::dyn_cast<clang::CXXMethodDecl>(*i);
@@ -79,7 +296,15 @@ public:
           mark = (m->isCopyAssignmentOperator() ||
                   m->isMoveAssignmentOperator());
         }
-        if (mark) {
+        if (mark && declOnly) {
+          /* Compute the exception specification, which the output
+             reads, without defining the member.  Whether it is deleted
+             was determined when it was declared.  */
+          if (clang::FunctionProtoType const* fpt =
+              m->getType()->getAs<clang::FunctionProtoType>()) {
+            sema.ResolveExceptionSpec(clang::SourceLocation(), fpt);
+          }
+        } else if (mark) {
           /* Ensure the member is defined.  */
           sema.MarkFunctionReferenced(clang::SourceLocation(), m);
           /* Finish implicitly instantiated member.  */
@@ -89,7 +314,45 @@ public:
     }
   }
 
+  void AddInstantiated(clang::ASTContext& ctx) {
+    clang::Sema& sema = this->CI.getSema();
+    clang::TranslationUnitDecl* tu = ctx.getTranslationUnitDecl();
+    for(size_t i = 0; i < this->Opts.Instantiate.size(); ++i) {
+      if(this->Profile) {
+        this->Profile->SetPhase("'--castxml-instantiate " +
+                                this->Opts.Instantiate[i] + "'", true);
+      }
+      clang::DeclarationName name(&ctx.Idents.get(instantiateName(i)));
+      for(clang::NamedDecl* n : tu->lookup(name)) {
+        clang::TypedefNameDecl* td =
+          clang::dyn_cast<clang::TypedefNameDecl>(n);
+        if(!td || td->isInvalidDecl()) {
+          continue;
+        }
+        // Start at the declaration of a tag type, completing it first
+        // so that a template specialization is instantiated.  Other
+        // types are reached through the typedef itself.
+        clang::QualType t = td->getUnderlyingType();
+        if(clang::TagType const* tt = t->getAs<clang::TagType>()) {
+          sema.RequireCompleteType(td->getLocation(), t, 0);
+          clang::TagDecl* tag = tt->getDecl();
+          if(clang::TagDecl* def = tag->getDefinition()) {
+            tag = def;
+          }
+          this->StartDecls.push_back(tag);
+        } else {
+          this->StartDecls.push_back(td);
+        }
+      }
+    }
+  }
+
   void HandleTagDeclDefinition(clang::TagDecl* d) {
+    // Classes loaded from a precompiled preamble were not instantiated
+    // by this parse.
+    if(this->Profile && !d->isFromASTFile()) {
+      this->RecordInstantiation(d);
+    }
     if(clang::CXXRecordDecl* rd = clang::dyn_cast<clang::CXXRecordDecl>(d)) {
       if(!rd->isDependentContext()) {
         this->Classes.push(rd);
@@ -97,29 +360,127 @@ public:
     }
   }
 
+  void AddPreambleClasses(clang::DeclContext* dc) {
+    // Classes defined in a precompiled preamble were never passed to
+    // HandleTagDeclDefinition by this parse.  Find them by walking the
+    // declarations loaded from it.
+    for(clang::DeclContext::decl_iterator i = dc->decls_begin(),
+          e = dc->decls_end(); i != e; ++i) {
+      clang::Decl* d = *i;
+      if(clang::ClassTemplateDecl* td =
+         clang::dyn_cast<clang::ClassTemplateDecl>(d)) {
+        for(clang::ClassTemplateDecl::spec_iterator si = td->spec_begin(),
+              se = td->spec_end(); si != se; ++si) {
+          if((*si)->isFromASTFile() && (*si)->isCompleteDefinition()) {
+            this->HandleTagDeclDefinition(*si);
+          }
+        }
+      } else if(clang::CXXRecordDecl* rd =
+                clang::dyn_cast<clang::CXXRecordDecl>(d)) {
+        if(rd->isFromASTFile() && rd->isCompleteDefinition()) {
+          this->HandleTagDeclDefinition(rd);
+        }
+      }
+      if(clang::isa<clang::NamespaceDecl>(d) ||
+         clang::isa<clang::LinkageSpecDecl>(d) ||
+         clang::isa<clang::CXXRecordDecl>(d)) {
+        this->AddPreambleClasses(clang::cast<clang::DeclContext>(d));
+      }
+    }
+  }
+
   void HandleTranslationUnit(clang::ASTContext& ctx) {
+    CASTXML_PROBE(tu__start);
     clang::Sema& sema = this->CI.getSema();
 
+    // Complete the types requested by '--castxml-instantiate'.
+    if(!this->Opts.Instantiate.empty() && !this->TooManyInstantiations) {
+      this->AddInstantiated(ctx);
+    }
+
     // Perform instantiations needed by the original translation unit.
-    sema.PerformPendingInstantiations();
+    if(this->Profile) {
+      this->Profile->SetPhase("end of translation unit", true);
+    }
+    if(!this->TooManyInstantiations) {
+      sema.PerformPendingInstantiations();
+    }
 
-    if (!sema.getDiagnostics().hasErrorOccurred()) {
+    // Record layouts do not depend on implicit members.
+    if (!this->Opts.Layout &&
+        !sema.getDiagnostics().hasErrorOccurred()) {
       // Suppress diagnostics from below extensions to the translation unit.
       sema.getDiagnostics().setSuppressAllDiagnostics(true);
 
+      if(ctx.getExternalSource()) {
+        this->AddPreambleClasses(ctx.getTranslationUnitDecl());
+      }
+
       // Add implicit members to classes.
+      CASTXML_PROBE1(members__start, this->Classes.size());
       while (!this->Classes.empty()) {
         clang::CXXRecordDecl* rd = this->Classes.front();
         this->Classes.pop();
+        if(this->Profile) {
+          this->Profile->SetPhase("implicit members of " +
+                                  rd->getQualifiedNameAsString(), true);
+        }
         this->AddImplicitMembers(rd);
       }
     }
 
     // Tell Clang to finish the translation unit and tear down the parser.
+    if(this->Profile) {
+      this->Profile->SetPhase("end of translation unit", true);
+    }
     sema.ActOnEndOfTranslationUnit();
+    CASTXML_PROBE(tu__done);
+
+    // The fatal error already came with the report.
+    if(this->TooManyInstantiations) {
+      return;
+    }
+
+    if(this->Opts.InstantiationReport) {
+      this->ReportInstantiations();
+    }
+
+    // In lean mode the action writes the output after it has released
+    // the parser and Sema.
+    if(this->Opts.Lean) {
+      this->Deferred = &ctx;
+      return;
+    }
+    this->Output(ctx);
+  }
+
+  /// Whether HandleTranslationUnit left the output to OutputDeferred.
+  bool HasDeferred() const { return this->Deferred != 0; }
+
+  /// Peak resident set size of the process when output started.
+  unsigned long long GetPeakBeforeOutputKB() const {
+    return this->PeakBeforeOutputKB;
+  }
+
+  void OutputDeferred() {
+    this->Output(*this->Deferred);
+    this->Deferred = 0;
+  }
+
+  void Output(clang::ASTContext& ctx) {
+    if(this->Opts.MemoryReport) {
+      this->PeakBeforeOutputKB = peakRSSKB();
+    }
 
     // Process the AST.
-    outputXML(this->CI, ctx, this->OS, this->Opts);
+    CASTXML_PROBE(output__start);
+    if (this->Opts.Layout) {
+      outputLayout(this->CI, ctx, this->OS, this->Opts, this->StartDecls);
+    } else {
+      outputXML(this->CI, ctx, this->OS, this->Opts, this->StartDecls,
+                this->Base);
+    }
+    CASTXML_PROBE(output__done);
   }
 };
 
@@ -163,10 +524,70 @@ protected:
   }
 };
 
+//----------------------------------------------------------------------------
+/// Release the compiler state that the output phase does not read:
+/// Sema, with its lookup tables and instantiation queues, and the
+/// per-file header search information.  The output reads only the AST,
+/// the source manager, and the identifier table, which outlive them.
+static void releaseParseState(clang::CompilerInstance& CI)
+{
+  CI.takeSema().reset();
+  CI.getPreprocessor().getHeaderSearchInfo().ClearFileInfo();
+}
+
+//----------------------------------------------------------------------------
+/// Report for '--castxml-memory-report' after the output of one source.
+/// The growth of the peak during output is what lean mode lowers.
+static void reportMemory(llvm::StringRef input,
+                         unsigned long long beforeKB,
+                         unsigned long long afterKB)
+{
+  std::cerr << "castxml: " << input.str() << ":";
+  if(afterKB) {
+    std::cerr << " peak RSS " << beforeKB << " KiB before output, "
+              << afterKB << " KiB after";
+  } else {
+    std::cerr << " peak RSS not reported on this system";
+  }
+  std::cerr << "\n";
+}
+
+//----------------------------------------------------------------------------
+/// Create the output file of a source, or with '--castxml-output-fd' a
+/// stream writing to the descriptor given.  The compiler instance owns
+/// the stream either way, but does not close the descriptor.
+static llvm::raw_ostream* createOutputStream(clang::CompilerInstance& CI,
+                                             Options const& opts,
+                                             bool binary,
+                                             llvm::StringRef inFile,
+                                             llvm::StringRef extension)
+{
+  if(opts.OutputFd < 0) {
+    return CI.createDefaultOutputFile(binary, inFile, extension);
+  }
+  llvm::raw_ostream* os =
+    new llvm::raw_fd_ostream(opts.OutputFd, /*shouldClose=*/false);
+  CI.addOutputFile(clang::CompilerInstance::OutputFile("", "", os));
+  return os;
+}
+
 //----------------------------------------------------------------------------
 class CastXMLPrintPreprocessedAction:
   public CastXMLPredefines<clang::PrintPreprocessedAction>
 {
+protected:
+  void ExecuteAction() override {
+    if(this->Opts.OutputFd < 0) {
+      clang::PrintPreprocessedAction::ExecuteAction();
+      return;
+    }
+    clang::CompilerInstance& CI = this->getCompilerInstance();
+    llvm::raw_ostream* os = createOutputStream(CI, this->Opts, true,
+                                               this->getCurrentFile(), "");
+    clang::DoPrintPreprocessedInput(CI.getPreprocessor(), os,
+                                    CI.getPreprocessorOutputOpts());
+  }
+
 public:
   CastXMLPrintPreprocessedAction(Options const& opts):
     CastXMLPredefines(opts) {}
@@ -176,35 +597,218 @@ public:
 class CastXMLSyntaxOnlyAction:
   public CastXMLPredefines<clang::SyntaxOnlyAction>
 {
+  OutputBase* Base;
+  ASTConsumer* Consumer;
+
   std::unique_ptr<clang::ASTConsumer>
   CreateASTConsumer(clang::CompilerInstance &CI,
                     llvm::StringRef InFile) override {
     using llvm::sys::path::filename;
-    if(!this->Opts.GccXml) {
+    if(!this->Opts.GccXml && !this->Opts.Layout) {
       return clang::SyntaxOnlyAction::CreateASTConsumer(CI, InFile);
     } else if(llvm::raw_ostream* OS =
-              CI.createDefaultOutputFile(false, filename(InFile), "xml")) {
-      return llvm::make_unique<ASTConsumer>(CI, *OS, this->Opts);
+              createOutputStream(CI, this->Opts, false, filename(InFile),
+                                 this->Opts.Layout? "layout.xml" :
+                                 this->Opts.GccXmlJson? "json" : "xml")) {
+      std::unique_ptr<ASTConsumer> consumer =
+        llvm::make_unique<ASTConsumer>(CI, *OS, this->Opts, this->Base);
+      this->Consumer = consumer.get();
+      return std::move(consumer);
     } else {
       return 0;
     }
   }
+
+  void ExecuteAction() override {
+    if(this->Opts.Instantiate.empty() ||
+       (!this->Opts.GccXml && !this->Opts.Layout)) {
+      clang::SyntaxOnlyAction::ExecuteAction();
+    } else {
+      this->ParseWithInstantiations();
+    }
+
+    // The parser is gone.  In lean mode release Sema too before the
+    // output phase allocates its own tables.
+    clang::CompilerInstance& CI = this->getCompilerInstance();
+    if(this->Consumer && this->Consumer->HasDeferred()) {
+      releaseParseState(CI);
+      this->Consumer->OutputDeferred();
+    }
+    if(this->Opts.MemoryReport && this->Consumer) {
+      reportMemory(this->getCurrentFile(),
+                   this->Consumer->GetPeakBeforeOutputKB(), peakRSSKB());
+    }
+  }
+
+  void ParseWithInstantiations() {
+    // Parse as clang::ParseAST does but keep the parser after the end
+    // of the main source file to parse the instantiation requests.
+    clang::CompilerInstance& CI = this->getCompilerInstance();
+    if(!CI.hasPreprocessor()) {
+      return;
+    }
+    if(!CI.hasSema()) {
+      CI.createSema(this->getTranslationUnitKind(), nullptr);
+    }
+    clang::Sema& sema = CI.getSema();
+    clang::Preprocessor& pp = sema.getPreprocessor();
+    clang::ASTConsumer& consumer = sema.getASTConsumer();
+    clang::Parser parser(pp, sema, CI.getFrontendOpts().SkipFunctionBodies);
+    pp.EnterMainSourceFile();
+    parser.Initialize();
+    if(clang::ExternalASTSource* external =
+       sema.getASTContext().getExternalSource()) {
+      external->StartTranslationUnit(&consumer);
+    }
+
+    clang::Parser::DeclGroupPtrTy dg;
+    while(!parser.ParseTopLevelDecl(dg)) {
+      if(dg && !consumer.HandleTopLevelDecl(dg.get())) {
+        return;
+      }
+    }
+
+    // Incremental processing left the parser at the end of the main
+    // file.  Enter the generated source and continue parsing.
+    clang::FileID fid = CI.getSourceManager().createFileID(
+      llvm::MemoryBuffer::getMemBufferCopy(instantiateSource(this->Opts),
+                                           "<castxml-instantiate>"));
+    pp.EnterSourceFile(fid, nullptr, clang::SourceLocation());
+    parser.ConsumeToken();
+    while(!parser.ParseTopLevelDecl(dg)) {
+      if(dg && !consumer.HandleTopLevelDecl(dg.get())) {
+        return;
+      }
+    }
+
+    // Process any top-level declarations generated by #pragma weak.
+    for(clang::Decl* d : sema.WeakTopLevelDecls()) {
+      consumer.HandleTopLevelDecl(clang::DeclGroupRef(d));
+    }
+
+    consumer.HandleTranslationUnit(sema.getASTContext());
+  }
+public:
+  CastXMLSyntaxOnlyAction(Options const& opts, OutputBase* base):
+    CastXMLPredefines(opts), Base(base), Consumer(0) {}
+};
+
+//----------------------------------------------------------------------------
+/// CastXMLScanDepsAction - Run only the preprocessor, over each source
+/// reduced to its directives, and write the files it includes with a
+/// hash of their content.
+class CastXMLScanDepsAction:
+  public CastXMLPredefines<clang::PreprocessorFrontendAction>
+{
+  class Callbacks: public clang::PPCallbacks
+  {
+    CastXMLScanDepsAction& Action;
+  public:
+    Callbacks(CastXMLScanDepsAction& action): Action(action) {}
+    void InclusionDirective(clang::SourceLocation, clang::Token const&,
+                            llvm::StringRef, bool, clang::CharSourceRange,
+                            clang::FileEntry const* file, llvm::StringRef,
+                            llvm::StringRef, clang::Module const*) override {
+      if(file) {
+        this->Action.Minimize(file);
+      }
+    }
+  };
+
+  std::set<clang::FileEntry const*> Seen;
+  std::vector<std::pair<std::string, std::string> > Files;
+
+  /// Record the hash of a file and replace its content, before the
+  /// preprocessor first enters it, by its directives.
+  void Minimize(clang::FileEntry const* file) {
+    if(!this->Seen.insert(file).second) {
+      return;
+    }
+    clang::CompilerInstance& CI = this->getCompilerInstance();
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer> > buf =
+      CI.getFileManager().getBufferForFile(file);
+    if(!buf) {
+      // Let the preprocessor report the error.
+      return;
+    }
+    llvm::StringRef text = (*buf)->getBuffer();
+    this->Files.push_back(std::make_pair(
+      cxsys::SystemTools::CollapseFullPath(file->getName()),
+      scanDepsHash(text)));
+    CI.getSourceManager().overrideFileContents(
+      file, llvm::MemoryBuffer::getMemBufferCopy(
+        minimizeSource(text), file->getName()).release());
+  }
+
+protected:
+  void ExecuteAction() override {
+    clang::CompilerInstance& CI = this->getCompilerInstance();
+    llvm::raw_ostream* os = createOutputStream(
+      CI, this->Opts, false,
+      llvm::sys::path::filename(this->getCurrentFile()), "deps");
+    if(!os) {
+      return;
+    }
+
+    clang::SourceManager& sm = CI.getSourceManager();
+    clang::Preprocessor& pp = CI.getPreprocessor();
+    pp.addPPCallbacks(llvm::make_unique<Callbacks>(*this));
+    if(clang::FileEntry const* main =
+       sm.getFileEntryForID(sm.getMainFileID())) {
+      this->Minimize(main);
+    }
+    pp.EnterMainSourceFile();
+    clang::Token tok;
+    do {
+      pp.Lex(tok);
+    } while(tok.isNot(clang::tok::eof));
+
+    for(std::pair<std::string, std::string> const& f : this->Files) {
+      *os << f.second << "  " << f.first << "\n";
+    }
+  }
+
 public:
-  CastXMLSyntaxOnlyAction(Options const& opts):
+  CastXMLScanDepsAction(Options const& opts): CastXMLPredefines(opts) {}
+};
+
+//----------------------------------------------------------------------------
+/// CastXMLGeneratePreambleAction - Build a precompiled preamble with the
+/// same predefines as the main parse.
+class CastXMLGeneratePreambleAction:
+  public CastXMLPredefines<clang::GeneratePCHAction>
+{
+public:
+  CastXMLGeneratePreambleAction(Options const& opts):
     CastXMLPredefines(opts) {}
+
+  bool BeginSourceFileAction(clang::CompilerInstance& CI,
+                             llvm::StringRef /*Filename*/) override {
+    // Unlike the main parse, let the parser finish the translation
+    // unit prefix at EOF as usual.
+    if(this->Opts.HaveCC) {
+      CI.getPreprocessor().setPredefines(
+      this->UpdatePredefines(CI.getPreprocessor().getPredefines()));
+    }
+    return true;
+  }
 };
 
 //----------------------------------------------------------------------------
 static clang::FrontendAction*
-CreateFrontendAction(clang::CompilerInstance* CI, Options const& opts)
+CreateFrontendAction(clang::CompilerInstance* CI, Options const& opts,
+                     OutputBase* base)
 {
   clang::frontend::ActionKind action =
     CI->getInvocation().getFrontendOpts().ProgramAction;
   switch(action) {
   case clang::frontend::PrintPreprocessedInput:
+    if(opts.ScanDeps) {
+      return new CastXMLScanDepsAction(opts);
+    }
     return new CastXMLPrintPreprocessedAction(opts);
   case clang::frontend::ParseSyntaxOnly:
-    return new CastXMLSyntaxOnlyAction(opts);
+    return new CastXMLSyntaxOnlyAction(opts, base);
   default:
     std::cerr << "error: unsupported action: " << int(action) << "\n";
     return 0;
@@ -212,7 +816,145 @@ CreateFrontendAction(clang::CompilerInstance* CI, Options const& opts)
 }
 
 //----------------------------------------------------------------------------
-static bool runClangCI(clang::CompilerInstance* CI, Options const& opts)
+/// Name of the main source file of a compiler instance.
+static std::string inputName(clang::CompilerInstance const* CI)
+{
+  clang::FrontendOptions const& fo = CI->getFrontendOpts();
+  if(fo.Inputs.empty()) {
+    return std::string();
+  }
+  llvm::SmallString<256> path(fo.Inputs[0].getFile());
+  llvm::sys::fs::make_absolute(path);
+  return std::string(path.str());
+}
+
+//----------------------------------------------------------------------------
+/// Build a precompiled preamble from the given text in place of the main
+/// source file of a compiler instance, and record the files it read.
+static bool buildPreamble(clang::CompilerInstance* CI, Options const& opts,
+                          std::string const& text, std::string const& pch,
+                          std::string const& deps, std::string const& hash)
+{
+  if(llvm::sys::fs::create_directories(opts.PreambleCache)) {
+    return false;
+  }
+  std::string const mainFile = CI->getFrontendOpts().Inputs[0].getFile();
+
+  clang::CompilerInstance P;
+  P.setInvocation(new clang::CompilerInvocation(CI->getInvocation()));
+  clang::FrontendOptions& fo = P.getFrontendOpts();
+  fo.ProgramAction = clang::frontend::GeneratePCH;
+  fo.OutputFile = pch;
+  fo.DisableFree = false;
+
+  // Parse only the preamble, finished by a newline as clang::ASTUnit
+  // does in case it does not end at the start of a line.
+  clang::PreprocessorOptions& ppo = P.getPreprocessorOpts();
+  ppo.PrecompiledPreambleBytes = std::make_pair(0u, false);
+  ppo.addRemappedFile(mainFile, llvm::MemoryBuffer::getMemBufferCopy(
+                        text + "\n", mainFile).release());
+
+  // Diagnostics repeat in the main parse, so do not show them here.
+  P.createDiagnostics(new clang::IgnoringDiagConsumer);
+  CastXMLGeneratePreambleAction action(opts);
+  if(!P.ExecuteAction(action) || P.getDiagnostics().hasErrorOccurred()) {
+    return false;
+  }
+
+  // Record every file read except the main file, which is covered by
+  // the hash of the preamble text.
+  llvm::sys::fs::UniqueID mainID;
+  llvm::sys::fs::getUniqueID(mainFile, mainID);
+  std::vector<PreambleDep> files;
+  llvm::SmallVector<clang::FileEntry const*, 64> entries;
+  P.getFileManager().GetUniqueIDMapping(entries);
+  for(clang::FileEntry const* fe : entries) {
+    if(fe && fe->getUniqueID() != mainID) {
+      files.push_back(PreambleDep(
+        cxsys::SystemTools::CollapseFullPath(fe->getName()),
+        static_cast<unsigned long long>(fe->getSize()),
+        static_cast<long long>(fe->getModificationTime())));
+    }
+  }
+  return preambleStore(deps, hash, files);
+}
+
+//----------------------------------------------------------------------------
+/// Parse the leading preprocessor block of the main source file from a
+/// precompiled preamble kept in the '--castxml-preamble-cache' directory,
+/// building it first if it is missing or out of date.
+static void usePreamble(clang::CompilerInstance* CI, Options const& opts)
+{
+  clang::CompilerInvocation& inv = CI->getInvocation();
+  clang::FrontendOptions const& fo = inv.getFrontendOpts();
+  clang::PreprocessorOptions& ppo = inv.getPreprocessorOpts();
+  if(fo.Inputs.size() != 1 || !fo.Inputs[0].isFile() ||
+     fo.Inputs[0].getFile() == "-" ||
+     fo.Inputs[0].getKind() == clang::IK_AST ||
+     fo.Inputs[0].getKind() == clang::IK_LLVM_IR ||
+     !ppo.ImplicitPCHInclude.empty()) {
+    return;
+  }
+
+  std::string const mainFile = inputName(CI);
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer> > buf =
+    llvm::MemoryBuffer::getFile(mainFile);
+  if(!buf) {
+    return;
+  }
+  std::pair<unsigned, bool> bounds =
+    clang::Lexer::ComputePreamble((*buf)->getBuffer(), *inv.getLangOpts());
+  if(bounds.first == 0) {
+    return;
+  }
+  std::string const text =
+    (*buf)->getBuffer().substr(0, bounds.first).str();
+
+  // Name the preamble after everything that affects its content other
+  // than the preamble text itself, including detected predefines.
+  std::vector<std::string> parts;
+  parts.push_back(getVersionString());
+  parts.push_back(inv.getModuleHash());
+  parts.push_back(opts.HaveCC? opts.Predefines : std::string());
+  parts.push_back(mainFile);
+  clang::HeaderSearchOptions const& hso = inv.getHeaderSearchOpts();
+  parts.push_back(hso.Sysroot);
+  parts.push_back(hso.ResourceDir);
+  for(clang::HeaderSearchOptions::Entry const& e : hso.UserEntries) {
+    parts.push_back(llvm::utostr(unsigned(e.Group)) +
+                    (e.IsFramework? "F" : "I") + e.Path);
+  }
+  for(std::pair<std::string, bool> const& m : ppo.Macros) {
+    parts.push_back((m.second? "-U" : "-D") + m.first);
+  }
+  for(std::string const& i : ppo.Includes) {
+    parts.push_back("-include" + i);
+  }
+  for(std::string const& i : ppo.MacroIncludes) {
+    parts.push_back("-imacros" + i);
+  }
+  llvm::SmallString<256> base(opts.PreambleCache);
+  llvm::sys::path::append(base, preambleHash(parts));
+  std::string const pch = std::string(base.str()) + ".pch";
+  std::string const deps = std::string(base.str()) + ".deps";
+
+  std::string const hash = preambleHash(std::vector<std::string>(1, text));
+  if(!preambleValid(deps, hash) || !llvm::sys::fs::exists(pch)) {
+    if(!buildPreamble(CI, opts, text, pch, deps, hash)) {
+      return;
+    }
+  }
+
+  // Load the preamble and skip its text in the main source file.  The
+  // dependencies were checked above, as clang::ASTUnit does.
+  ppo.ImplicitPCHInclude = pch;
+  ppo.PrecompiledPreambleBytes = bounds;
+  ppo.DisablePCHValidation = true;
+}
+
+//----------------------------------------------------------------------------
+static bool runClangCI(clang::CompilerInstance* CI, Options const& opts,
+                       OutputBase* base)
 {
   // Create a diagnostics engine for this compiler instance.
   CI->createDiagnostics();
@@ -220,8 +962,11 @@ static bool runClangCI(clang::CompilerInstance* CI, Options const& opts)
     return false;
   }
 
-  // Set frontend options we captured directly.
-  CI->getFrontendOpts().OutputFile = opts.OutputFile;
+  // Set frontend options we captured directly.  The output file of a
+  // job for one of several targets was named when it was created.
+  if(opts.Targets.empty()) {
+    CI->getFrontendOpts().OutputFile = opts.OutputFile;
+  }
 
   if(opts.GccXml) {
 #   define MSG(x) "error: '--castxml-gccxml' does not work with " x "\n"
@@ -244,18 +989,372 @@ static bool runClangCI(clang::CompilerInstance* CI, Options const& opts)
 #   undef MSG
   }
 
+  // Reuse a precompiled preamble of the main source file if requested.
+  // Its dependencies are checked on disk, where archived files are not.
+  if(!opts.PreambleCache.empty() && opts.VFSArchives.empty() &&
+     CI->getFrontendOpts().ProgramAction ==
+     clang::frontend::ParseSyntaxOnly) {
+    usePreamble(CI, opts);
+  }
+
   // Construct our Clang front-end action.  This dispatches
   // handling of each input file with an action based on the
   // flags provided (e.g. -E to preprocess-only).
   std::unique_ptr<clang::FrontendAction>
-    action(CreateFrontendAction(CI, opts));
+    action(CreateFrontendAction(CI, opts, base));
   if(action) {
-    return CI->ExecuteAction(*action);
+    if(CASTXML_PROBE_ENABLED(source__start)) {
+      CASTXML_PROBE1(source__start, inputName(CI).c_str());
+    }
+    bool ok = CI->ExecuteAction(*action);
+    if(CASTXML_PROBE_ENABLED(source__done)) {
+      CASTXML_PROBE2(source__done, inputName(CI).c_str(), ok);
+    }
+    return ok;
   } else {
     return false;
   }
 }
 
+//----------------------------------------------------------------------------
+/// Seconds since an arbitrary point, for measuring jobs.
+static double wallSeconds()
+{
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#if !defined(_WIN32)
+//----------------------------------------------------------------------------
+/// ForkPool - Run compiler instances in forked child processes, at most
+/// a given number at a time.  This gives process parallelism only: each
+/// child works on its own copy of the state initialized by the parent,
+/// and nothing it computes, such as the file system lookups cached by
+/// its file manager, is seen by the parent or the other children.  A
+/// crash in one child does not affect the others.  With a memory limit
+/// a job is started only while the peak memory projected for the
+/// running jobs and the new one stays under the limit.  The pool then
+/// blocks until a child exits, and learns its actual peak from wait4.
+class ForkPool
+{
+  struct Job {
+    Job(): Start(0), BudgetKB(0) {}
+    std::string Input;
+    double Start;
+    unsigned long long BudgetKB;
+  };
+  unsigned int Limit;
+  unsigned long long MaxKB;
+  JobHistory* History;
+  HeaderIndex* Index;
+  std::map<pid_t, Job> Running;
+  bool Result;
+
+  unsigned long long ProjectedKB() const {
+    unsigned long long total = 0;
+    for(std::map<pid_t, Job>::const_iterator i = this->Running.begin();
+        i != this->Running.end(); ++i) {
+      total += i->second.BudgetKB;
+    }
+    return total;
+  }
+
+  /// Block until a child exits and record its result.
+  void WaitOne() {
+    int status = 0;
+    struct rusage usage;
+    pid_t pid = wait4(-1, &status, 0, &usage);
+    if(pid < 0) {
+      if(errno != EINTR) {
+        // No children remain to be waited for.
+        this->Running.clear();
+      }
+      return;
+    }
+    std::map<pid_t, Job>::iterator i = this->Running.find(pid);
+    if(i == this->Running.end()) {
+      return;
+    }
+    Job& job = i->second;
+    unsigned long long peakKB = maxrssKB(usage);
+    if(job.BudgetKB && peakKB > job.BudgetKB) {
+      std::cerr << "warning: job for '" << job.Input << "' used "
+                << (peakKB / 1024) << " MiB, more than its projected "
+                << (job.BudgetKB / 1024) << " MiB\n";
+    }
+    if(WIFSIGNALED(status)) {
+      std::cerr << "error: job for '" << job.Input
+                << "' terminated by signal " << WTERMSIG(status);
+      if(WTERMSIG(status) == SIGKILL && this->MaxKB) {
+        std::cerr << " after using " << (peakKB / 1024) << " MiB";
+      }
+      std::cerr << "\n";
+      this->Result = false;
+    } else if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      this->Result = false;
+    } else if(this->History) {
+      this->History->Record(job.Input, wallSeconds() - job.Start, peakKB);
+    }
+    this->Running.erase(i);
+  }
+
+  /// Wait until a job with the given projected memory may start.  A job
+  /// always starts when no others are running, even if over the limit.
+  void WaitForSlot(unsigned long long budgetKB) {
+    while(!this->Running.empty() &&
+          (this->Running.size() >= this->Limit ||
+           (this->MaxKB &&
+            this->ProjectedKB() + budgetKB > this->MaxKB))) {
+      this->WaitOne();
+    }
+  }
+
+  static void FlushOutput() {
+    std::cout.flush();
+    std::cerr.flush();
+    llvm::outs().flush();
+    llvm::errs().flush();
+  }
+
+public:
+  ForkPool(unsigned int limit, unsigned long long maxKB,
+           JobHistory* history, HeaderIndex* index):
+    Limit(limit), MaxKB(maxKB), History(history), Index(index),
+    Result(true) {}
+
+  void Run(clang::CompilerInstance* CI, Options const& opts) {
+    Job job;
+    job.Input = inputName(CI);
+    if(this->MaxKB && this->History) {
+      job.BudgetKB = this->History->EstimatePeakKB(job.Input);
+    }
+    this->WaitForSlot(job.BudgetKB);
+
+    // Do not let the child write output buffered by the parent again.
+    FlushOutput();
+    job.Start = wallSeconds();
+    pid_t pid = fork();
+    if(pid == 0) {
+      bool result = runClangCI(CI, opts, 0);
+      if(this->Index) {
+        // Directories listed by this child are not seen by the parent.
+        this->Index->Save();
+      }
+      FlushOutput();
+      _exit(result? 0:1);
+    } else if(pid < 0) {
+      std::cerr << "error: could not fork: " << strerror(errno) << "\n";
+      this->Result = false;
+    } else {
+      this->Running[pid] = job;
+    }
+  }
+
+  bool Finish() {
+    while(!this->Running.empty()) {
+      this->WaitOne();
+    }
+    return this->Result;
+  }
+};
+#endif
+
+//----------------------------------------------------------------------------
+/// Answer that a file does not exist when the header index knows it,
+/// so probes of include directories that fail need no system call.
+/// Probes are made in the usual order, so the search is unchanged.
+class HeaderIndexStatCache: public clang::FileSystemStatCache
+{
+  HeaderIndex& Index;
+public:
+  HeaderIndexStatCache(HeaderIndex& index): Index(index) {}
+
+  LookupResult getStat(const char* path, clang::FileData& data,
+                       bool isFile, std::unique_ptr<clang::vfs::File>* f,
+                       clang::vfs::FileSystem& fs) override {
+    if(this->Index.IsMissing(path)) {
+      return CacheMissing;
+    }
+    return statChained(path, data, isFile, f, fs);
+  }
+};
+
+//----------------------------------------------------------------------------
+/// Create a compiler instance from the arguments of one cc1 job.
+static std::unique_ptr<clang::CompilerInstance>
+createCI(std::vector<std::string> const& job,
+         clang::DiagnosticsEngine& diags, HeaderIndex* index,
+         llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem> const& vfs,
+         clang::FileManager* files)
+{
+  std::vector<const char*> cmdArgs;
+  for(std::string const& a : job) {
+    cmdArgs.push_back(a.c_str());
+  }
+  std::unique_ptr<clang::CompilerInstance> CI(new clang::CompilerInstance());
+  const char* const* cmdArgBeg = cmdArgs.data();
+  const char* const* cmdArgEnd = cmdArgBeg + cmdArgs.size();
+  if (!clang::CompilerInvocation::CreateFromArgs
+      (CI->getInvocation(), cmdArgBeg, cmdArgEnd, diags)) {
+    CI.reset();
+    return CI;
+  }
+
+  // Serve files from the archives given.  A file system overlay would
+  // have to be stacked on them and is not supported.
+  clang::HeaderSearchOptions const& hso = CI->getHeaderSearchOpts();
+  if(vfs) {
+    if(!hso.VFSOverlayFiles.empty()) {
+      std::cerr << "error: '--castxml-vfs-archive' may not be given with "
+                   "'-ivfsoverlay'\n";
+      CI.reset();
+      return CI;
+    }
+    CI->setVirtualFileSystem(vfs);
+  }
+
+  // Share the file manager, and with it the results of file system
+  // lookups, with the instances of other targets run in this process.
+  if(files && hso.VFSOverlayFiles.empty()) {
+    CI->setFileManager(files);
+  }
+
+  // Answer probes of the include directories from the index.  A file
+  // system overlay would have to be set up before the file manager.
+  if(index && hso.VFSOverlayFiles.empty()) {
+    bool const newFiles = !CI->hasFileManager();
+    if(newFiles) {
+      CI->createFileManager();
+    }
+    for(clang::HeaderSearchOptions::Entry const& e : hso.UserEntries) {
+      if(!hso.Sysroot.empty() && !e.IgnoreSysRoot &&
+         llvm::StringRef(e.Path).startswith("/")) {
+        index->AddRoot(hso.Sysroot + e.Path);
+      } else {
+        index->AddRoot(e.Path);
+      }
+    }
+    if(newFiles) {
+      CI->getFileManager().addStatCache(
+        llvm::make_unique<HeaderIndexStatCache>(*index));
+    }
+  }
+  return CI;
+}
+
+//----------------------------------------------------------------------------
+/// Name the output file of a job for one of the '--castxml-targets' by
+/// replacing '{triple}' in the '-o' file name with the target, or by
+/// inserting the target before the extension of the default name.
+static std::string targetOutputFile(Options const& opts,
+                                    std::string const& target,
+                                    clang::CompilerInstance const* CI)
+{
+  std::string out = opts.OutputFile;
+  if(!out.empty()) {
+    std::string::size_type pos = out.find("{triple}");
+    if(pos != std::string::npos) {
+      out.replace(pos, 8, target);
+    }
+  } else if(opts.GccXml || opts.Layout) {
+    std::string const input = inputName(CI);
+    if(input != "-") {
+      out = std::string(llvm::sys::path::filename(input)) + "." + target +
+        (opts.Layout? ".layout.xml" : opts.GccXmlJson? ".json" : ".xml");
+    }
+  }
+  return out;
+}
+
+//----------------------------------------------------------------------------
+/// Re-run each job whenever a file it read changes.  Only the jobs
+/// affected by a change run again, and state initialized by castxml
+/// itself, such as the compiler commands, is kept.  The number of jobs
+/// whose last run failed is reported after each change.  Never returns
+/// unless watching fails.
+static bool runClangWatch(CC1Jobs const& jobs,
+                          std::vector<std::string> const& targets,
+                          std::vector<Options const*> const& jobOpts,
+                          clang::DiagnosticsEngine& diags,
+                          Options const& opts, HeaderIndex* index)
+{
+  std::vector<std::set<std::string> > files(jobs.size());
+  std::vector<bool> dirty(jobs.size(), true);
+  std::vector<bool> failed(jobs.size(), false);
+  FileWatcher watcher;
+  for(;;) {
+    for(size_t j = 0; j < jobs.size(); ++j) {
+      if(!dirty[j]) {
+        continue;
+      }
+      dirty[j] = false;
+      std::unique_ptr<clang::CompilerInstance> CI =
+        createCI(jobs[j], diags, index, nullptr, nullptr);
+      if(!CI) {
+        return false;
+      }
+      if(!targets[j].empty()) {
+        CI->getFrontendOpts().OutputFile =
+          targetOutputFile(opts, targets[j], CI.get());
+      }
+      // The process lives on, so free each AST after its output.
+      CI->getFrontendOpts().DisableFree = false;
+      failed[j] = !runClangCI(CI.get(), *jobOpts[j], 0);
+
+      // Watch every file read for this job, or keep watching those of
+      // the previous run if this one did not get as far.
+      std::set<std::string> read;
+      read.insert(cxsys::SystemTools::CollapseFullPath(inputName(CI.get())));
+      if(CI->hasFileManager()) {
+        llvm::SmallVector<clang::FileEntry const*, 64> entries;
+        CI->getFileManager().GetUniqueIDMapping(entries);
+        for(clang::FileEntry const* fe : entries) {
+          if(fe) {
+            read.insert(cxsys::SystemTools::CollapseFullPath(fe->getName()));
+          }
+        }
+      }
+      if(read.size() > 1 || files[j].empty()) {
+        files[j].swap(read);
+      }
+    }
+
+    if(index && !index->Save()) {
+      std::cerr << "warning: could not write '" << opts.HeaderIndex
+                << "'\n";
+    }
+
+    std::set<std::string> all;
+    for(std::set<std::string> const& f : files) {
+      all.insert(f.begin(), f.end());
+    }
+    watcher.SetFiles(all);
+    size_t const nfailed = std::count(failed.begin(), failed.end(), true);
+    if(nfailed) {
+      std::cerr << "castxml: " << nfailed << " of " << jobs.size()
+                << " sources failed\n";
+    }
+    std::cerr << "castxml: watching " << all.size() << " files\n";
+
+    std::vector<std::string> changed;
+    if(!watcher.Wait(changed)) {
+      std::cerr << "error: could not watch files for changes\n";
+      return false;
+    }
+    if(index) {
+      index->Invalidate();
+    }
+    for(size_t j = 0; j < jobs.size(); ++j) {
+      for(std::string const& c : changed) {
+        if(files[j].count(c)) {
+          dirty[j] = true;
+          break;
+        }
+      }
+    }
+  }
+}
+
 //----------------------------------------------------------------------------
 static llvm::IntrusiveRefCntPtr<clang::DiagnosticsEngine>
 runClangCreateDiagnostics(const char* const* argBeg, const char* const* argEnd)
@@ -278,133 +1377,393 @@ runClangCreateDiagnostics(const char* const* argBeg, const char* const* argEnd)
   return diags;
 }
 
+//----------------------------------------------------------------------------
+/// Add the arguments that make the Clang driver match the compiler
+/// given by '--castxml-cc-<id>', using the settings detected from it.
+static void addCCArgs(Options const& opts,
+                      llvm::SmallVectorImpl<const char*>& args,
+                      std::string& fmsc_version)
+{
+  // Configure target to match that of given compiler.
+  if(!opts.HaveTarget && !opts.Triple.empty()) {
+    args.push_back("-target");
+    args.push_back(opts.Triple.c_str());
+  }
+
+  // Tell Clang driver not to add its header search paths.
+  args.push_back("-nobuiltininc");
+  args.push_back("-nostdlibinc");
+
+  // Add header search paths detected from given compiler.
+  for(std::vector<Options::Include>::const_iterator
+        i = opts.Includes.begin(), e = opts.Includes.end();
+      i != e; ++i) {
+    if(i->Framework) {
+      args.push_back("-iframework");
+    } else {
+      args.push_back("-isystem");
+    }
+    args.push_back(i->Directory.c_str());
+  }
+
+  // Tell Clang not to add its predefines.
+  args.push_back("-undef");
+
+  // Configure language options to match given compiler.
+  const char* pd = opts.Predefines.c_str();
+  if(strstr(pd, "#define _MSC_EXTENSIONS ")) {
+    args.push_back("-fms-extensions");
+  }
+  if(const char* d = strstr(pd, "#define _MSC_VER ")) {
+    args.push_back("-fms-compatibility");
+    // Extract the _MSC_VER value to give to -fmsc-version=.
+    d += 17;
+    if(const char* e = strchr(d, '\n')) {
+      if(*(e - 1) == '\r') {
+        --e;
+      }
+      fmsc_version = "-fmsc-version=" + std::string(d, e-d);
+      args.push_back(fmsc_version.c_str());
+    }
+  }
+}
+
 //----------------------------------------------------------------------------
 static int runClangImpl(const char* const* argBeg,
                         const char* const* argEnd,
                         Options const& opts)
 {
-  // Construct a diagnostics engine for use while processing driver options.
-  llvm::IntrusiveRefCntPtr<clang::DiagnosticsEngine> diags =
-    runClangCreateDiagnostics(argBeg, argEnd);
-
-  // Use the approach in clang::createInvocationFromCommandLine to
-  // get system compiler setting arguments from the Driver.
-  clang::driver::Driver d("clang", llvm::sys::getDefaultTargetTriple(),
-                          *diags);
-  if(!cxsys::SystemTools::FileIsFullPath(d.ResourceDir.c_str()) ||
-     !cxsys::SystemTools::FileIsDirectory(d.ResourceDir.c_str())) {
-    d.ResourceDir = getClangResourceDir();
-  }
   llvm::SmallVector<const char *, 16> cArgs;
   cArgs.push_back("<clang>");
-  cArgs.insert(cArgs.end(), argBeg, argEnd);
+
+  // Read a source given as '-' from stdin as C++ unless a language is
+  // in effect for it, since the driver cannot tell it from a file name.
+  // A language is given by '-x <lang>' or '-x<lang>' until '-x none'.
+  llvm::StringRef lang;
+  for(const char* const* a = argBeg; a != argEnd; ++a) {
+    if(strcmp(*a, "-x") == 0 && a + 1 != argEnd) {
+      cArgs.push_back(*a++);
+      lang = *a;
+      cArgs.push_back(*a);
+    } else if(strncmp(*a, "-x", 2) == 0 && (*a)[2]) {
+      lang = *a + 2;
+      cArgs.push_back(*a);
+    } else if((lang.empty() || lang == "none") && strcmp(*a, "-") == 0) {
+      cArgs.push_back("-x");
+      cArgs.push_back("c++");
+      cArgs.push_back(*a);
+      if(a + 1 != argEnd) {
+        cArgs.push_back("-x");
+        cArgs.push_back("none");
+      }
+    } else {
+      cArgs.push_back(*a);
+    }
+  }
 
   // Tell the driver not to generate any commands past syntax parsing.
-  if(opts.PPOnly) {
+  if(opts.PPOnly || opts.ScanDeps) {
     cArgs.push_back("-E");
   } else {
     cArgs.push_back("-fsyntax-only");
   }
 
-  // Ask the driver to build the compiler commands for us.
-  std::unique_ptr<clang::driver::Compilation> c(d.BuildCompilation(cArgs));
+  // Build the compiler commands once for each target requested, or
+  // once for the target given by the arguments.  Each job remembers
+  // its target to name its output, and the options to run it with,
+  // which hold the settings detected for its target.
+  std::vector<std::string> targets(opts.Targets);
+  if(targets.empty()) {
+    targets.push_back(std::string());
+  }
+  std::vector<Options> targetOpts(targets.size(), opts);
+  for(size_t t = 0; t < opts.TargetCCs.size(); ++t) {
+    targetOpts[t].Includes = opts.TargetCCs[t].Includes;
+    targetOpts[t].Predefines = opts.TargetCCs[t].Predefines;
+    targetOpts[t].Triple = targets[t];
+  }
+  CC1Jobs jobs;
+  std::vector<std::string> jobTargets;
+  std::vector<Options const*> jobOpts;
+  bool result = true;
+  llvm::IntrusiveRefCntPtr<clang::DiagnosticsEngine> diags;
+  std::string resourceDir;
+  for(size_t t = 0; t < targets.size(); ++t) {
+    std::string const& target = targets[t];
+    llvm::SmallVector<const char *, 16> tArgs(cArgs);
+    std::string fmsc_version;
+    if(!target.empty()) {
+      if(opts.HaveCC) {
+        addCCArgs(targetOpts[t], tArgs, fmsc_version);
+      } else {
+        tArgs.push_back("-target");
+        tArgs.push_back(target.c_str());
+      }
+    }
 
-  // For '-###' just print the jobs and exit early.
-  if(c->getArgs().hasArg(clang::driver::options::OPT__HASH_HASH_HASH)) {
-    c->getJobs().Print(llvm::errs(), "\n", true);
-    return 0;
+    // Look for the compiler commands the driver built for the same
+    // arguments before.  On a hit skip the driver entirely.
+    std::string const cc1Key =
+      cc1CacheKey(tArgs.data(), tArgs.data() + tArgs.size());
+    CC1Jobs tJobs;
+    if(cc1CacheLoad(opts.CC1Cache, cc1Key, tJobs)) {
+      // Report errors in the cached commands with the diagnostic
+      // options the driver passed to them, such as '-w', '-Werror' and
+      // whether to use color.
+      if(!diags) {
+        std::vector<const char*> cc1Args;
+        if(!tJobs.empty()) {
+          for(std::string const& a : tJobs.front()) {
+            cc1Args.push_back(a.c_str());
+          }
+        }
+        diags = runClangCreateDiagnostics(cc1Args.data(),
+                                          cc1Args.data() + cc1Args.size());
+      }
+    } else {
+      // Construct a diagnostics engine for use while processing driver
+      // options.
+      diags = runClangCreateDiagnostics(argBeg, argEnd);
+
+      // Use the approach in clang::createInvocationFromCommandLine to
+      // get system compiler setting arguments from the Driver.
+      clang::driver::Driver d("clang", llvm::sys::getDefaultTargetTriple(),
+                              *diags);
+      if(resourceDir.empty()) {
+        resourceDir = d.ResourceDir;
+        if(!cxsys::SystemTools::FileIsFullPath(resourceDir.c_str()) ||
+           !cxsys::SystemTools::FileIsDirectory(resourceDir.c_str())) {
+          resourceDir = getClangResourceDir();
+        }
+      }
+      d.ResourceDir = resourceDir;
+
+      // Ask the driver to build the compiler commands for us.
+      std::unique_ptr<clang::driver::Compilation>
+        c(d.BuildCompilation(tArgs));
+
+      // For '-###' just print the jobs and exit early.
+      if(c->getArgs().hasArg(clang::driver::options::OPT__HASH_HASH_HASH)) {
+        c->getJobs().Print(llvm::errs(), "\n", true);
+        return 0;
+      }
+
+      // Reject '-o' or '--castxml-output-fd' with multiple inputs.
+      if((!opts.OutputFile.empty() || opts.OutputFd >= 0) &&
+         c->getJobs().size() > 1) {
+        diags->Report(
+          clang::diag::err_drv_output_argument_with_multiple_files);
+        return 1;
+      }
+
+      // Collect the compiler command for each job.
+      bool tResult = true;
+      for(clang::driver::Job const& job : c->getJobs()) {
+        clang::driver::Command const* cmd =
+          llvm::dyn_cast<clang::driver::Command>(&job);
+        if(cmd && strcmp(cmd->getCreator().getName(), "clang") == 0) {
+          tJobs.push_back(
+            std::vector<std::string>(cmd->getArguments().begin(),
+                                     cmd->getArguments().end()));
+        } else {
+          // Skip this unexpected job.
+          llvm::SmallString<128> buf;
+          llvm::raw_svector_ostream msg(buf);
+          job.Print(msg, "\n", true);
+          diags->Report(clang::diag::err_fe_expected_clang_command);
+          diags->Report(clang::diag::err_fe_expected_compiler_job)
+            << msg.str();
+          tResult = false;
+        }
+      }
+
+      // Cache the commands only if the driver had nothing to say, since
+      // a hit will not repeat its diagnostics.
+      if(tResult && !diags->hasErrorOccurred() && !diags->getNumWarnings()) {
+        cc1CacheStore(opts.CC1Cache, cc1Key, tJobs);
+      }
+      result = tResult && result;
+    }
+    jobs.insert(jobs.end(), tJobs.begin(), tJobs.end());
+    jobTargets.resize(jobs.size(), target);
+    jobOpts.resize(jobs.size(), &targetOpts[t]);
   }
 
-  // Reject '-o' with multiple inputs.
-  if(!opts.OutputFile.empty() && c->getJobs().size() > 1) {
-    diags->Report(clang::diag::err_drv_output_argument_with_multiple_files);
-    return 1;
+  // Load the listings of include directories taken by earlier runs.
+  std::unique_ptr<HeaderIndex> index;
+  if(!opts.HeaderIndex.empty()) {
+    index.reset(new HeaderIndex(opts.HeaderIndex));
   }
 
-  // Run Clang for each compilation computed by the driver.
-  // This should be once per input source file.
-  bool result = true;
-  for(clang::driver::Job const& job : c->getJobs()) {
-    clang::driver::Command const* cmd =
-      llvm::dyn_cast<clang::driver::Command>(&job);
-    if(cmd && strcmp(cmd->getCreator().getName(), "clang") == 0) {
-      // Invoke Clang with this set of arguments.
-      std::unique_ptr<clang::CompilerInstance>
-        CI(new clang::CompilerInstance());
-      const char* const* cmdArgBeg = cmd->getArguments().data();
-      const char* const* cmdArgEnd = cmdArgBeg + cmd->getArguments().size();
-      if (clang::CompilerInvocation::CreateFromArgs
-          (CI->getInvocation(), cmdArgBeg, cmdArgEnd, *diags)) {
-        result = runClangCI(CI.get(), opts) && result;
-      } else {
-        result = false;
+  // Stack the archives given over the real file system.
+  llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem> vfs;
+  if(!opts.VFSArchives.empty()) {
+    vfs = clang::vfs::getRealFileSystem();
+    for(std::string const& a : opts.VFSArchives) {
+      vfs = vfsArchiveOpen(a, vfs);
+      if(!vfs) {
+        std::cerr << "error: could not read archive '" << a << "'\n";
+        return 1;
       }
+    }
+  }
+
+  // Keep running and regenerate the outputs on change if requested.
+  if(opts.Watch) {
+    return result &&
+      runClangWatch(jobs, jobTargets, jobOpts, *diags, opts,
+                    index.get())? 0:1;
+  }
+
+  // Collect nodes shared by the outputs of all source files.
+  std::unique_ptr<OutputBase> base;
+  if(!opts.GccXmlBase.empty()) {
+    base.reset(new OutputBase);
+  }
+
+  // Load the cost of each source measured by earlier runs.
+  std::unique_ptr<JobHistory> history;
+  if(!opts.JobHistory.empty()) {
+    history.reset(new JobHistory);
+    history->Load(opts.JobHistory);
+  }
+
+  // Create a compiler instance for each compilation computed by the
+  // driver.  This should be once per input source file and target.
+  // The instances for several targets share one file manager, which
+  // helps only when they run in this process, not in forked children.
+  std::vector<std::unique_ptr<clang::CompilerInstance> > instances;
+  std::vector<Options const*> instanceOpts;
+  llvm::IntrusiveRefCntPtr<clang::FileManager> files;
+  for(size_t j = 0; j < jobs.size(); ++j) {
+    std::unique_ptr<clang::CompilerInstance> CI =
+      createCI(jobs[j], *diags, index.get(), vfs, files.get());
+    if(CI) {
+      if(!jobTargets[j].empty()) {
+        CI->getFrontendOpts().OutputFile =
+          targetOutputFile(opts, jobTargets[j], CI.get());
+        if(!files && CI->getHeaderSearchOpts().VFSOverlayFiles.empty()) {
+          if(!CI->hasFileManager()) {
+            CI->createFileManager();
+          }
+          files = &CI->getFileManager();
+        }
+      }
+      instances.push_back(std::move(CI));
+      instanceOpts.push_back(jobOpts[j]);
     } else {
-      // Skip this unexpected job.
-      llvm::SmallString<128> buf;
-      llvm::raw_svector_ostream msg(buf);
-      job.Print(msg, "\n", true);
-      diags->Report(clang::diag::err_fe_expected_clang_command);
-      diags->Report(clang::diag::err_fe_expected_compiler_job)
-        << msg.str();
       result = false;
     }
   }
-  return result? 0:1;
-}
 
-//----------------------------------------------------------------------------
-int runClang(const char* const* argBeg,
-             const char* const* argEnd,
-             Options const& opts)
-{
-  llvm::SmallVector<const char*, 32> args(argBeg, argEnd);
-  std::string fmsc_version = "-fmsc-version=";
+#if !defined(_WIN32)
+  // Run each compiler instance in a child process if requested.
+  // Several targets producing output files run in parallel by default.
+  std::unique_ptr<ForkPool> pool;
+  unsigned int fork = opts.Fork;
+  if(!fork && opts.Targets.size() > 1 && (opts.GccXml || opts.Layout)) {
+    fork = static_cast<unsigned int>(opts.Targets.size());
+  }
+  if(fork) {
+    pool.reset(new ForkPool(fork, opts.MaxMemoryKB,
+                             history.get(), index.get()));
 
-  if(opts.HaveCC) {
-    // Configure target to match that of given compiler.
-    if(!opts.HaveTarget && !opts.Triple.empty()) {
-      args.push_back("-target");
-      args.push_back(opts.Triple.c_str());
+    // Start the most expensive sources first so that the batch is not
+    // held up by a large source started last.
+    if(history && instances.size() > 1) {
+      std::vector<std::pair<double, size_t> > order;
+      for(size_t i = 0; i < instances.size(); ++i) {
+        order.push_back(std::make_pair(
+          -history->Estimate(inputName(instances[i].get())), i));
+      }
+      std::sort(order.begin(), order.end());
+      std::vector<std::unique_ptr<clang::CompilerInstance> > sorted;
+      std::vector<Options const*> sortedOpts;
+      for(size_t i = 0; i < order.size(); ++i) {
+        sorted.push_back(std::move(instances[order[i].second]));
+        sortedOpts.push_back(instanceOpts[order[i].second]);
+      }
+      instances.swap(sorted);
+      instanceOpts.swap(sortedOpts);
     }
+  }
+#endif
 
-    // Tell Clang driver not to add its header search paths.
-    args.push_back("-nobuiltininc");
-    args.push_back("-nostdlibinc");
+  // Invoke Clang with each compiler instance.
+  for(size_t i = 0; i < instances.size(); ++i) {
+    std::unique_ptr<clang::CompilerInstance>& CI = instances[i];
+#if !defined(_WIN32)
+    if(pool) {
+      pool->Run(CI.get(), *instanceOpts[i]);
+      CI.reset();
+      continue;
+    }
+#endif
+    // Free the state of each source before the next one.  Leave that
+    // of the last to be reclaimed at exit, as '-disable-free' does.
+    bool const last = i + 1 == instances.size();
+    CI->getFrontendOpts().DisableFree = last && !opts.FreeAtExit;
 
-    // Add header search paths detected from given compiler.
-    for(std::vector<Options::Include>::const_iterator
-          i = opts.Includes.begin(), e = opts.Includes.end();
-        i != e; ++i) {
-      if(i->Framework) {
-        args.push_back("-iframework");
-      } else {
-        args.push_back("-isystem");
-      }
-      args.push_back(i->Directory.c_str());
+    double start = wallSeconds();
+    bool ok = runClangCI(CI.get(), *instanceOpts[i], base.get());
+    if(ok && history) {
+      // The peak of this process so far bounds that of this source.
+      history->Record(inputName(CI.get()), wallSeconds() - start,
+                      peakRSSKB());
+    }
+    result = ok && result;
+    if(CI->getFrontendOpts().DisableFree) {
+      clang::BuryPointer(std::move(CI));
+    } else {
+      CI.reset();
     }
+  }
+#if !defined(_WIN32)
+  if(pool) {
+    result = pool->Finish() && result;
+  }
+#endif
 
-    // Tell Clang not to add its predefines.
-    args.push_back("-undef");
+  // Save the measurements for later runs.
+  if(history && !history->Save(opts.JobHistory)) {
+    std::cerr << "warning: could not write '" << opts.JobHistory << "'\n";
+  }
+  if(index && !index->Save()) {
+    std::cerr << "warning: could not write '" << opts.HeaderIndex << "'\n";
+  }
 
-    // Configure language options to match given compiler.
-    const char* pd = opts.Predefines.c_str();
-    if(strstr(pd, "#define _MSC_EXTENSIONS ")) {
-      args.push_back("-fms-extensions");
+  // Write the nodes shared by all outputs.
+  if(base && result) {
+    std::error_code ec;
+    llvm::raw_fd_ostream os(opts.GccXmlBase, ec, llvm::sys::fs::F_Text);
+    if(ec) {
+      std::cerr << "error: could not write '" << opts.GccXmlBase
+                << "': " << ec.message() << "\n";
+      return 1;
     }
-    if(const char* d = strstr(pd, "#define _MSC_VER ")) {
-      args.push_back("-fms-compatibility");
-      // Extract the _MSC_VER value to give to -fmsc-version=.
-      d += 17;
-      if(const char* e = strchr(d, '\n')) {
-        if(*(e - 1) == '\r') {
-          --e;
-        }
-        fmsc_version.append(d, e-d);
-        args.push_back(fmsc_version.c_str());
-      }
+    std::string error;
+    if(!outputXMLBase(*base, os, opts, error)) {
+      std::cerr << "error: cannot write '" << opts.GccXmlBase
+                << "' as JSON: " << error << "\n";
+      return 1;
     }
   }
 
+  return result? 0:1;
+}
+
+//----------------------------------------------------------------------------
+int runClang(const char* const* argBeg,
+             const char* const* argEnd,
+             Options const& opts)
+{
+  llvm::SmallVector<const char*, 32> args(argBeg, argEnd);
+  std::string fmsc_version;
+
+  // Each of several targets gets the settings detected for it later.
+  if(opts.HaveCC && opts.Targets.empty()) {
+    addCCArgs(opts, args, fmsc_version);
+  }
+
   return runClangImpl(args.data(), args.data() + args.size(), opts);
 }
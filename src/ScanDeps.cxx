@@ -0,0 +1,232 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "ScanDeps.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/MD5.h"
+
+//----------------------------------------------------------------------------
+namespace {
+
+bool isIdentChar(char c)
+{
+  return ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+          (c >= '0' && c <= '9') || c == '_' || c == '$');
+}
+
+bool isHorizontalSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\f' || c == '\v' || c == '\r';
+}
+
+/// Identifier or number immediately preceding a position.
+llvm::StringRef identBefore(const char* begin, const char* p)
+{
+  const char* b = p;
+  while (b != begin && isIdentChar(b[-1])) {
+    --b;
+  }
+  return llvm::StringRef(b, p - b);
+}
+
+/// Whether a prefix makes the following quote start a character or
+/// string literal rather than, for a single quote, a digit separator.
+bool isLiteralPrefix(llvm::StringRef prefix)
+{
+  return (prefix.empty() || prefix == "L" || prefix == "u" ||
+          prefix == "U" || prefix == "u8");
+}
+
+/// Length of a line continuation at a position, or 0 if none.
+size_t continuation(const char* p, const char* end)
+{
+  if (p != end && *p == '\\') {
+    if (p + 1 != end && p[1] == '\n') {
+      return 2;
+    }
+    if (p + 2 < end && p[1] == '\r' && p[2] == '\n') {
+      return 3;
+    }
+  }
+  return 0;
+}
+
+/// Skip a string or character literal.  Stops before the end of the
+/// line if it is not terminated.
+const char* skipQuoted(const char* p, const char* end)
+{
+  char q = *p++;
+  while (p != end && *p != q && *p != '\n') {
+    if (*p == '\\' && p + 1 != end) {
+      ++p;
+    }
+    ++p;
+  }
+  return p != end && *p == q? p + 1 : p;
+}
+
+/// Skip a raw string literal starting at its opening quote.
+const char* skipRawString(const char* p, const char* end)
+{
+  const char* d = p + 1;
+  const char* open = d;
+  while (open != end && open - d <= 16 && *open != '(' &&
+         *open != ' ' && *open != ')' && *open != '\\' && *open != '\n') {
+    ++open;
+  }
+  if (open == end || *open != '(') {
+    return skipQuoted(p, end);
+  }
+  std::string close = ")" + std::string(d, open) + "\"";
+  llvm::StringRef rest(open + 1, end - open - 1);
+  size_t pos = rest.find(close);
+  return pos == llvm::StringRef::npos? end : open + 1 + pos + close.size();
+}
+
+/// Skip a block comment starting at its opening "/*".
+const char* skipBlockComment(const char* p, const char* end)
+{
+  for (p += 2; p + 1 < end; ++p) {
+    if (p[0] == '*' && p[1] == '/') {
+      return p + 2;
+    }
+  }
+  return end;
+}
+
+/// Skip a line comment, including continued lines, up to its newline.
+const char* skipLineComment(const char* p, const char* end)
+{
+  while (p != end && *p != '\n') {
+    if (size_t n = continuation(p, end)) {
+      p += n;
+    } else {
+      ++p;
+    }
+  }
+  return p;
+}
+
+/// Copy a directive starting at its '#' without comments, joining
+/// continued lines.  Returns the position of its newline.
+const char* copyDirective(const char* begin, const char* p,
+                          const char* end, std::string& out)
+{
+  // Find the directive name to know if '<' starts a header name.
+  const char* n = p + 1;
+  while (n != end && isHorizontalSpace(*n)) {
+    ++n;
+  }
+  const char* ne = n;
+  while (ne != end && isIdentChar(*ne)) {
+    ++ne;
+  }
+  llvm::StringRef name(n, ne - n);
+  bool header = (name == "include" || name == "include_next" ||
+                 name == "import");
+
+  while (p != end && *p != '\n') {
+    char c = *p;
+    if (size_t k = continuation(p, end)) {
+      p += k;
+    } else if (c == '/' && p + 1 != end && p[1] == '/') {
+      p = skipLineComment(p, end);
+    } else if (c == '/' && p + 1 != end && p[1] == '*') {
+      p = skipBlockComment(p, end);
+      out += ' ';
+    } else if (c == '"' ||
+               (c == '\'' && isLiteralPrefix(identBefore(begin, p)))) {
+      const char* q = skipQuoted(p, end);
+      out.append(p, q);
+      p = q;
+    } else if (c == '<' && header) {
+      const char* q = p;
+      while (q != end && *q != '>' && *q != '\n') {
+        ++q;
+      }
+      if (q != end && *q == '>') {
+        ++q;
+      }
+      out.append(p, q);
+      p = q;
+      header = false;
+    } else {
+      out += c;
+      ++p;
+    }
+  }
+  out += '\n';
+  return p;
+}
+
+}
+
+//----------------------------------------------------------------------------
+std::string minimizeSource(llvm::StringRef text)
+{
+  std::string out;
+  const char* const begin = text.data();
+  const char* const end = begin + text.size();
+  bool atLineStart = true;
+  for (const char* p = begin; p != end;) {
+    char c = *p;
+    if (c == '\n') {
+      atLineStart = true;
+      ++p;
+    } else if (isHorizontalSpace(c)) {
+      ++p;
+    } else if (size_t k = continuation(p, end)) {
+      p += k;
+    } else if (c == '#' && atLineStart) {
+      p = copyDirective(begin, p, end, out);
+    } else if (c == '/' && p + 1 != end && p[1] == '/') {
+      p = skipLineComment(p, end);
+    } else if (c == '/' && p + 1 != end && p[1] == '*') {
+      // As in Clang's lexer a block comment, even one containing a
+      // newline, does not change whether a '#' starts a directive.
+      p = skipBlockComment(p, end);
+    } else if (c == '"') {
+      llvm::StringRef prefix = identBefore(begin, p);
+      if (prefix.endswith("R") &&
+          isLiteralPrefix(prefix.drop_back())) {
+        p = skipRawString(p, end);
+      } else {
+        p = skipQuoted(p, end);
+      }
+      atLineStart = false;
+    } else if (c == '\'' && isLiteralPrefix(identBefore(begin, p))) {
+      p = skipQuoted(p, end);
+      atLineStart = false;
+    } else {
+      atLineStart = false;
+      ++p;
+    }
+  }
+  return out;
+}
+
+//----------------------------------------------------------------------------
+std::string scanDepsHash(llvm::StringRef text)
+{
+  llvm::MD5 md5;
+  md5.update(text);
+  llvm::MD5::MD5Result result;
+  md5.final(result);
+  llvm::SmallString<32> hex;
+  llvm::MD5::stringifyResult(result, hex);
+  return std::string(hex.str());
+}
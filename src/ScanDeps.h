@@ -0,0 +1,34 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+#ifndef CASTXML_SCANDEPS_H
+#define CASTXML_SCANDEPS_H
+
+#include <cxsys/Configure.hxx>
+
+#include "llvm/ADT/StringRef.h"
+
+#include <string>
+
+/// minimizeSource - Reduce a source file to its preprocessor directives,
+/// one per line, with comments removed and continued lines joined.
+/// Everything else is dropped, so only the preprocessor need run on it.
+std::string minimizeSource(llvm::StringRef text);
+
+/// scanDepsHash - Compute the hex digest of a file's content reported
+/// by '--castxml-scan-deps'.
+std::string scanDepsHash(llvm::StringRef text);
+
+#endif // CASTXML_SCANDEPS_H
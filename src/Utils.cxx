@@ -110,64 +110,86 @@ bool runCommand(int argc, const char* const* argv,
                 int& ret, std::string& out, std::string& err,
                 std::string& msg)
 {
-  std::vector<const char*> cmd(argv, argv + argc);
-  cmd.push_back(0);
-  ret = 1;
-  out = "";
-  err = "";
-  std::vector<char> outBuf;
-  std::vector<char> errBuf;
-
-  cxsysProcess* cp = cxsysProcess_New();
-  cxsysProcess_SetCommand(cp, &*cmd.begin());
-  cxsysProcess_SetOption(cp, cxsysProcess_Option_HideWindow, 1);
+  std::vector<std::vector<const char*> > cmds(1);
+  cmds[0].assign(argv, argv + argc);
+  cmds[0].push_back(0);
+  std::vector<CommandResult> results;
+  runCommands(cmds, results);
+  ret = results[0].Ret;
+  out = results[0].Out;
+  err = results[0].Err;
+  msg = results[0].Msg;
+  return results[0].Ok;
+}
+
+//----------------------------------------------------------------------------
+void runCommands(std::vector<std::vector<const char*> > const& cmds,
+                 std::vector<CommandResult>& results)
+{
+  results.assign(cmds.size(), CommandResult());
+  std::vector<std::vector<char> > outBufs(cmds.size());
+  std::vector<std::vector<char> > errBufs(cmds.size());
+
+  // Start all the commands and read their pipes in one loop.
+  cxsysProcessGroup* pg = cxsysProcessGroup_New();
+  std::vector<cxsysProcess*> cps;
+  for(std::vector<const char*> const& cmd : cmds) {
+    cxsysProcess* cp = cxsysProcess_New();
+    cxsysProcess_SetCommand(cp, &*cmd.begin());
+    cxsysProcess_SetOption(cp, cxsysProcess_Option_HideWindow, 1);
 #ifdef _WIN32
-  cxsysProcess_SetPipeFile(cp, cxsysProcess_Pipe_STDIN, "//./nul");
+    cxsysProcess_SetPipeFile(cp, cxsysProcess_Pipe_STDIN, "//./nul");
 #else
-  cxsysProcess_SetPipeFile(cp, cxsysProcess_Pipe_STDIN, "/dev/null");
+    cxsysProcess_SetPipeFile(cp, cxsysProcess_Pipe_STDIN, "/dev/null");
 #endif
-  cxsysProcess_Execute(cp);
+    cxsysProcessGroup_AddProcess(pg, cp);
+    cps.push_back(cp);
+  }
+  cxsysProcessGroup_Execute(pg);
 
+  int index;
   char* data;
   int length;
   int pipe;
-  while((pipe = cxsysProcess_WaitForData(cp, &data, &length, 0)) > 0) {
+  while((pipe = cxsysProcessGroup_WaitForData(pg, &index, &data, &length,
+                                              0)) > 0) {
     if(pipe == cxsysProcess_Pipe_STDOUT) {
-      outBuf.insert(outBuf.end(), data, data+length);
+      outBufs[index].insert(outBufs[index].end(), data, data+length);
     } else if(pipe == cxsysProcess_Pipe_STDERR) {
-      errBuf.insert(errBuf.end(), data, data+length);
+      errBufs[index].insert(errBufs[index].end(), data, data+length);
     }
   }
+  cxsysProcessGroup_WaitForExit(pg, 0);
+  cxsysProcessGroup_Delete(pg);
+
+  for(size_t i = 0; i < cps.size(); ++i) {
+    cxsysProcess* cp = cps[i];
+    CommandResult& r = results[i];
+    if(!outBufs[i].empty()) {
+      r.Out.append(&*outBufs[i].begin(), outBufs[i].size());
+    }
+    if(!errBufs[i].empty()) {
+      r.Err.append(&*errBufs[i].begin(), errBufs[i].size());
+    }
 
-  cxsysProcess_WaitForExit(cp, 0);
-  if(!outBuf.empty()) {
-    out.append(&*outBuf.begin(), outBuf.size());
-  }
-  if(!errBuf.empty()) {
-    err.append(&*errBuf.begin(), errBuf.size());
-  }
+    switch(cxsysProcess_GetState(cp)) {
+    case cxsysProcess_State_Exited:
+      r.Ret = cxsysProcess_GetExitValue(cp);
+      r.Ok = true;
+      break;
+    case cxsysProcess_State_Exception:
+      r.Msg = cxsysProcess_GetExceptionString(cp);
+      break;
+    case cxsysProcess_State_Error:
+      r.Msg = cxsysProcess_GetErrorString(cp);
+      break;
+    default:
+      r.Msg = "Process terminated in unexpected state.\n";
+      break;
+    }
 
-  bool result = true;
-  switch(cxsysProcess_GetState(cp)) {
-  case cxsysProcess_State_Exited:
-    ret = cxsysProcess_GetExitValue(cp);
-    break;
-  case cxsysProcess_State_Exception:
-    msg = cxsysProcess_GetExceptionString(cp);
-    result = false;
-    break;
-  case cxsysProcess_State_Error:
-    msg = cxsysProcess_GetErrorString(cp);
-    result = false;
-    break;
-  default:
-    msg = "Process terminated in unexpected state.\n";
-    result = false;
-    break;
+    cxsysProcess_Delete(cp);
   }
-
-  cxsysProcess_Delete(cp);
-  return result;
 }
 
 //----------------------------------------------------------------------------
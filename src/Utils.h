@@ -18,6 +18,7 @@
 
 #include <cxsys/Configure.hxx>
 #include <string>
+#include <vector>
 
 /// findResources - Call from main() to find resources
 /// relative to the executable.  On success returns true.
@@ -38,6 +39,24 @@ bool runCommand(int argc, const char* const* argv,
                 int& ret, std::string& out, std::string& err,
                 std::string& msg);
 
+/// CommandResult - Exit value and captured output of one command run
+/// by runCommands.  Ok is false if the command did not exit normally,
+/// and Msg then says why.
+struct CommandResult
+{
+  CommandResult(): Ok(false), Ret(1) {}
+  bool Ok;
+  int Ret;
+  std::string Out;
+  std::string Err;
+  std::string Msg;
+};
+
+/// runCommands - Run the given command lines concurrently and capture
+/// the output of each.  Each command line is terminated by a null.
+void runCommands(std::vector<std::vector<const char*> > const& cmds,
+                 std::vector<CommandResult>& results);
+
 /// suppressInteractiveErrors - Disable Windows error dialog popups
 void suppressInteractiveErrors();
 
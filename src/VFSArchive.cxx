@@ -0,0 +1,428 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "VFSArchive.h"
+
+#include <cxsys/SystemTools.hxx>
+
+#include "clang/Basic/VirtualFileSystem.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+
+//----------------------------------------------------------------------------
+namespace {
+
+/// First line of an archive.  Change it when the format changes.
+const char VFSArchiveSignature[] = "castxml-vfs-archive 1\n";
+
+//----------------------------------------------------------------------------
+/// Whether a path names a directory or something below it.
+bool isWithin(std::string const& path, std::string const& dir)
+{
+  return (path.compare(0, dir.size(), dir) == 0 &&
+          (path.size() == dir.size() || path[dir.size()] == '/' ||
+           (!dir.empty() && dir[dir.size() - 1] == '/')));
+}
+
+//----------------------------------------------------------------------------
+bool readLine(const char*& p, const char* end, llvm::StringRef& line)
+{
+  const char* e = std::find(p, end, '\n');
+  if (e == end) {
+    return false;
+  }
+  line = llvm::StringRef(p, e - p);
+  p = e + 1;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool readCount(const char*& p, const char* end, size_t& n)
+{
+  llvm::StringRef line;
+  return readLine(p, end, line) && !line.getAsInteger(10, n);
+}
+
+//----------------------------------------------------------------------------
+/// A packed file.  Its contents stay in the mapped archive.
+class ArchiveFile: public clang::vfs::File
+{
+  clang::vfs::Status S;
+  llvm::StringRef Data;
+public:
+  ArchiveFile(clang::vfs::Status const& s, llvm::StringRef data):
+    S(s), Data(data) {}
+
+  llvm::ErrorOr<clang::vfs::Status> status() override {
+    return this->S;
+  }
+
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer> >
+  getBuffer(llvm::Twine const& name, int64_t, bool requiresNullTerminator,
+            bool) override {
+    // Every packed file is followed by a null byte.
+    return llvm::MemoryBuffer::getMemBuffer(this->Data, name.str(),
+                                            requiresNullTerminator);
+  }
+
+  std::error_code close() override {
+    return std::error_code();
+  }
+
+  void setName(llvm::StringRef name) override {
+    this->S.setName(name);
+  }
+};
+
+//----------------------------------------------------------------------------
+class ArchiveDirIter: public clang::vfs::detail::DirIterImpl
+{
+  std::vector<clang::vfs::Status> Entries;
+  size_t Next;
+public:
+  ArchiveDirIter(std::vector<clang::vfs::Status> const& entries):
+    Entries(entries), Next(0) {
+    this->increment();
+  }
+
+  std::error_code increment() override {
+    if (this->Next < this->Entries.size()) {
+      this->CurrentEntry = this->Entries[this->Next++];
+    } else {
+      this->CurrentEntry = clang::vfs::Status();
+    }
+    return std::error_code();
+  }
+};
+
+//----------------------------------------------------------------------------
+/// Serve the packed directories from the archive and pass other paths
+/// to a base file system.  A path below a packed directory that is not
+/// in the archive does not exist, so it is never looked up on disk.
+class ArchiveFileSystem: public clang::vfs::FileSystem
+{
+  struct Entry {
+    Entry(): IsDir(false) {}
+    bool IsDir;
+    llvm::StringRef Data;
+    llvm::sys::fs::UniqueID ID;
+  };
+  typedef std::map<std::string, Entry> EntryMap;
+
+  std::unique_ptr<llvm::MemoryBuffer> Buffer;
+  llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem> Base;
+  llvm::sys::TimeValue MTime;
+  std::string CWD;
+  std::vector<std::string> Roots;
+  EntryMap Entries;
+
+  Entry const* Find(llvm::Twine const& path, bool& within,
+                    std::string& full) const {
+    full = cxsys::SystemTools::CollapseFullPath(path.str(), this->CWD);
+    within = false;
+    for (std::string const& r : this->Roots) {
+      if (isWithin(full, r)) {
+        within = true;
+        EntryMap::const_iterator i = this->Entries.find(full);
+        return i != this->Entries.end()? &i->second : 0;
+      }
+    }
+    return 0;
+  }
+
+  clang::vfs::Status MakeStatus(std::string const& name,
+                                Entry const& e) const {
+    using namespace llvm::sys::fs;
+    return clang::vfs::Status(
+      name, name, e.ID, this->MTime, 0, 0, e.Data.size(),
+      e.IsDir? file_type::directory_file : file_type::regular_file,
+      e.IsDir? all_read | all_exe : all_read);
+  }
+
+public:
+  ArchiveFileSystem(std::unique_ptr<llvm::MemoryBuffer> buffer,
+                    llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem> base,
+                    llvm::sys::TimeValue mtime):
+    Buffer(std::move(buffer)), Base(base), MTime(mtime) {
+    llvm::SmallString<256> cwd;
+    if (!llvm::sys::fs::current_path(cwd)) {
+      this->CWD = std::string(cwd.str());
+    }
+  }
+
+  /// Parse the archive.  It holds the signature, the number of packed
+  /// directories and their paths, and the number of entries.  Each
+  /// entry is a line "d <path>" or "f <offset> <size> <path>", and the
+  /// contents of the files follow, each followed by a null byte.
+  bool Parse() {
+    llvm::StringRef data = this->Buffer->getBuffer();
+    if (!data.startswith(VFSArchiveSignature)) {
+      return false;
+    }
+    const char* p = data.data() + sizeof(VFSArchiveSignature) - 1;
+    const char* end = data.data() + data.size();
+    size_t nroots;
+    if (!readCount(p, end, nroots)) {
+      return false;
+    }
+    for (size_t i = 0; i < nroots; ++i) {
+      llvm::StringRef line;
+      if (!readLine(p, end, line)) {
+        return false;
+      }
+      this->Roots.push_back(line.str());
+    }
+    size_t nentries;
+    if (!readCount(p, end, nentries)) {
+      return false;
+    }
+    std::vector<std::pair<Entry*, std::pair<size_t, size_t> > > files;
+    for (size_t i = 0; i < nentries; ++i) {
+      llvm::StringRef line;
+      if (!readLine(p, end, line) || line.size() < 2 || line[1] != ' ') {
+        return false;
+      }
+      char kind = line[0];
+      llvm::StringRef rest = line.substr(2);
+      size_t offset = 0;
+      size_t size = 0;
+      if (kind == 'f') {
+        std::pair<llvm::StringRef, llvm::StringRef> o = rest.split(' ');
+        std::pair<llvm::StringRef, llvm::StringRef> s = o.second.split(' ');
+        if (o.first.getAsInteger(10, offset) ||
+            s.first.getAsInteger(10, size)) {
+          return false;
+        }
+        rest = s.second;
+      } else if (kind != 'd') {
+        return false;
+      }
+      Entry& e = this->Entries[rest.str()];
+      e.IsDir = kind == 'd';
+      e.ID = clang::vfs::getNextVirtualUniqueID();
+      if (!e.IsDir) {
+        files.push_back(std::make_pair(&e, std::make_pair(offset, size)));
+      }
+    }
+
+    // Offsets count from the end of the index.
+    size_t const avail = static_cast<size_t>(end - p);
+    for (auto const& f : files) {
+      size_t const offset = f.second.first;
+      size_t const size = f.second.second;
+      if (offset > avail || avail - offset < size + 1 ||
+          p[offset + size] != '\0') {
+        return false;
+      }
+      f.first->Data = llvm::StringRef(p + offset, size);
+    }
+    return true;
+  }
+
+  llvm::ErrorOr<clang::vfs::Status> status(llvm::Twine const& path) override {
+    bool within;
+    std::string full;
+    Entry const* e = this->Find(path, within, full);
+    if (!within) {
+      return this->Base->status(path);
+    }
+    if (!e) {
+      return std::make_error_code(std::errc::no_such_file_or_directory);
+    }
+    return this->MakeStatus(path.str(), *e);
+  }
+
+  llvm::ErrorOr<std::unique_ptr<clang::vfs::File> >
+  openFileForRead(llvm::Twine const& path) override {
+    bool within;
+    std::string full;
+    Entry const* e = this->Find(path, within, full);
+    if (!within) {
+      return this->Base->openFileForRead(path);
+    }
+    if (!e) {
+      return std::make_error_code(std::errc::no_such_file_or_directory);
+    }
+    if (e->IsDir) {
+      return std::make_error_code(std::errc::is_a_directory);
+    }
+    return std::unique_ptr<clang::vfs::File>(
+      new ArchiveFile(this->MakeStatus(path.str(), *e), e->Data));
+  }
+
+  clang::vfs::directory_iterator dir_begin(llvm::Twine const& dir,
+                                           std::error_code& ec) override {
+    bool within;
+    std::string full;
+    Entry const* e = this->Find(dir, within, full);
+    if (!within) {
+      return this->Base->dir_begin(dir, ec);
+    }
+    if (!e || !e->IsDir) {
+      ec = std::make_error_code(e? std::errc::not_a_directory :
+                                std::errc::no_such_file_or_directory);
+      return clang::vfs::directory_iterator();
+    }
+
+    // Name the entries after the directory as given, as the real file
+    // system does.
+    std::string const prefix =
+      full[full.size() - 1] == '/'? full : full + "/";
+    std::string name = dir.str();
+    if (!name.empty() && name[name.size() - 1] != '/') {
+      name += '/';
+    }
+    std::vector<clang::vfs::Status> entries;
+    for (EntryMap::const_iterator i = this->Entries.lower_bound(prefix);
+         i != this->Entries.end() &&
+           i->first.compare(0, prefix.size(), prefix) == 0; ++i) {
+      llvm::StringRef rest = llvm::StringRef(i->first).substr(prefix.size());
+      if (!rest.empty() && rest.find('/') == llvm::StringRef::npos) {
+        entries.push_back(this->MakeStatus(name + rest.str(), i->second));
+      }
+    }
+    ec = std::error_code();
+    return clang::vfs::directory_iterator(
+      std::make_shared<ArchiveDirIter>(entries));
+  }
+};
+
+}
+
+//----------------------------------------------------------------------------
+bool vfsArchivePack(std::string const& file,
+                    std::vector<std::string> const& dirs)
+{
+  // Collect the entries sorted by path, with the size of each file.
+  std::vector<std::string> roots;
+  std::map<std::string, std::pair<bool, uint64_t> > entries;
+  for (std::string const& dir : dirs) {
+    std::string const root = cxsys::SystemTools::CollapseFullPath(dir);
+    if (!cxsys::SystemTools::FileIsDirectory(root) ||
+        root.find('\n') != std::string::npos) {
+      std::cerr << "error: '" << dir << "' is not a directory\n";
+      return false;
+    }
+    roots.push_back(root);
+    entries[root] = std::make_pair(true, uint64_t(0));
+    std::error_code ec;
+    for (llvm::sys::fs::recursive_directory_iterator i(root, ec), e;
+         i != e && !ec; i.increment(ec)) {
+      // Skip what cannot be named in the index, or broken links.
+      std::string const path =
+        cxsys::SystemTools::CollapseFullPath(i->path());
+      llvm::sys::fs::file_status st;
+      if (path.find('\n') != std::string::npos || i->status(st)) {
+        continue;
+      }
+      if (llvm::sys::fs::is_directory(st)) {
+        entries[path] = std::make_pair(true, uint64_t(0));
+      } else if (llvm::sys::fs::is_regular_file(st)) {
+        entries[path] = std::make_pair(false, st.getSize());
+      }
+    }
+    if (ec) {
+      std::cerr << "error: could not read '" << dir << "': "
+                << ec.message() << "\n";
+      return false;
+    }
+  }
+
+  // Write a temporary file and rename it into place so that running
+  // jobs keep the archive they mapped.
+  llvm::SmallString<256> tmp;
+  int fd;
+  if (llvm::sys::fs::createUniqueFile(file + ".tmp-%%%%%%%%", fd, tmp)) {
+    std::cerr << "error: could not write '" << file << "'\n";
+    return false;
+  }
+  bool ok = true;
+  {
+    llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+    os << VFSArchiveSignature << roots.size() << "\n";
+    for (std::string const& r : roots) {
+      os << r << "\n";
+    }
+    os << entries.size() << "\n";
+    uint64_t offset = 0;
+    for (auto const& e : entries) {
+      if (e.second.first) {
+        os << "d " << e.first << "\n";
+      } else {
+        os << "f " << offset << " " << e.second.second << " "
+           << e.first << "\n";
+        offset += e.second.second + 1;
+      }
+    }
+    for (auto const& e : entries) {
+      if (e.second.first) {
+        continue;
+      }
+      llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer> > buf =
+        llvm::MemoryBuffer::getFile(e.first, -1, false);
+      if (!buf || (*buf)->getBufferSize() != e.second.second) {
+        std::cerr << "error: could not read '" << e.first
+                  << "' or it changed while packing\n";
+        ok = false;
+        break;
+      }
+      os << (*buf)->getBuffer() << '\0';
+    }
+    os.close();
+    if (os.has_error()) {
+      os.clear_error();
+      std::cerr << "error: could not write '" << file << "'\n";
+      ok = false;
+    }
+  }
+  if (!ok || llvm::sys::fs::rename(tmp.str(), file)) {
+    if (ok) {
+      std::cerr << "error: could not write '" << file << "'\n";
+    }
+    llvm::sys::fs::remove(tmp.str());
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem>
+vfsArchiveOpen(std::string const& file,
+               llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem> base)
+{
+  // Large archives are mapped rather than read.
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer> > buf =
+    llvm::MemoryBuffer::getFile(file, -1, false);
+  llvm::sys::fs::file_status st;
+  if (!buf || llvm::sys::fs::status(file, st)) {
+    return llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem>();
+  }
+  llvm::IntrusiveRefCntPtr<ArchiveFileSystem> fs(
+    new ArchiveFileSystem(std::move(*buf), base,
+                          st.getLastModificationTime()));
+  if (!fs->Parse()) {
+    return llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem>();
+  }
+  return fs;
+}
@@ -0,0 +1,40 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+#ifndef CASTXML_VFSARCHIVE_H
+#define CASTXML_VFSARCHIVE_H
+
+#include <cxsys/Configure.hxx>
+
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+
+#include <string>
+#include <vector>
+
+namespace clang { namespace vfs { class FileSystem; } }
+
+/// Pack the directories given, with every file and directory below
+/// them, into one archive file.  Reports errors on std::cerr.
+bool vfsArchivePack(std::string const& file,
+                    std::vector<std::string> const& dirs);
+
+/// Open an archive written by vfsArchivePack as a file system that
+/// serves the packed directories from memory and passes other paths
+/// to the base file system.  Returns null if it cannot be read.
+llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem>
+vfsArchiveOpen(std::string const& file,
+               llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem> base);
+
+#endif // CASTXML_VFSARCHIVE_H
@@ -0,0 +1,209 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "Watch.h"
+
+#include <cxsys/SystemTools.hxx>
+
+#if defined(__linux__)
+# include <errno.h>
+# include <limits.h>
+# include <poll.h>
+# include <sys/inotify.h>
+# include <unistd.h>
+#else
+# include <chrono>
+# include <thread>
+#endif
+
+// Time for which no further change must arrive before a batch of
+// changes, such as an editor writing several files, is reported.
+static const int WatchSettleMilliseconds = 100;
+
+#if defined(__linux__)
+
+// Editors often save by writing a new file and renaming it over the
+// old one, so watch the directory of each file rather than the file.
+static const uint32_t WatchDirMask =
+  IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE |
+  IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+//----------------------------------------------------------------------------
+FileWatcher::FileWatcher(): FD(inotify_init1(IN_CLOEXEC))
+{
+}
+
+//----------------------------------------------------------------------------
+FileWatcher::~FileWatcher()
+{
+  if (this->FD >= 0) {
+    close(this->FD);
+  }
+}
+
+//----------------------------------------------------------------------------
+void FileWatcher::SetFiles(std::set<std::string> const& files)
+{
+  if (this->FD < 0) {
+    return;
+  }
+  for (std::map<int, Dir>::const_iterator i = this->Dirs.begin(),
+         e = this->Dirs.end(); i != e; ++i) {
+    inotify_rm_watch(this->FD, i->first);
+  }
+  this->Dirs.clear();
+
+  for (std::set<std::string>::const_iterator i = files.begin(),
+         e = files.end(); i != e; ++i) {
+    std::string dir = cxsys::SystemTools::GetFilenamePath(*i);
+    int wd = inotify_add_watch(this->FD, dir.c_str(), WatchDirMask);
+    if (wd >= 0) {
+      // A directory watched twice has the same descriptor.
+      Dir& d = this->Dirs[wd];
+      d.Path = dir;
+      d.Names.insert(cxsys::SystemTools::GetFilenameName(*i));
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+bool FileWatcher::ReadEvents(std::set<std::string>& changed)
+{
+  char buf[4096 + sizeof(struct inotify_event) + NAME_MAX + 1]
+    __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t n = read(this->FD, buf, sizeof(buf));
+  if (n < 0) {
+    return errno == EINTR || errno == EAGAIN;
+  }
+  for (char* p = buf; p < buf + n;) {
+    struct inotify_event const* ev =
+      reinterpret_cast<struct inotify_event const*>(p);
+    p += sizeof(struct inotify_event) + ev->len;
+    std::map<int, Dir>::const_iterator d = this->Dirs.find(ev->wd);
+    if (d == this->Dirs.end()) {
+      continue;
+    }
+    if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+      // The whole directory is gone.  Report all of its files.
+      for (std::set<std::string>::const_iterator i = d->second.Names.begin(),
+             e = d->second.Names.end(); i != e; ++i) {
+        changed.insert(d->second.Path + "/" + *i);
+      }
+    } else if (ev->len > 0 && d->second.Names.count(ev->name)) {
+      changed.insert(d->second.Path + "/" + ev->name);
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool FileWatcher::Wait(std::vector<std::string>& changed)
+{
+  // Nothing can change once the directories of all files are gone.
+  if (this->FD < 0 || this->Dirs.empty()) {
+    return false;
+  }
+  std::set<std::string> files;
+  int timeout = -1;
+  for (;;) {
+    struct pollfd pfd;
+    pfd.fd = this->FD;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int r = poll(&pfd, 1, timeout);
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (r == 0) {
+      break;
+    }
+    if (!this->ReadEvents(files)) {
+      return false;
+    }
+    if (!files.empty()) {
+      timeout = WatchSettleMilliseconds;
+    }
+  }
+  changed.assign(files.begin(), files.end());
+  return true;
+}
+
+#else
+
+//----------------------------------------------------------------------------
+FileWatcher::FileWatcher()
+{
+}
+
+//----------------------------------------------------------------------------
+FileWatcher::~FileWatcher()
+{
+}
+
+//----------------------------------------------------------------------------
+FileWatcher::Stamp FileWatcher::GetStamp(std::string const& file)
+{
+  Stamp s;
+  if (cxsys::SystemTools::FileExists(file.c_str(), true)) {
+    s.Time = cxsys::SystemTools::ModifiedTime(file);
+    s.Length = cxsys::SystemTools::FileLength(file);
+  }
+  return s;
+}
+
+//----------------------------------------------------------------------------
+void FileWatcher::SetFiles(std::set<std::string> const& files)
+{
+  this->Stamps.clear();
+  for (std::set<std::string>::const_iterator i = files.begin(),
+         e = files.end(); i != e; ++i) {
+    this->Stamps[*i] = GetStamp(*i);
+  }
+}
+
+//----------------------------------------------------------------------------
+bool FileWatcher::Wait(std::vector<std::string>& changed)
+{
+  if (this->Stamps.empty()) {
+    return false;
+  }
+  std::set<std::string> files;
+  for (;;) {
+    std::this_thread::sleep_for(
+      std::chrono::milliseconds(files.empty()? 500 :
+                                WatchSettleMilliseconds));
+    bool more = false;
+    for (std::map<std::string, Stamp>::iterator i = this->Stamps.begin(),
+           e = this->Stamps.end(); i != e; ++i) {
+      Stamp s = GetStamp(i->first);
+      if (s != i->second) {
+        i->second = s;
+        files.insert(i->first);
+        more = true;
+      }
+    }
+    if (!files.empty() && !more) {
+      break;
+    }
+  }
+  changed.assign(files.begin(), files.end());
+  return true;
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+#ifndef CASTXML_WATCH_H
+#define CASTXML_WATCH_H
+
+#include <cxsys/Configure.hxx>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/// FileWatcher - Wait for changes to a set of files.  Uses inotify on
+/// Linux and polls modification times elsewhere.
+class FileWatcher
+{
+public:
+  FileWatcher();
+  ~FileWatcher();
+
+  /// Replace the set of files watched.  Paths must be absolute.
+  void SetFiles(std::set<std::string> const& files);
+
+  /// Block until at least one watched file is modified, replaced, or
+  /// removed, and then until changes settle.  Returns false on error
+  /// or when none of the files can be watched, such as on Linux when
+  /// their directories have been removed.
+  bool Wait(std::vector<std::string>& changed);
+
+private:
+  FileWatcher(FileWatcher const&);
+  FileWatcher& operator=(FileWatcher const&);
+
+#if defined(__linux__)
+  int FD;
+  /// Names of the watched files in the directory of each watch.
+  struct Dir {
+    std::string Path;
+    std::set<std::string> Names;
+  };
+  std::map<int, Dir> Dirs;
+  bool ReadEvents(std::set<std::string>& changed);
+#else
+  struct Stamp {
+    Stamp(): Time(0), Length(0) {}
+    long int Time;
+    unsigned long Length;
+    bool operator!=(Stamp const& r) const {
+      return this->Time != r.Time || this->Length != r.Length;
+    }
+  };
+  std::map<std::string, Stamp> Stamps;
+  static Stamp GetStamp(std::string const& file);
+#endif
+};
+
+#endif // CASTXML_WATCH_H
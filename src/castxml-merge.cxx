@@ -0,0 +1,993 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "Reader.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//----------------------------------------------------------------------------
+/// Key - Identity of a node independent of the document containing it.
+struct Key
+{
+  Key(): A(0), B(0) {}
+  uint64_t A;
+  uint64_t B;
+  friend bool operator == (Key const& l, Key const& r) {
+    return l.A == r.A && l.B == r.B;
+  }
+  struct Hash {
+    size_t operator()(Key const& k) const {
+      return static_cast<size_t>(k.A ^ (k.B >> 1));
+    }
+  };
+};
+
+//----------------------------------------------------------------------------
+/// KeyBuilder - Accumulate the parts of a node identity into a Key.
+/// Two independent 64-bit hashes make accidental collisions between
+/// distinct nodes negligible even for very large inputs.
+class KeyBuilder
+{
+  uint64_t A;
+  uint64_t B;
+public:
+  KeyBuilder(): A(14695981039346656037ULL), B(0x9e3779b97f4a7c15ULL) {}
+  void Add(const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      unsigned char c = static_cast<unsigned char>(data[i]);
+      this->A = (this->A ^ c) * 1099511628211ULL;
+      this->B = (this->B + c) * 0xff51afd7ed558ccdULL;
+      this->B ^= this->B >> 29;
+    }
+    // Terminate each part so that concatenations cannot collide.
+    this->A = (this->A ^ 0xff) * 1099511628211ULL;
+    this->B = (this->B + 0x1ff) * 0xc4ceb9fe1a85ec53ULL;
+  }
+  void Add(ReaderString s) { this->Add(s.Data, s.Size); }
+  void Add(const char* s) { this->Add(s, strlen(s)); }
+  void Add(Key const& k) {
+    this->Add(reinterpret_cast<const char*>(&k.A), sizeof(k.A));
+    this->Add(reinterpret_cast<const char*>(&k.B), sizeof(k.B));
+  }
+  Key Get() const {
+    Key k;
+    k.A = this->A;
+    k.B = this->B ^ (this->B >> 31);
+    return k;
+  }
+};
+
+//----------------------------------------------------------------------------
+namespace {
+
+/// Attributes whose values name other nodes.  Values may be lists
+/// separated by spaces, each optionally prefixed (e.g. "private:_12").
+const char* const RefAttributes[] = {
+  "type", "returns", "context", "basetype", "members", "bases",
+  "befriending", "throw", 0
+};
+
+/// Elements that represent named declarations.  These are identified
+/// by their name and context.  All other elements are identified by
+/// their structure.
+const char* const DeclTags[] = {
+  "Namespace", "Class", "Struct", "Union", "Typedef", "Enumeration",
+  "Field", "Variable", "Function", "OperatorFunction", "Method",
+  "OperatorMethod", "Constructor", "Destructor", "Converter", 0
+};
+
+/// Declarations that may be overloaded.
+const char* const FunctionTags[] = {
+  "Function", "OperatorFunction", "Method", "OperatorMethod",
+  "Constructor", "Destructor", "Converter", 0
+};
+
+bool isOneOf(ReaderString s, const char* const* list)
+{
+  for (; *list; ++list) {
+    if (s == *list) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool isRefAttribute(ReaderString name)
+{
+  return isOneOf(name, RefAttributes);
+}
+
+/// Split a reference list value into its space-separated items.
+template <typename F>
+void forEachRef(ReaderString value, F f)
+{
+  const char* p = value.Data;
+  const char* end = value.Data + value.Size;
+  while (p != end) {
+    while (p != end && *p == ' ') {
+      ++p;
+    }
+    const char* item = p;
+    while (p != end && *p != ' ') {
+      ++p;
+    }
+    if (p != item) {
+      // Separate an access prefix such as "private:".
+      const char* colon =
+        static_cast<const char*>(memchr(item, ':', p - item));
+      const char* id = colon? colon + 1 : item;
+      f(ReaderString(item, id - item), ReaderString(id, p - id));
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+/// Document - One input file and the identity of each of its nodes.
+struct Document
+{
+  Document(std::string const& fname, unsigned int index):
+    FileName(fname), Index(index), Root(Reader::None) {}
+
+  bool Load(std::string& error);
+
+  /// Identity of a node this document references but does not define.
+  Key GetExternKey(ReaderString id) const;
+
+  std::string FileName;
+  unsigned int Index;
+  Reader R;
+  unsigned int Root;
+
+  /// Name of the base document written by --castxml-gccxml-base to
+  /// which references to undefined nodes refer, if any.
+  std::string Base;
+
+  /// Identity of each element with an id, indexed by element.
+  std::vector<Key> Keys;
+
+private:
+  Key const& GetKey(unsigned int e);
+  Key GetRefKey(ReaderString id);
+  Key ComputeKey(unsigned int e);
+  void AddStructure(KeyBuilder& kb, Reader::Element const& e);
+  std::vector<char> State;
+};
+
+//----------------------------------------------------------------------------
+bool Document::Load(std::string& error)
+{
+  if (!this->R.Open(this->FileName, error)) {
+    return false;
+  }
+  this->Root = 0;
+  if (this->R.GetElement(0).Tag != "GCC_XML") {
+    error = this->FileName + ": not a gccxml-format document";
+    return false;
+  }
+  this->Base = this->R.GetAttribute(this->R.GetElement(0), "base").str();
+  size_t n = this->R.GetElements().size();
+  this->Keys.resize(n);
+  this->State.resize(n, 0);
+  for (unsigned int e = this->R.GetElement(this->Root).FirstChild;
+       e != Reader::None; e = this->R.GetElement(e).NextSibling) {
+    this->GetKey(e);
+  }
+  std::vector<char>().swap(this->State);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+Key const& Document::GetKey(unsigned int e)
+{
+  if (this->State[e] == 0) {
+    this->State[e] = 1;
+    this->Keys[e] = this->ComputeKey(e);
+    this->State[e] = 2;
+  } else if (this->State[e] == 1) {
+    // A node refers to itself through its own identity.  Break the
+    // cycle with an identity that is unique to this document.
+    KeyBuilder kb;
+    kb.Add("cycle");
+    kb.Add(this->FileName.c_str());
+    kb.Add(reinterpret_cast<const char*>(&e), sizeof(e));
+    return this->Keys[e] = kb.Get();
+  }
+  return this->Keys[e];
+}
+
+//----------------------------------------------------------------------------
+Key Document::GetRefKey(ReaderString id)
+{
+  unsigned int e = this->R.FindId(id);
+  if (e != Reader::None) {
+    return this->GetKey(e);
+  }
+  return this->GetExternKey(id);
+}
+
+//----------------------------------------------------------------------------
+Key Document::GetExternKey(ReaderString id) const
+{
+  // The node is not defined by this document, e.g. it is in a base
+  // document.  Identify it by the reference itself within that base,
+  // since every base document numbers its own nodes from _b1.
+  KeyBuilder kb;
+  kb.Add("extern");
+  kb.Add(this->Base.c_str());
+  kb.Add(id);
+  return kb.Get();
+}
+
+//----------------------------------------------------------------------------
+Key Document::ComputeKey(unsigned int i)
+{
+  Reader::Element const& e = this->R.GetElement(i);
+  KeyBuilder kb;
+  kb.Add(e.Tag);
+
+  if (e.Tag == "File") {
+    kb.Add(this->R.GetAttribute(e, "name"));
+    return kb.Get();
+  }
+
+  if (e.Tag == "Unimplemented") {
+    // Nothing identifies these across documents.
+    kb.Add(this->FileName.c_str());
+    kb.Add(this->R.GetAttribute(e, "id"));
+    return kb.Get();
+  }
+
+  if (!isOneOf(e.Tag, DeclTags)) {
+    this->AddStructure(kb, e);
+    return kb.Get();
+  }
+
+  ReaderString name = this->R.GetAttribute(e, "name");
+  kb.Add(name);
+  ReaderString context = this->R.GetAttribute(e, "context");
+  if (!context.empty()) {
+    kb.Add(this->GetRefKey(context));
+  }
+  kb.Add(this->R.GetAttribute(e, "mangled"));
+  if (name.empty()) {
+    // Anonymous declarations are distinguished by their location.
+    ReaderString loc = this->R.GetAttribute(e, "location");
+    const char* colon = static_cast<const char*>(
+      memchr(loc.Data, ':', loc.Size));
+    if (colon) {
+      ReaderString fid(loc.Data, colon - loc.Data);
+      kb.Add(this->GetRefKey(fid));
+      kb.Add(colon, loc.Data + loc.Size - colon);
+    } else {
+      kb.Add(loc);
+    }
+  }
+  if (isOneOf(e.Tag, FunctionTags)) {
+    // Overloads may have no mangled name, e.g. constructors.
+    kb.Add(this->R.GetAttribute(e, "const"));
+    kb.Add(this->R.GetAttribute(e, "static"));
+    for (unsigned int c = e.FirstChild; c != Reader::None;
+         c = this->R.GetElement(c).NextSibling) {
+      Reader::Element const& ce = this->R.GetElement(c);
+      kb.Add(ce.Tag);
+      ReaderString type = this->R.GetAttribute(ce, "type");
+      if (!type.empty()) {
+        kb.Add(this->GetRefKey(type));
+      }
+    }
+  }
+  return kb.Get();
+}
+
+//----------------------------------------------------------------------------
+void Document::AddStructure(KeyBuilder& kb, Reader::Element const& e)
+{
+  for (Reader::Attribute const* a = this->R.AttrBegin(e),
+         *ae = this->R.AttrEnd(e); a != ae; ++a) {
+    if (a->Name == "id" || a->Name == "location" || a->Name == "file" ||
+        a->Name == "line") {
+      continue;
+    }
+    kb.Add(a->Name);
+    if (isRefAttribute(a->Name)) {
+      forEachRef(a->Value, [this, &kb](ReaderString prefix, ReaderString id) {
+          kb.Add(prefix);
+          kb.Add(this->GetRefKey(id));
+        });
+    } else {
+      kb.Add(a->Value);
+    }
+  }
+  for (unsigned int c = e.FirstChild; c != Reader::None;
+       c = this->R.GetElement(c).NextSibling) {
+    Reader::Element const& ce = this->R.GetElement(c);
+    kb.Add(ce.Tag);
+    this->AddStructure(kb, ce);
+  }
+}
+
+//----------------------------------------------------------------------------
+/// Merger - Combine documents into a single node graph with new ids.
+class Merger
+{
+public:
+  Merger(): FileCount(0) {}
+  bool Add(Document const& d, std::string& error);
+  void Write(std::ostream& os) const;
+
+private:
+  /// Reference to another node within an attribute value.
+  struct Ref {
+    std::string Prefix;
+    unsigned int Node;
+    std::string Suffix;
+  };
+
+  struct Attr {
+    std::string Name;
+    std::string Value;
+    bool IsRef;
+    bool IsFile;
+    std::vector<Ref> Refs;
+  };
+
+  struct Child {
+    std::string Tag;
+    std::vector<Attr> Attrs;
+  };
+
+  struct Node {
+    Node(): Defined(false), Score(0) {}
+    bool Defined;
+    int Score;
+    std::string Tag;
+    std::string External;
+    std::vector<Attr> Attrs;
+    std::vector<Child> Children;
+    std::vector<Ref> Members;
+    std::set<unsigned int> MemberSet;
+  };
+
+  struct File {
+    std::string Name;
+  };
+
+  unsigned int GetNode(Key const& k);
+  unsigned int GetFile(Key const& k, ReaderString name);
+  void ConvertAttrs(Document const& d, Reader::Element const& e,
+                    std::vector<Attr>& attrs);
+  void AddMembers(Document const& d, Reader::Element const& e,
+                  unsigned int ni);
+  int GetScore(Reader const& r, Reader::Element const& e) const;
+  void WriteAttrs(std::ostream& os, std::vector<Attr> const& attrs,
+                  Node const* n) const;
+  void WriteRefs(std::ostream& os, std::vector<Ref> const& refs,
+                 bool file) const;
+
+  std::string RootTag;
+  std::vector<std::pair<std::string, std::string> > RootAttrs;
+
+  // The base document all inputs refer to, and the first input that
+  // does, if any.
+  std::string Base;
+  std::string BaseInput;
+
+  std::unordered_map<Key, unsigned int, Key::Hash> NodeIndex;
+  std::vector<Node> Nodes;
+  std::unordered_map<Key, unsigned int, Key::Hash> FileIndex;
+  std::vector<File> Files;
+  unsigned int FileCount;
+
+  // Output ids, computed when writing.
+  mutable std::vector<std::string> NodeIds;
+  mutable std::vector<std::string> FileIds;
+  void AssignIds() const;
+  std::string const& GetNodeId(unsigned int n) const;
+};
+
+//----------------------------------------------------------------------------
+unsigned int Merger::GetNode(Key const& k)
+{
+  std::pair<std::unordered_map<Key, unsigned int, Key::Hash>::iterator,
+            bool> ins =
+    this->NodeIndex.insert(std::make_pair(k, 0u));
+  if (ins.second) {
+    ins.first->second = static_cast<unsigned int>(this->Nodes.size());
+    this->Nodes.push_back(Node());
+  }
+  return ins.first->second;
+}
+
+//----------------------------------------------------------------------------
+unsigned int Merger::GetFile(Key const& k, ReaderString name)
+{
+  std::pair<std::unordered_map<Key, unsigned int, Key::Hash>::iterator,
+            bool> ins =
+    this->FileIndex.insert(std::make_pair(k, 0u));
+  if (ins.second) {
+    ins.first->second = static_cast<unsigned int>(this->Files.size());
+    File f;
+    f.Name = name.str();
+    this->Files.push_back(f);
+  }
+  return ins.first->second;
+}
+
+//----------------------------------------------------------------------------
+int Merger::GetScore(Reader const& r, Reader::Element const& e) const
+{
+  // Prefer complete declarations and those listing their members.
+  int score = 0;
+  if (r.GetAttribute(e, "incomplete").empty()) {
+    score += 2;
+  }
+  if (!r.GetAttribute(e, "members").empty() ||
+      !r.GetAttribute(e, "bases").empty()) {
+    score += 1;
+  }
+  return score;
+}
+
+//----------------------------------------------------------------------------
+void Merger::ConvertAttrs(Document const& d, Reader::Element const& e,
+                          std::vector<Attr>& attrs)
+{
+  Reader const& r = d.R;
+  attrs.clear();
+  for (Reader::Attribute const* a = r.AttrBegin(e), *ae = r.AttrEnd(e);
+       a != ae; ++a) {
+    Attr attr;
+    attr.Name = a->Name.str();
+    attr.IsRef = false;
+    attr.IsFile = false;
+    if (a->Name == "id") {
+      continue;
+    } else if (a->Name == "members") {
+      // Members are merged across documents and written separately.
+      attr.IsRef = true;
+    } else if (isRefAttribute(a->Name)) {
+      attr.IsRef = true;
+      forEachRef(a->Value, [this, &d, &attr](ReaderString prefix,
+                                             ReaderString id) {
+          Ref ref;
+          ref.Prefix = prefix.str();
+          unsigned int i = d.R.FindId(id);
+          ref.Node = this->GetNode(i != Reader::None? d.Keys[i] :
+                                   d.GetExternKey(id));
+          if (i == Reader::None) {
+            this->Nodes[ref.Node].External = id.str();
+          }
+          attr.Refs.push_back(ref);
+        });
+    } else if (a->Name == "file" || a->Name == "location") {
+      ReaderString v = a->Value;
+      const char* colon = static_cast<const char*>(
+        memchr(v.Data, ':', v.Size));
+      ReaderString fid(v.Data, colon? colon - v.Data : v.Size);
+      unsigned int i = r.FindId(fid);
+      if (i != Reader::None) {
+        attr.IsFile = true;
+        Ref ref;
+        ref.Node = this->GetFile(d.Keys[i],
+                                 r.GetAttribute(r.GetElement(i), "name"));
+        if (colon) {
+          ref.Suffix.assign(colon, v.Data + v.Size - colon);
+        }
+        attr.Refs.push_back(ref);
+      } else {
+        attr.Value = v.str();
+      }
+    } else {
+      attr.Value = a->Value.str();
+    }
+    attrs.push_back(attr);
+  }
+}
+
+//----------------------------------------------------------------------------
+void Merger::AddMembers(Document const& d, Reader::Element const& e,
+                        unsigned int ni)
+{
+  ReaderString members = d.R.GetAttribute(e, "members");
+  std::vector<Ref> refs;
+  forEachRef(members, [this, &d, &refs](ReaderString, ReaderString id) {
+      unsigned int i = d.R.FindId(id);
+      if (i == Reader::None) {
+        return;
+      }
+      Ref ref;
+      ref.Node = this->GetNode(d.Keys[i]);
+      refs.push_back(ref);
+    });
+  Node& n = this->Nodes[ni];
+  for (std::vector<Ref>::const_iterator i = refs.begin(), ie = refs.end();
+       i != ie; ++i) {
+    if (n.MemberSet.insert(i->Node).second) {
+      n.Members.push_back(*i);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+bool Merger::Add(Document const& d, std::string& error)
+{
+  // The output can refer to the nodes of only one base document.
+  if (!d.Base.empty()) {
+    if (this->Base.empty()) {
+      this->Base = d.Base;
+      this->BaseInput = d.FileName;
+    } else if (d.Base != this->Base) {
+      error = d.FileName + ": refers to base document \"" + d.Base +
+        "\" but " + this->BaseInput + " refers to \"" + this->Base + "\"";
+      return false;
+    }
+  }
+
+  Reader const& r = d.R;
+  Reader::Element const& root = r.GetElement(d.Root);
+  if (this->RootTag.empty()) {
+    this->RootTag = root.Tag.str();
+    for (Reader::Attribute const* a = r.AttrBegin(root),
+           *ae = r.AttrEnd(root); a != ae; ++a) {
+      if (a->Name != "base") {
+        this->RootAttrs.push_back(std::make_pair(a->Name.str(),
+                                                 a->Value.str()));
+      }
+    }
+  }
+
+  for (unsigned int i = root.FirstChild; i != Reader::None;
+       i = r.GetElement(i).NextSibling) {
+    Reader::Element const& e = r.GetElement(i);
+    if (r.GetAttribute(e, "id").empty()) {
+      continue;
+    }
+    if (e.Tag == "File") {
+      this->GetFile(d.Keys[i], r.GetAttribute(e, "name"));
+      continue;
+    }
+
+    unsigned int ni = this->GetNode(d.Keys[i]);
+    int score = this->GetScore(r, e);
+    if (!this->Nodes[ni].Defined || score > this->Nodes[ni].Score) {
+      // Converting may add nodes, so do not hold a reference.
+      std::vector<Attr> attrs;
+      this->ConvertAttrs(d, e, attrs);
+      std::vector<Child> children;
+      for (unsigned int c = e.FirstChild; c != Reader::None;
+           c = r.GetElement(c).NextSibling) {
+        Child child;
+        child.Tag = r.GetElement(c).Tag.str();
+        this->ConvertAttrs(d, r.GetElement(c), child.Attrs);
+        children.push_back(child);
+      }
+      Node& n = this->Nodes[ni];
+      n.Defined = true;
+      n.Score = score;
+      n.Tag = e.Tag.str();
+      n.Attrs.swap(attrs);
+      n.Children.swap(children);
+    }
+    if (!r.GetAttribute(e, "members").empty()) {
+      this->AddMembers(d, e, ni);
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void Merger::AssignIds() const
+{
+  // Number nodes in order of first appearance.  Following castxml,
+  // a cv-qualified type is named by its unqualified type and suffix.
+  this->NodeIds.assign(this->Nodes.size(), std::string());
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < this->Nodes.size(); ++i) {
+    Node const& n = this->Nodes[i];
+    if (!n.External.empty() && !n.Defined) {
+      this->NodeIds[i] = n.External;
+    } else if (n.Tag != "CvQualifiedType") {
+      std::ostringstream id;
+      id << "_" << ++count;
+      this->NodeIds[i] = id.str();
+    }
+  }
+  for (unsigned int i = 0; i < this->Nodes.size(); ++i) {
+    Node const& n = this->Nodes[i];
+    if (!this->NodeIds[i].empty()) {
+      continue;
+    }
+    std::string id;
+    for (std::vector<Attr>::const_iterator a = n.Attrs.begin();
+         a != n.Attrs.end(); ++a) {
+      if (a->Name == "type" && a->Refs.size() == 1 &&
+          this->Nodes[a->Refs[0].Node].Tag != "CvQualifiedType") {
+        id = this->NodeIds[a->Refs[0].Node];
+      }
+    }
+    if (id.empty()) {
+      std::ostringstream s;
+      s << "_" << ++count;
+      id = s.str();
+    }
+    for (std::vector<Attr>::const_iterator a = n.Attrs.begin();
+         a != n.Attrs.end(); ++a) {
+      if (a->Value == "1") {
+        if (a->Name == "const") {
+          id += "c";
+        } else if (a->Name == "volatile") {
+          id += "v";
+        } else if (a->Name == "restrict") {
+          id += "r";
+        }
+      }
+    }
+    this->NodeIds[i] = id;
+  }
+
+  this->FileIds.assign(this->Files.size(), std::string());
+  unsigned int fcount = 0;
+  for (unsigned int i = 0; i < this->Files.size(); ++i) {
+    if (this->Files[i].Name == "&lt;builtin&gt;") {
+      this->FileIds[i] = "f0";
+    } else {
+      std::ostringstream id;
+      id << "f" << ++fcount;
+      this->FileIds[i] = id.str();
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void Merger::WriteRefs(std::ostream& os, std::vector<Ref> const& refs,
+                       bool file) const
+{
+  const char* sep = "";
+  for (std::vector<Ref>::const_iterator i = refs.begin(), ie = refs.end();
+       i != ie; ++i) {
+    os << sep << i->Prefix
+       << (file? this->FileIds[i->Node] : this->NodeIds[i->Node])
+       << i->Suffix;
+    sep = file? "" : " ";
+  }
+}
+
+//----------------------------------------------------------------------------
+void Merger::WriteAttrs(std::ostream& os, std::vector<Attr> const& attrs,
+                        Node const* n) const
+{
+  bool members = false;
+  for (std::vector<Attr>::const_iterator a = attrs.begin();
+       a != attrs.end(); ++a) {
+    os << " " << a->Name << "=\"";
+    if (n && a->Name == "members") {
+      this->WriteRefs(os, n->Members, false);
+      members = true;
+    } else if (a->IsRef || a->IsFile) {
+      this->WriteRefs(os, a->Refs, a->IsFile);
+    } else {
+      os << a->Value;
+    }
+    os << "\"";
+  }
+  // The kept definition may not list members that other inputs do.
+  if (n && !members && !n->Members.empty()) {
+    os << " members=\"";
+    this->WriteRefs(os, n->Members, false);
+    os << "\"";
+  }
+}
+
+//----------------------------------------------------------------------------
+void Merger::Write(std::ostream& os) const
+{
+  this->AssignIds();
+
+  // Write nodes ordered by id number, cv-qualified types after the
+  // type they qualify.
+  std::vector<std::pair<std::pair<unsigned long, std::string>,
+                        unsigned int> > order;
+  for (unsigned int i = 0; i < this->Nodes.size(); ++i) {
+    if (!this->Nodes[i].Defined) {
+      continue;
+    }
+    std::string const& id = this->NodeIds[i];
+    char* end = 0;
+    unsigned long num = strtoul(id.c_str() + 1, &end, 10);
+    order.push_back(std::make_pair(std::make_pair(num, std::string(end)), i));
+  }
+  std::sort(order.begin(), order.end());
+
+  os << "<?xml version=\"1.0\"?>\n";
+  os << "<" << (this->RootTag.empty()? "GCC_XML" : this->RootTag);
+  for (std::vector<std::pair<std::string, std::string> >::const_iterator
+         a = this->RootAttrs.begin(); a != this->RootAttrs.end(); ++a) {
+    os << " " << a->first << "=\"" << a->second << "\"";
+  }
+  if (!this->Base.empty()) {
+    os << " base=\"" << this->Base << "\"";
+  }
+  os << ">\n";
+  for (std::vector<std::pair<std::pair<unsigned long, std::string>,
+         unsigned int> >::const_iterator i = order.begin();
+       i != order.end(); ++i) {
+    Node const& n = this->Nodes[i->second];
+    os << "  <" << n.Tag << " id=\"" << this->NodeIds[i->second] << "\"";
+    this->WriteAttrs(os, n.Attrs, &n);
+    if (n.Children.empty()) {
+      os << "/>\n";
+      continue;
+    }
+    os << ">\n";
+    for (std::vector<Child>::const_iterator c = n.Children.begin();
+         c != n.Children.end(); ++c) {
+      os << "    <" << c->Tag;
+      this->WriteAttrs(os, c->Attrs, 0);
+      os << "/>\n";
+    }
+    os << "  </" << n.Tag << ">\n";
+  }
+  for (unsigned int i = 0; i < this->Files.size(); ++i) {
+    if (this->FileIds[i] == "f0") {
+      os << "  <File id=\"f0\" name=\"" << this->Files[i].Name << "\"/>\n";
+    }
+  }
+  for (unsigned int i = 0; i < this->Files.size(); ++i) {
+    if (this->FileIds[i] != "f0") {
+      os << "  <File id=\"" << this->FileIds[i]
+         << "\" name=\"" << this->Files[i].Name << "\"/>\n";
+    }
+  }
+  os << "</" << (this->RootTag.empty()? "GCC_XML" : this->RootTag) << ">\n";
+}
+
+//----------------------------------------------------------------------------
+/// Loader - Parse documents on worker threads while the caller merges
+/// them in input order.  Workers stay a bounded distance ahead of the
+/// merge so that memory use does not grow with the number of inputs.
+class Loader
+{
+public:
+  Loader(std::vector<std::string> const& files, unsigned int jobs);
+  ~Loader();
+
+  /// Next - Wait for the next document in input order.  Returns null
+  /// when all documents have been returned.
+  std::unique_ptr<Document> Next(std::string& error);
+
+private:
+  void Work();
+
+  std::vector<std::string> const& Files;
+  std::vector<std::unique_ptr<Document> > Docs;
+  std::vector<std::string> Errors;
+  std::vector<bool> Done;
+  unsigned int NextLoad;
+  unsigned int NextMerge;
+  unsigned int Window;
+  bool Stop;
+  std::mutex Mutex;
+  std::condition_variable Loaded;
+  std::condition_variable Merged;
+  std::vector<std::thread> Threads;
+};
+
+//----------------------------------------------------------------------------
+Loader::Loader(std::vector<std::string> const& files, unsigned int jobs):
+  Files(files), Docs(files.size()), Errors(files.size()),
+  Done(files.size(), false), NextLoad(0), NextMerge(0),
+  Window(2 * jobs), Stop(false)
+{
+  for (unsigned int i = 0; i < jobs; ++i) {
+    this->Threads.push_back(std::thread(&Loader::Work, this));
+  }
+}
+
+//----------------------------------------------------------------------------
+Loader::~Loader()
+{
+  {
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->Stop = true;
+  }
+  this->Merged.notify_all();
+  for (std::vector<std::thread>::iterator i = this->Threads.begin();
+       i != this->Threads.end(); ++i) {
+    i->join();
+  }
+}
+
+//----------------------------------------------------------------------------
+void Loader::Work()
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  for (;;) {
+    while (!this->Stop && this->NextLoad < this->Files.size() &&
+           this->NextLoad >= this->NextMerge + this->Window) {
+      this->Merged.wait(lock);
+    }
+    if (this->Stop || this->NextLoad >= this->Files.size()) {
+      return;
+    }
+    unsigned int i = this->NextLoad++;
+    lock.unlock();
+
+    std::unique_ptr<Document> d(new Document(this->Files[i], i));
+    std::string error;
+    if (!d->Load(error)) {
+      d.reset();
+    }
+
+    lock.lock();
+    this->Docs[i] = std::move(d);
+    this->Errors[i] = error;
+    this->Done[i] = true;
+    this->Loaded.notify_all();
+  }
+}
+
+//----------------------------------------------------------------------------
+std::unique_ptr<Document> Loader::Next(std::string& error)
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  if (this->NextMerge >= this->Files.size()) {
+    return std::unique_ptr<Document>();
+  }
+  unsigned int i = this->NextMerge;
+  while (!this->Done[i]) {
+    this->Loaded.wait(lock);
+  }
+  ++this->NextMerge;
+  this->Merged.notify_all();
+  error = this->Errors[i];
+  return std::move(this->Docs[i]);
+}
+
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, const char* argv[])
+{
+  const char* usage =
+    "Usage: castxml-merge [-j <n>] -o <out.xml> <in.xml>...\n"
+    "\n"
+    "  Merge gccxml-format output files written by castxml for separate\n"
+    "  translation units into a single file.  Declarations and types\n"
+    "  appearing in several inputs are written once.\n"
+    "\n"
+    "  --help, -h\n"
+    "    Print castxml-merge usage information\n"
+    "\n"
+    "  -j <n>\n"
+    "    Parse up to <n> input files concurrently\n"
+    "    (default: number of processors)\n"
+    "\n"
+    "  -o <out.xml>\n"
+    "    Write merged output to <out.xml>\n"
+    ;
+
+  std::string outputFile;
+  std::vector<std::string> inputFiles;
+  unsigned int jobs = std::thread::hardware_concurrency();
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-o") == 0) {
+      if ((i+1) < argc) {
+        outputFile = argv[++i];
+      } else {
+        std::cerr <<
+          "error: argument to '-o' is missing "
+          "(expected 1 value)\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if (strcmp(argv[i], "-j") == 0) {
+      char* end = 0;
+      long n = (i+1) < argc? strtol(argv[i+1], &end, 10) : 0;
+      if (n < 1 || !end || *end) {
+        std::cerr <<
+          "error: argument to '-j' must be a positive integer\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+      jobs = static_cast<unsigned int>(n);
+      ++i;
+    } else if (strcmp(argv[i], "--help") == 0 ||
+               strcmp(argv[i], "-h") == 0) {
+      std::cout << usage;
+      return 0;
+    } else if (argv[i][0] == '-' && argv[i][1]) {
+      std::cerr <<
+        "error: unknown option '" << argv[i] << "'\n"
+        "\n" <<
+        usage
+        ;
+      return 1;
+    } else {
+      inputFiles.push_back(argv[i]);
+    }
+  }
+
+  if (outputFile.empty()) {
+    std::cerr <<
+      "error: '-o' is required\n"
+      "\n" <<
+      usage
+      ;
+    return 1;
+  }
+  if (inputFiles.empty()) {
+    std::cerr <<
+      "error: no input files\n"
+      "\n" <<
+      usage
+      ;
+    return 1;
+  }
+  if (jobs < 1) {
+    jobs = 1;
+  }
+  if (jobs > inputFiles.size()) {
+    jobs = static_cast<unsigned int>(inputFiles.size());
+  }
+
+  Merger merger;
+  {
+  Loader loader(inputFiles, jobs);
+  std::string error;
+  while (std::unique_ptr<Document> d = loader.Next(error)) {
+    if (!merger.Add(*d, error)) {
+      break;
+    }
+  }
+  if (!error.empty()) {
+    std::cerr << "error: " << error << "\n";
+    return 1;
+  }
+  }
+
+  std::ofstream fout(outputFile.c_str(), std::ios::out | std::ios::binary);
+  if (!fout) {
+    std::cerr << "error: could not open \"" << outputFile
+              << "\" for writing\n";
+    return 1;
+  }
+  merger.Write(fout);
+  fout.close();
+  if (!fout) {
+    std::cerr << "error: could not write \"" << outputFile << "\"\n";
+    return 1;
+  }
+  return 0;
+}
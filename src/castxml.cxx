@@ -16,22 +16,33 @@
 
 #include "Detect.h"
 #include "Options.h"
+#include "Probes.h"
 #include "RunClang.h"
 #include "Utils.h"
+#include "VFSArchive.h"
 
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Process.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <set>
 #include <system_error>
 #include <vector>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#if !defined(_WIN32)
+# include <fcntl.h>
+#endif
 
 class StringSaver: public llvm::cl::StringSaver {
   std::set<std::string> Strings;
@@ -44,6 +55,7 @@ public:
 //----------------------------------------------------------------------------
 int main(int argc_in, const char** argv_in)
 {
+  CASTXML_PROBE(main__start);
   suppressInteractiveErrors();
 
   llvm::InitializeAllTargets();
@@ -89,20 +101,130 @@ int main(int argc_in, const char** argv_in)
     "    compiler (e.g. \"gcc\") and <cc-opt>... specifies\n"
     "    options that may affect its target (e.g. \"-m32\").\n"
     "\n"
+    "  --castxml-cc1-cache <dir>\n"
+    "    Store the compiler commands computed by the internal Clang\n"
+    "    driver in <dir> and reuse them when given the same arguments.\n"
+    "\n"
+    "  --castxml-fork <n>\n"
+    "    Run each <src> in a child process forked after startup, at\n"
+    "    most <n> at a time, so a crash affects only one <src>.\n"
+    "\n"
+    "  --castxml-free-at-exit\n"
+    "    Free all memory before exiting, as for a leak checker.  By\n"
+    "    default the state of the last <src> and static data are left\n"
+    "    to be reclaimed by the system, which makes exit faster.\n"
+    "\n"
     "  --castxml-gccxml\n"
     "    Write gccxml-format output to <src>.xml or file named by '-o'\n"
     "\n"
+    "  --castxml-output=<format>\n"
+    "    Write output in the given format to <src>.<ext> or file named\n"
+    "    by '-o'.  The <format> must be one of:\n"
+    "      gccxml  same as '--castxml-gccxml' (<ext> is xml)\n"
+    "      json    gccxml node model as one JSON object per line\n"
+    "              with integer ids (<ext> is json)\n"
+    "\n"
+    "  --castxml-gccxml-base <file>\n"
+    "    Write declarations from included headers once to <file> and\n"
+    "    reference them from the gccxml-format output of each <src>.\n"
+    "\n"
+    "  --castxml-header-index <file>\n"
+    "    Keep listings of the include directories in <file> and use them\n"
+    "    to skip probes for headers that do not exist.  A listing is\n"
+    "    taken again when its directory modification time changes.\n"
+    "\n"
+    "  --castxml-implicit-decl-only\n"
+    "    Declare the implicit members of classes and compute their\n"
+    "    exception specifications without defining them, unless a\n"
+    "    definition may instantiate a template.  The output is the same.\n"
+    "\n"
+    "  --castxml-instantiate <type>\n"
+    "  --castxml-instantiate-file <file>\n"
+    "    Complete the given (template specialization) type, or each\n"
+    "    type listed one per line in <file>, after parsing <src> and\n"
+    "    start AST traversal at its declaration.  May be repeated.\n"
+    "\n"
+    "  --castxml-instantiation-report <n>\n"
+    "    After parsing each <src>, print the <n> templates instantiated\n"
+    "    most often, with the CPU time spent on them after parsing and\n"
+    "    what triggered them.\n"
+    "\n"
+    "  --castxml-job-history <file>\n"
+    "    Record the time and peak memory used by each <src> in <file>\n"
+    "    and, with '--castxml-fork', start the most expensive first.\n"
+    "\n"
+    "  --castxml-layout\n"
+    "    Write the size, alignment, and base and field offsets of\n"
+    "    records reachable from the start declarations to\n"
+    "    <src>.layout.xml or file named by '-o'\n"
+    "\n"
+    "  --castxml-lean\n"
+    "    Release the parser and semantic analysis state of each <src>\n"
+    "    before writing its output, to lower the peak memory used.\n"
+    "\n"
+    "  --castxml-max-instantiations <n>\n"
+    "    Fail with the report of '--castxml-instantiation-report' as\n"
+    "    soon as more than <n> templates are instantiated for a <src>.\n"
+    "\n"
+    "  --castxml-max-memory <size>[K|M|G]\n"
+    "    With '--castxml-fork', start another child only while the\n"
+    "    memory projected for running children stays under <size>\n"
+    "    (in MiB unless a suffix is given).\n"
+    "\n"
+    "  --castxml-memory-report\n"
+    "    Print the peak memory used before and after the output of\n"
+    "    each <src> is generated.\n"
+    "\n"
+    "  --castxml-output-fd <n>\n"
+    "    Write output to the inherited file descriptor <n>, such as a\n"
+    "    pipe, instead of <src>.<ext> or file named by '-o'.\n"
+    "\n"
+    "  --castxml-preamble-cache <dir>\n"
+    "    Keep a precompiled preamble of the leading #include block of\n"
+    "    each <src> in <dir> and reuse it while the block and the files\n"
+    "    it includes are unchanged.\n"
+    "\n"
+    "  --castxml-scan-deps\n"
+    "    Run only the preprocessor, over sources reduced to their\n"
+    "    directives, and write the files each <src> includes with a\n"
+    "    hash of their content to <src>.deps or file named by '-o'.\n"
+    "\n"
     "  --castxml-start <name>[,<name>]...\n"
     "    Start AST traversal at declaration(s) with the given (qualified)\n"
     "    name(s).  Multiple names may be specified as a comma-separated\n"
     "    list or by repeating the option.\n"
     "\n"
+    "  --castxml-targets <triple>[,<triple>]...\n"
+    "    Process each <src> once for each target, in parallel when\n"
+    "    writing output files.  Output is written to\n"
+    "    <src>.<triple>.<ext> or file named by '-o' with '{triple}'\n"
+    "    replaced by the target.  Targets run in parallel do not share\n"
+    "    file system lookups.  With '--castxml-cc-<id>', settings are\n"
+    "    detected for each target from the compiler command with\n"
+    "    '{triple}' replaced by the target.  May be repeated.\n"
+    "\n"
+    "  --castxml-vfs-archive <file>\n"
+    "    Read the directories packed in <file> from memory instead of\n"
+    "    the file system.  May be repeated.\n"
+    "\n"
+    "  --castxml-vfs-pack <file> <dir>...\n"
+    "    Pack the given directories into <file> for use with\n"
+    "    '--castxml-vfs-archive', and exit.\n"
+    "\n"
+    "  --castxml-watch\n"
+    "    Keep running and regenerate the output of each <src> when a\n"
+    "    file it read changes.\n"
+    "\n"
     "  -help, --help\n"
     "    Print castxml and internal Clang compiler usage information\n"
     "\n"
     "  -o <file>\n"
     "    Write output to <file>\n"
     "\n"
+    "  -\n"
+    "    Read a <src> from stdin, as C++ unless '-x' is given, and\n"
+    "    write output to stdout unless '-o' is given.\n"
+    "\n"
     "  --version\n"
     "    Print castxml and internal Clang compiler version information\n"
     "\n"
@@ -112,6 +234,7 @@ int main(int argc_in, const char** argv_in)
   llvm::SmallVector<const char *, 16> clang_args;
   llvm::SmallVector<const char *, 16> cc_args;
   const char* cc_id = 0;
+  const char* output_fd = 0;
 
   for(size_t i=1; i < argc; ++i) {
     if(strcmp(argv[i], "--castxml-gccxml") == 0) {
@@ -125,6 +248,337 @@ int main(int argc_in, const char** argv_in)
           ;
         return 1;
       }
+    } else if(strncmp(argv[i], "--castxml-output=", 17) == 0) {
+      const char* format = argv[i] + 17;
+      if(opts.GccXml) {
+        std::cerr <<
+          "error: '--castxml-output=<format>' may be given at most once "
+          "and not with '--castxml-gccxml'!\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+      if(strcmp(format, "gccxml") == 0) {
+        opts.GccXml = true;
+      } else if(strcmp(format, "json") == 0) {
+        opts.GccXml = true;
+        opts.GccXmlJson = true;
+      } else {
+        std::cerr <<
+          "error: '--castxml-output=' given unknown format '" << format <<
+          "'\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-free-at-exit") == 0) {
+      if(!opts.FreeAtExit) {
+        opts.FreeAtExit = true;
+      } else {
+        std::cerr <<
+          "error: '--castxml-free-at-exit' may be given at most once!\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-implicit-decl-only") == 0) {
+      if(!opts.ImplicitDeclOnly) {
+        opts.ImplicitDeclOnly = true;
+      } else {
+        std::cerr <<
+          "error: '--castxml-implicit-decl-only' may be given at most "
+          "once!\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-gccxml-base") == 0) {
+      if((i+1) < argc) {
+        opts.GccXmlBase = argv[++i];
+      } else {
+        std::cerr <<
+          "error: argument to '--castxml-gccxml-base' is missing "
+          "(expected 1 value)\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-header-index") == 0) {
+      if((i+1) < argc) {
+        opts.HeaderIndex = argv[++i];
+      } else {
+        std::cerr <<
+          "error: argument to '--castxml-header-index' is missing "
+          "(expected 1 value)\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-instantiate") == 0) {
+      if((i+1) < argc) {
+        opts.Instantiate.push_back(argv[++i]);
+      } else {
+        std::cerr <<
+          "error: argument to '--castxml-instantiate' is missing "
+          "(expected 1 value)\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-instantiate-file") == 0) {
+      if((i+1) < argc) {
+        const char* fname = argv[++i];
+        std::ifstream fin(fname);
+        if(!fin) {
+          std::cerr << "error: could not read '" << fname << "'\n";
+          return 1;
+        }
+        std::string line;
+        while(std::getline(fin, line)) {
+          // Skip blank lines and '#' comments.
+          std::string::size_type b = line.find_first_not_of(" \t\r");
+          if(b != std::string::npos && line[b] != '#') {
+            std::string::size_type e = line.find_last_not_of(" \t\r");
+            opts.Instantiate.push_back(line.substr(b, e + 1 - b));
+          }
+        }
+      } else {
+        std::cerr <<
+          "error: argument to '--castxml-instantiate-file' is missing "
+          "(expected 1 value)\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-job-history") == 0) {
+      if((i+1) < argc) {
+        opts.JobHistory = argv[++i];
+      } else {
+        std::cerr <<
+          "error: argument to '--castxml-job-history' is missing "
+          "(expected 1 value)\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-layout") == 0) {
+      if(!opts.Layout) {
+        opts.Layout = true;
+      } else {
+        std::cerr <<
+          "error: '--castxml-layout' may be given at most once!\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-lean") == 0) {
+      if(!opts.Lean) {
+        opts.Lean = true;
+      } else {
+        std::cerr <<
+          "error: '--castxml-lean' may be given at most once!\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-memory-report") == 0) {
+      if(!opts.MemoryReport) {
+        opts.MemoryReport = true;
+      } else {
+        std::cerr <<
+          "error: '--castxml-memory-report' may be given at most once!\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-watch") == 0) {
+      if(!opts.Watch) {
+        opts.Watch = true;
+      } else {
+        std::cerr <<
+          "error: '--castxml-watch' may be given at most once!\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-cc1-cache") == 0) {
+      if((i+1) < argc) {
+        opts.CC1Cache = argv[++i];
+      } else {
+        std::cerr <<
+          "error: argument to '--castxml-cc1-cache' is missing "
+          "(expected 1 value)\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-fork") == 0) {
+      if((i+1) < argc) {
+        const char* n = argv[++i];
+        char* end;
+        unsigned long v = strtoul(n, &end, 10);
+        if(*n < '0' || *n > '9' || *end || v == 0 || v > 1024) {
+          std::cerr <<
+            "error: argument to '--castxml-fork' must be a number of "
+            "processes from 1 to 1024\n"
+            "\n" <<
+            usage
+            ;
+          return 1;
+        }
+        opts.Fork = static_cast<unsigned int>(v);
+      } else {
+        std::cerr <<
+          "error: argument to '--castxml-fork' is missing "
+          "(expected 1 value)\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-instantiation-report") == 0) {
+      if((i+1) < argc) {
+        const char* n = argv[++i];
+        char* end;
+        unsigned long v = strtoul(n, &end, 10);
+        if(*n < '0' || *n > '9' || *end || v == 0 || v > 100000) {
+          std::cerr <<
+            "error: argument to '--castxml-instantiation-report' must be "
+            "a number of templates from 1 to 100000\n"
+            "\n" <<
+            usage
+            ;
+          return 1;
+        }
+        opts.InstantiationReport = static_cast<unsigned int>(v);
+      } else {
+        std::cerr <<
+          "error: argument to '--castxml-instantiation-report' is missing "
+          "(expected 1 value)\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-max-instantiations") == 0) {
+      if((i+1) < argc) {
+        const char* n = argv[++i];
+        char* end;
+        unsigned long long v = strtoull(n, &end, 10);
+        if(*n < '0' || *n > '9' || *end || v == 0) {
+          std::cerr <<
+            "error: argument to '--castxml-max-instantiations' must be a "
+            "positive number\n"
+            "\n" <<
+            usage
+            ;
+          return 1;
+        }
+        opts.MaxInstantiations = v;
+      } else {
+        std::cerr <<
+          "error: argument to '--castxml-max-instantiations' is missing "
+          "(expected 1 value)\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-max-memory") == 0) {
+      if((i+1) < argc) {
+        const char* n = argv[++i];
+        char* end;
+        unsigned long long v = strtoull(n, &end, 10);
+        unsigned long long unit = 1024;
+        if(*end == 'K' || *end == 'k') {
+          unit = 1;
+          ++end;
+        } else if(*end == 'M' || *end == 'm') {
+          ++end;
+        } else if(*end == 'G' || *end == 'g') {
+          unit = 1024 * 1024;
+          ++end;
+        }
+        if(*n < '0' || *n > '9' || *end || v == 0 ||
+           v > (~0ull / unit)) {
+          std::cerr <<
+            "error: argument to '--castxml-max-memory' must be a "
+            "positive size optionally followed by K, M, or G\n"
+            "\n" <<
+            usage
+            ;
+          return 1;
+        }
+        opts.MaxMemoryKB = v * unit;
+      } else {
+        std::cerr <<
+          "error: argument to '--castxml-max-memory' is missing "
+          "(expected 1 value)\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-output-fd") == 0) {
+      if((i+1) < argc) {
+        output_fd = argv[++i];
+        char* end;
+        unsigned long v = strtoul(output_fd, &end, 10);
+        if(*output_fd < '0' || *output_fd > '9' || *end || v > INT_MAX) {
+          std::cerr <<
+            "error: argument to '--castxml-output-fd' must be a file "
+            "descriptor number\n"
+            "\n" <<
+            usage
+            ;
+          return 1;
+        }
+      } else {
+        std::cerr <<
+          "error: argument to '--castxml-output-fd' is missing "
+          "(expected 1 value)\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-preamble-cache") == 0) {
+      if((i+1) < argc) {
+        opts.PreambleCache = argv[++i];
+      } else {
+        std::cerr <<
+          "error: argument to '--castxml-preamble-cache' is missing "
+          "(expected 1 value)\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-scan-deps") == 0) {
+      if(!opts.ScanDeps) {
+        opts.ScanDeps = true;
+      } else {
+        std::cerr <<
+          "error: '--castxml-scan-deps' may be given at most once!\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
     } else if(strcmp(argv[i], "--castxml-start") == 0) {
       if((i+1) < argc) {
         std::string item;
@@ -141,6 +595,48 @@ int main(int argc_in, const char** argv_in)
           ;
         return 1;
       }
+    } else if(strcmp(argv[i], "--castxml-targets") == 0) {
+      if((i+1) < argc) {
+        std::string item;
+        std::stringstream stream(argv[++i]);
+        while (std::getline(stream, item, ',')) {
+          opts.Targets.push_back(item);
+        }
+      } else {
+        std::cerr <<
+          "error: argument to '--castxml-targets' is missing "
+          "(expected 1 value)\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-vfs-archive") == 0) {
+      if((i+1) < argc) {
+        opts.VFSArchives.push_back(argv[++i]);
+      } else {
+        std::cerr <<
+          "error: argument to '--castxml-vfs-archive' is missing "
+          "(expected 1 value)\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
+    } else if(strcmp(argv[i], "--castxml-vfs-pack") == 0) {
+      if((i+2) < argc) {
+        std::string const file = argv[++i];
+        std::vector<std::string> dirs(argv.begin() + i + 1, argv.end());
+        return vfsArchivePack(file, dirs)? 0:1;
+      } else {
+        std::cerr <<
+          "error: arguments to '--castxml-vfs-pack' are missing "
+          "(expected a file and at least 1 directory)\n"
+          "\n" <<
+          usage
+          ;
+        return 1;
+      }
     } else if(strncmp(argv[i], "--castxml-cc-", 13) == 0) {
       if(!cc_id) {
         cc_id = argv[i] + 13;
@@ -245,6 +741,167 @@ int main(int argc_in, const char** argv_in)
     }
   }
 
+  if(opts.Layout && opts.GccXml) {
+    std::cerr <<
+      "error: '--castxml-layout' may not be given with '--castxml-gccxml' "
+      "or '--castxml-output=<format>'\n"
+      "\n" <<
+      usage
+      ;
+    return 1;
+  }
+
+  if(opts.ScanDeps && (opts.PPOnly || opts.GccXml || opts.Layout)) {
+    std::cerr <<
+      "error: '--castxml-scan-deps' may not be given with '-E', "
+      "'--castxml-gccxml', '--castxml-output=<format>', or "
+      "'--castxml-layout'\n"
+      "\n" <<
+      usage
+      ;
+    return 1;
+  }
+
+  if(!opts.Instantiate.empty() && !opts.GccXml && !opts.Layout) {
+    std::cerr <<
+      "error: '--castxml-instantiate' requires '--castxml-gccxml', "
+      "'--castxml-output=<format>', or '--castxml-layout'\n"
+      "\n" <<
+      usage
+      ;
+    return 1;
+  }
+
+  if((opts.InstantiationReport || opts.MaxInstantiations) &&
+     !opts.GccXml && !opts.Layout) {
+    std::cerr <<
+      "error: '--castxml-instantiation-report' and "
+      "'--castxml-max-instantiations' require '--castxml-gccxml', "
+      "'--castxml-output=<format>', or '--castxml-layout'\n"
+      "\n" <<
+      usage
+      ;
+    return 1;
+  }
+
+#if defined(_WIN32)
+  if(opts.Fork) {
+    std::cerr << "error: '--castxml-fork' is not supported on Windows\n";
+    return 1;
+  }
+#endif
+
+  if(opts.Fork && !opts.GccXmlBase.empty()) {
+    std::cerr <<
+      "error: '--castxml-fork' may not be given with "
+      "'--castxml-gccxml-base'\n"
+      "\n" <<
+      usage
+      ;
+    return 1;
+  }
+
+  if(opts.Watch && (opts.Fork || !opts.GccXmlBase.empty())) {
+    std::cerr <<
+      "error: '--castxml-watch' may not be given with '--castxml-fork' "
+      "or '--castxml-gccxml-base'\n"
+      "\n" <<
+      usage
+      ;
+    return 1;
+  }
+
+  if(!opts.VFSArchives.empty() &&
+     (opts.Watch || !opts.HeaderIndex.empty())) {
+    std::cerr <<
+      "error: '--castxml-vfs-archive' may not be given with "
+      "'--castxml-watch' or '--castxml-header-index'\n"
+      "\n" <<
+      usage
+      ;
+    return 1;
+  }
+
+  if(!opts.Targets.empty() &&
+     (opts.HaveTarget || !opts.GccXmlBase.empty() || output_fd)) {
+    std::cerr <<
+      "error: '--castxml-targets' may not be given with "
+      "'-target', '--castxml-gccxml-base', or '--castxml-output-fd'\n"
+      "\n" <<
+      usage
+      ;
+    return 1;
+  }
+
+  if(opts.Targets.size() > 1 && !opts.OutputFile.empty() &&
+     opts.OutputFile.find("{triple}") == std::string::npos) {
+    std::cerr <<
+      "error: '-o' must name a file containing '{triple}' when "
+      "'--castxml-targets' gives more than one target\n"
+      "\n" <<
+      usage
+      ;
+    return 1;
+  }
+
+  if(opts.Targets.size() > 1 && cc_id) {
+    bool triple = false;
+    for(const char* a : cc_args) {
+      triple = triple || strstr(a, "{triple}");
+    }
+    if(!triple) {
+      std::cerr <<
+        "error: '--castxml-cc-" << cc_id << "' must be followed by a "
+        "compiler command containing '{triple}' when '--castxml-targets' "
+        "gives more than one target\n"
+        "\n" <<
+        usage
+        ;
+      return 1;
+    }
+  }
+
+  if(output_fd) {
+    if(!opts.OutputFile.empty()) {
+      std::cerr <<
+        "error: '--castxml-output-fd' may not be given with '-o'\n"
+        "\n" <<
+        usage
+        ;
+      return 1;
+    }
+#if defined(_WIN32)
+    std::cerr <<
+      "error: '--castxml-output-fd' is not supported on Windows\n";
+    return 1;
+#else
+    if(fcntl(atoi(output_fd), F_GETFD) == -1) {
+      std::cerr << "error: file descriptor " << output_fd <<
+        " given to '--castxml-output-fd' is not open\n";
+      return 1;
+    }
+    opts.OutputFd = atoi(output_fd);
+#endif
+  }
+
+  if(opts.MaxMemoryKB && !opts.Fork) {
+    std::cerr <<
+      "error: '--castxml-max-memory' requires '--castxml-fork'\n"
+      "\n" <<
+      usage
+      ;
+    return 1;
+  }
+
+  if(!opts.GccXmlBase.empty() && !opts.GccXml) {
+    std::cerr <<
+      "error: '--castxml-gccxml-base' requires '--castxml-gccxml'\n"
+      "\n" <<
+      usage
+      ;
+    return 1;
+  }
+
   if(cc_id) {
     opts.HaveCC = true;
     if(cc_args.empty()) {
@@ -266,6 +923,30 @@ int main(int argc_in, const char** argv_in)
     return 0;
   }
 
-  return runClang(clang_args.data(), clang_args.data() + clang_args.size(),
-                  opts);
+  CASTXML_PROBE(clang__start);
+  int ret = runClang(clang_args.data(),
+                     clang_args.data() + clang_args.size(), opts);
+  CASTXML_PROBE1(clang__done, ret);
+  if(opts.FreeAtExit) {
+    return ret;
+  }
+
+  // Exit without destroying the state left by the last source or any
+  // static data, as the Clang driver does with '-disable-free'.  Print
+  // reports that would otherwise be printed during destruction, and
+  // flush every output stream since _Exit flushes none of them.
+  llvm::TimerGroup::printAll(llvm::errs());
+  if(llvm::AreStatisticsEnabled()) {
+    llvm::PrintStatistics();
+  }
+  std::cout.flush();
+  std::clog.flush();
+  std::cerr.flush();
+  llvm::outs().flush();
+  llvm::errs().flush();
+  bool const flushed = fflush(0) == 0;
+  if(!std::cout || llvm::outs().has_error() || !flushed) {
+    ret = 1;
+  }
+  _Exit(ret);
 }
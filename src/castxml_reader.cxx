@@ -0,0 +1,174 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "castxml_reader.h"
+#include "Reader.h"
+
+#include <new>
+
+struct castxml_reader_s
+{
+  Reader R;
+  std::string Error;
+  bool Failed;
+};
+
+//----------------------------------------------------------------------------
+static castxml_string toC(ReaderString s)
+{
+  castxml_string c;
+  c.data = s.Data;
+  c.size = s.Size;
+  return c;
+}
+
+//----------------------------------------------------------------------------
+static bool validElement(castxml_reader const* r, unsigned int e)
+{
+  return r && !r->Failed && e < r->R.GetElements().size();
+}
+
+//----------------------------------------------------------------------------
+castxml_reader* castxml_reader_open(const char* fname)
+{
+  castxml_reader* r = new (std::nothrow) castxml_reader;
+  if (r) {
+    r->Failed = !r->R.Open(fname, r->Error);
+  }
+  return r;
+}
+
+//----------------------------------------------------------------------------
+void castxml_reader_free(castxml_reader* r)
+{
+  delete r;
+}
+
+//----------------------------------------------------------------------------
+const char* castxml_reader_error(castxml_reader const* r)
+{
+  if (!r) {
+    // castxml_reader_open returns null only if it cannot allocate.
+    return "cannot allocate a reader";
+  }
+  return r->Failed? r->Error.c_str() : 0;
+}
+
+//----------------------------------------------------------------------------
+unsigned int castxml_reader_element_count(castxml_reader const* r)
+{
+  if (!r || r->Failed) {
+    return 0;
+  }
+  return static_cast<unsigned int>(r->R.GetElements().size());
+}
+
+//----------------------------------------------------------------------------
+castxml_string castxml_reader_element_tag(castxml_reader const* r,
+                                          unsigned int e)
+{
+  if (!validElement(r, e)) {
+    return toC(ReaderString());
+  }
+  return toC(r->R.GetElement(e).Tag);
+}
+
+//----------------------------------------------------------------------------
+unsigned int castxml_reader_element_parent(castxml_reader const* r,
+                                           unsigned int e)
+{
+  return validElement(r, e)? r->R.GetElement(e).Parent : Reader::None;
+}
+
+//----------------------------------------------------------------------------
+unsigned int castxml_reader_element_first_child(castxml_reader const* r,
+                                                unsigned int e)
+{
+  return validElement(r, e)? r->R.GetElement(e).FirstChild : Reader::None;
+}
+
+//----------------------------------------------------------------------------
+unsigned int castxml_reader_element_next_sibling(castxml_reader const* r,
+                                                 unsigned int e)
+{
+  return validElement(r, e)? r->R.GetElement(e).NextSibling : Reader::None;
+}
+
+//----------------------------------------------------------------------------
+unsigned int castxml_reader_attribute_count(castxml_reader const* r,
+                                            unsigned int e)
+{
+  if (!validElement(r, e)) {
+    return 0;
+  }
+  Reader::Element const& el = r->R.GetElement(e);
+  return el.AttrEnd - el.AttrBegin;
+}
+
+//----------------------------------------------------------------------------
+castxml_string castxml_reader_attribute_name(castxml_reader const* r,
+                                             unsigned int e,
+                                             unsigned int i)
+{
+  if (i >= castxml_reader_attribute_count(r, e)) {
+    return toC(ReaderString());
+  }
+  return toC(r->R.AttrBegin(r->R.GetElement(e))[i].Name);
+}
+
+//----------------------------------------------------------------------------
+castxml_string castxml_reader_attribute_value(castxml_reader const* r,
+                                              unsigned int e,
+                                              unsigned int i)
+{
+  if (i >= castxml_reader_attribute_count(r, e)) {
+    return toC(ReaderString());
+  }
+  return toC(r->R.AttrBegin(r->R.GetElement(e))[i].Value);
+}
+
+//----------------------------------------------------------------------------
+castxml_string castxml_reader_get_attribute(castxml_reader const* r,
+                                            unsigned int e,
+                                            const char* name)
+{
+  if (!validElement(r, e)) {
+    return toC(ReaderString());
+  }
+  return toC(r->R.GetAttribute(r->R.GetElement(e), name));
+}
+
+//----------------------------------------------------------------------------
+unsigned int castxml_reader_find_id(castxml_reader const* r,
+                                    castxml_string id)
+{
+  if (!r || r->Failed) {
+    return Reader::None;
+  }
+  return r->R.FindId(ReaderString(id.data, id.size));
+}
+
+//----------------------------------------------------------------------------
+size_t castxml_reader_decode(castxml_string value, char* buf, size_t size)
+{
+  std::string s = Reader::Decode(ReaderString(value.data, value.size));
+  if (size > s.size()) {
+    memcpy(buf, s.c_str(), s.size() + 1);
+  } else if (size > 0) {
+    memcpy(buf, s.data(), size);
+  }
+  return s.size();
+}
@@ -0,0 +1,100 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+#ifndef CASTXML_READER_C_H
+#define CASTXML_READER_C_H
+
+/*
+  C interface to read castxml output files.  A file is mapped into
+  memory and indexed once.  Elements are identified by their index in
+  document order, starting with the root element at index 0.  Strings
+  refer directly to the mapped file and are not null-terminated.  They
+  remain valid until the reader is freed.
+*/
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Index value meaning "no element".  */
+#define CASTXML_READER_NONE (~0u)
+
+typedef struct castxml_reader_s castxml_reader;
+
+typedef struct castxml_string_s
+{
+  const char* data;
+  size_t size;
+} castxml_string;
+
+/* Create a reader for the named file.  Returns null only if memory
+   cannot be allocated.  Check castxml_reader_error for failure to read
+   or parse the file.  */
+castxml_reader* castxml_reader_open(const char* fname);
+
+/* Free a reader and release its file.  */
+void castxml_reader_free(castxml_reader* r);
+
+/* Get a null-terminated message describing failure to open the file,
+   or null if it was read successfully.  A null reader, as returned by
+   castxml_reader_open when out of memory, gets a message too.  */
+const char* castxml_reader_error(castxml_reader const* r);
+
+/* Number of elements in the document.  */
+unsigned int castxml_reader_element_count(castxml_reader const* r);
+
+/* Structure of element e.  */
+castxml_string castxml_reader_element_tag(castxml_reader const* r,
+                                          unsigned int e);
+unsigned int castxml_reader_element_parent(castxml_reader const* r,
+                                           unsigned int e);
+unsigned int castxml_reader_element_first_child(castxml_reader const* r,
+                                                unsigned int e);
+unsigned int castxml_reader_element_next_sibling(castxml_reader const* r,
+                                                 unsigned int e);
+
+/* Attributes of element e in document order.  Values are not decoded
+   from their XML representation.  */
+unsigned int castxml_reader_attribute_count(castxml_reader const* r,
+                                            unsigned int e);
+castxml_string castxml_reader_attribute_name(castxml_reader const* r,
+                                             unsigned int e,
+                                             unsigned int i);
+castxml_string castxml_reader_attribute_value(castxml_reader const* r,
+                                              unsigned int e,
+                                              unsigned int i);
+
+/* Get the value of the named attribute of element e.  Returns a string
+   with null data if the element has no such attribute.  */
+castxml_string castxml_reader_get_attribute(castxml_reader const* r,
+                                            unsigned int e,
+                                            const char* name);
+
+/* Get the index of the element with the given id.  */
+unsigned int castxml_reader_find_id(castxml_reader const* r,
+                                    castxml_string id);
+
+/* Decode character and entity references in a value into a buffer of
+   the given size.  Returns the size of the decoded value, which may be
+   larger than the buffer.  The result is null-terminated if it fits.  */
+size_t castxml_reader_decode(castxml_string value, char* buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CASTXML_READER_C_H */
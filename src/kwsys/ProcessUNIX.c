@@ -33,6 +33,10 @@ with the timeout on the select call to implement a timeout for program
 even when it closes stdout and stderr and at the same time avoiding
 races.
 
+A process group passes the pipes of all its processes to one poll
+call and then reads the pipes reported ready just as for a single
+process.
+
 */
 
 
@@ -113,6 +117,14 @@ static inline void kwsysProcess_usleep(unsigned int msec)
 # define KWSYSPE_USE_SELECT 1
 #endif
 
+/* A process group waits for the pipes of all its processes with one
+   call to poll, which unlike select does not limit the values of the
+   descriptors.  Use it wherever select works with pipes.  */
+#if KWSYSPE_USE_SELECT
+# define KWSYSPE_USE_POLL 1
+# include <poll.h>     /* poll */
+#endif
+
 /* Some platforms do not have siginfo on their signal handlers.  */
 #if defined(SA_SIGINFO) && !defined(__BEOS__)
 # define KWSYSPE_USE_SIGINFO 1
@@ -295,6 +307,24 @@ struct kwsysProcess_s
   char* RealWorkingDirectory;
 };
 
+/*--------------------------------------------------------------------------*/
+/* Structure containing data used to wait for a group of processes.  */
+struct kwsysProcessGroup_s
+{
+  /* The processes in the group.  The caller owns them.  */
+  kwsysProcess** Processes;
+  int NumberOfProcesses;
+
+  /* The process to check for data first, so that each gets a turn.  */
+  int Next;
+
+#if KWSYSPE_USE_POLL
+  /* Descriptors for call to poll, KWSYSPE_PIPE_COUNT per process.  Those
+     reported ready keep their revents until they are read.  */
+  struct pollfd* PollFds;
+#endif
+};
+
 /*--------------------------------------------------------------------------*/
 kwsysProcess* kwsysProcess_New(void)
 {
@@ -958,6 +988,14 @@ typedef struct kwsysProcessWaitData_s
 } kwsysProcessWaitData;
 static int kwsysProcessWaitForPipe(kwsysProcess* cp, char** data, int* length,
                                    kwsysProcessWaitData* wd);
+#if KWSYSPE_USE_SELECT
+static int kwsysProcessReadPipe(kwsysProcess* cp, int i, char** data,
+                                int* length, kwsysProcessWaitData* wd);
+#endif
+static int kwsysProcessGroupWaitForPipe(kwsysProcessGroup* pg, int* index,
+                                        char** data, int* length,
+                                        kwsysProcessTime* userTimeoutTime,
+                                        double* userTimeout);
 
 /*--------------------------------------------------------------------------*/
 int kwsysProcess_WaitForData(kwsysProcess* cp, char** data, int* length,
@@ -1040,6 +1078,56 @@ int kwsysProcess_WaitForData(kwsysProcess* cp, char** data, int* length,
     }
 }
 
+#if KWSYSPE_USE_SELECT
+/*--------------------------------------------------------------------------*/
+/* Read from a pipe reported ready.  Returns 1 if data are reported.  */
+static int kwsysProcessReadPipe(kwsysProcess* cp, int i, char** data,
+                                int* length, kwsysProcessWaitData* wd)
+{
+  kwsysProcess_ssize_t n;
+
+  /* The pipe is ready to read without blocking.  Keep trying to
+     read until the operation is not interrupted.  */
+  while(((n = read(cp->PipeReadEnds[i], cp->PipeBuffer,
+                   KWSYSPE_PIPE_BUFFER_SIZE)) < 0) && (errno == EINTR));
+  if(n > 0)
+    {
+    /* We have data on this pipe.  */
+    if(i == KWSYSPE_PIPE_SIGNAL)
+      {
+      /* A child process has terminated.  */
+      kwsysProcessDestroy(cp);
+      }
+    else if(data && length)
+      {
+      /* Report this data.  */
+      *data = cp->PipeBuffer;
+      *length = (int)(n);
+      switch(i)
+        {
+        case KWSYSPE_PIPE_STDOUT:
+          wd->PipeId = kwsysProcess_Pipe_STDOUT; break;
+        case KWSYSPE_PIPE_STDERR:
+          wd->PipeId = kwsysProcess_Pipe_STDERR; break;
+        };
+      return 1;
+      }
+    }
+  else if(n < 0 && errno == EAGAIN)
+    {
+    /* No data are really ready.  The select call lied.  See the
+       "man select" page on Linux for cases when this occurs.  */
+    }
+  else
+    {
+    /* We are done reading from this pipe.  */
+    kwsysProcessCleanupDescriptor(&cp->PipeReadEnds[i]);
+    --cp->PipesLeft;
+    }
+  return 0;
+}
+#endif
+
 /*--------------------------------------------------------------------------*/
 static int kwsysProcessWaitForPipe(kwsysProcess* cp, char** data, int* length,
                                    kwsysProcessWaitData* wd)
@@ -1061,48 +1149,11 @@ static int kwsysProcessWaitForPipe(kwsysProcess* cp, char** data, int* length,
     if(cp->PipeReadEnds[i] >= 0 &&
        FD_ISSET(cp->PipeReadEnds[i], &cp->PipeSet))
       {
-      kwsysProcess_ssize_t n;
-
       /* We are handling this pipe now.  Remove it from the set.  */
       FD_CLR(cp->PipeReadEnds[i], &cp->PipeSet);
-
-      /* The pipe is ready to read without blocking.  Keep trying to
-         read until the operation is not interrupted.  */
-      while(((n = read(cp->PipeReadEnds[i], cp->PipeBuffer,
-                       KWSYSPE_PIPE_BUFFER_SIZE)) < 0) && (errno == EINTR));
-      if(n > 0)
-        {
-        /* We have data on this pipe.  */
-        if(i == KWSYSPE_PIPE_SIGNAL)
-          {
-          /* A child process has terminated.  */
-          kwsysProcessDestroy(cp);
-          }
-        else if(data && length)
-          {
-          /* Report this data.  */
-          *data = cp->PipeBuffer;
-          *length = (int)(n);
-          switch(i)
-            {
-            case KWSYSPE_PIPE_STDOUT:
-              wd->PipeId = kwsysProcess_Pipe_STDOUT; break;
-            case KWSYSPE_PIPE_STDERR:
-              wd->PipeId = kwsysProcess_Pipe_STDERR; break;
-            };
-          return 1;
-          }
-        }
-      else if(n < 0 && errno == EAGAIN)
-        {
-        /* No data are really ready.  The select call lied.  See the
-           "man select" page on Linux for cases when this occurs.  */
-        }
-      else
+      if(kwsysProcessReadPipe(cp, i, data, length, wd))
         {
-        /* We are done reading from this pipe.  */
-        kwsysProcessCleanupDescriptor(&cp->PipeReadEnds[i]);
-        --cp->PipesLeft;
+        return 1;
         }
       }
     }
@@ -1405,6 +1456,380 @@ void kwsysProcess_Kill(kwsysProcess* cp)
   cp->CommandsLeft = 0;
 }
 
+/*--------------------------------------------------------------------------*/
+kwsysProcessGroup* kwsysProcessGroup_New(void)
+{
+  /* Allocate a group control structure.  */
+  kwsysProcessGroup* pg =
+    (kwsysProcessGroup*)malloc(sizeof(kwsysProcessGroup));
+  if(!pg)
+    {
+    return 0;
+    }
+  memset(pg, 0, sizeof(kwsysProcessGroup));
+  return pg;
+}
+
+/*--------------------------------------------------------------------------*/
+void kwsysProcessGroup_Delete(kwsysProcessGroup* pg)
+{
+  if(!pg)
+    {
+    return;
+    }
+  free(pg->Processes);
+#if KWSYSPE_USE_POLL
+  free(pg->PollFds);
+#endif
+  free(pg);
+}
+
+/*--------------------------------------------------------------------------*/
+int kwsysProcessGroup_AddProcess(kwsysProcessGroup* pg, kwsysProcess* cp)
+{
+  int i;
+  kwsysProcess** newProcesses;
+
+  if(!pg || !cp)
+    {
+    return -1;
+    }
+
+  /* Allocate a new array for process pointers.  */
+  if(!(newProcesses = (kwsysProcess**)malloc(
+         sizeof(kwsysProcess*) * (size_t)(pg->NumberOfProcesses + 1))))
+    {
+    /* Out of memory.  */
+    return -1;
+    }
+
+#if KWSYSPE_USE_POLL
+  /* Allocate room for the pipes of the new process.  */
+  {
+  struct pollfd* newPollFds = (struct pollfd*)realloc(
+    pg->PollFds, sizeof(struct pollfd) * KWSYSPE_PIPE_COUNT *
+    (size_t)(pg->NumberOfProcesses + 1));
+  if(!newPollFds)
+    {
+    free(newProcesses);
+    return -1;
+    }
+  pg->PollFds = newPollFds;
+  for(i=0; i < KWSYSPE_PIPE_COUNT; ++i)
+    {
+    struct pollfd* pfd =
+      &pg->PollFds[pg->NumberOfProcesses * KWSYSPE_PIPE_COUNT + i];
+    pfd->fd = -1;
+    pfd->events = POLLIN;
+    pfd->revents = 0;
+    }
+  }
+#endif
+
+  /* Copy the existing processes into the new array.  */
+  for(i=0; i < pg->NumberOfProcesses; ++i)
+    {
+    newProcesses[i] = pg->Processes[i];
+    }
+  newProcesses[pg->NumberOfProcesses] = cp;
+  free(pg->Processes);
+  pg->Processes = newProcesses;
+  return pg->NumberOfProcesses++;
+}
+
+/*--------------------------------------------------------------------------*/
+void kwsysProcessGroup_Execute(kwsysProcessGroup* pg)
+{
+  int i;
+  if(!pg)
+    {
+    return;
+    }
+  for(i=0; i < pg->NumberOfProcesses; ++i)
+    {
+    if(pg->Processes[i]->State != kwsysProcess_State_Executing)
+      {
+      kwsysProcess_Execute(pg->Processes[i]);
+      }
+    }
+#if KWSYSPE_USE_POLL
+  for(i=0; i < pg->NumberOfProcesses * KWSYSPE_PIPE_COUNT; ++i)
+    {
+    pg->PollFds[i].revents = 0;
+    }
+#endif
+  pg->Next = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+int kwsysProcessGroup_WaitForData(kwsysProcessGroup* pg, int* index,
+                                  char** data, int* length,
+                                  double* userTimeout)
+{
+  kwsysProcessTime userStartTime = {0, 0};
+  kwsysProcessTime userTimeoutTime = {-1, 0};
+  int pipeId;
+
+  if(!pg)
+    {
+    return kwsysProcess_Pipe_None;
+    }
+
+  /* Record the time at which user timeout period starts and the time
+     at which it will expire.  */
+  if(userTimeout)
+    {
+    userStartTime = kwsysProcessTimeGetCurrent();
+    userTimeoutTime =
+      kwsysProcessTimeAdd(userStartTime,
+                          kwsysProcessTimeFromDouble(*userTimeout));
+    }
+
+  /* Wait until something happens.  */
+  while((pipeId = kwsysProcessGroupWaitForPipe(pg, index, data, length,
+                                               &userTimeoutTime,
+                                               userTimeout)) < 0) {}
+
+  /* Update the user timeout.  */
+  if(userTimeout)
+    {
+    kwsysProcessTime userEndTime = kwsysProcessTimeGetCurrent();
+    kwsysProcessTime difference = kwsysProcessTimeSubtract(userEndTime,
+                                                           userStartTime);
+    double d = kwsysProcessTimeToDouble(difference);
+    *userTimeout -= d;
+    if(*userTimeout < 0)
+      {
+      *userTimeout = 0;
+      }
+    }
+
+  return pipeId;
+}
+
+/*--------------------------------------------------------------------------*/
+int kwsysProcessGroup_WaitForExit(kwsysProcessGroup* pg, double* userTimeout)
+{
+  int i;
+  int prPipe;
+
+  if(!pg)
+    {
+    return 1;
+    }
+
+  /* Wait for all the pipes to close.  Ignore all data.  */
+  while((prPipe = kwsysProcessGroup_WaitForData(pg, &i, 0, 0,
+                                                userTimeout)) > 0)
+    {
+    if(prPipe == kwsysProcess_Pipe_Timeout)
+      {
+      return 0;
+      }
+    }
+
+  /* Every process has closed its pipes, so this does not block.  */
+  for(i=0; i < pg->NumberOfProcesses; ++i)
+    {
+    kwsysProcess_WaitForExit(pg->Processes[i], 0);
+    }
+  return 1;
+}
+
+/*--------------------------------------------------------------------------*/
+/* Whether a process in a group still has pipes to read.  */
+static int kwsysProcessGroupIsReading(kwsysProcess* cp)
+{
+  return (cp->State == kwsysProcess_State_Executing && !cp->Killed &&
+          !cp->TimeoutExpired && cp->PipesLeft > 0);
+}
+
+/*--------------------------------------------------------------------------*/
+/* Wait for data from any process in the group.  Returns the pipe as
+   kwsysProcessGroup_WaitForData does, or -1 to be called again.  */
+static int kwsysProcessGroupWaitForPipe(kwsysProcessGroup* pg, int* index,
+                                        char** data, int* length,
+                                        kwsysProcessTime* userTimeoutTime,
+                                        double* userTimeout)
+{
+  int i;
+  int k;
+  kwsysProcessTimeNative timeoutLength;
+
+#if KWSYSPE_USE_POLL
+  int numReady = 0;
+  int reading = 0;
+  int timeoutMS = -1;
+  kwsysProcessTime timeoutTime = *userTimeoutTime;
+  int user = 1;
+
+  /* Report data on pipes reported ready by the last call to poll.
+     Start after the process reported last so each gets a turn.  As
+     for select, deal with every pipe reported before polling again.  */
+  for(k=0; k < pg->NumberOfProcesses; ++k)
+    {
+    kwsysProcess* cp;
+    int j;
+    i = (pg->Next + k) % pg->NumberOfProcesses;
+    cp = pg->Processes[i];
+    for(j=0; j < KWSYSPE_PIPE_COUNT; ++j)
+      {
+      struct pollfd* pfd = &pg->PollFds[i * KWSYSPE_PIPE_COUNT + j];
+      kwsysProcessWaitData wd = {0, kwsysProcess_Pipe_None, 0, 0, {0, 0}};
+      if(!pfd->revents)
+        {
+        continue;
+        }
+
+      /* We are handling this pipe now.  */
+      pfd->revents = 0;
+      if(kwsysProcessGroupIsReading(cp) && cp->PipeReadEnds[j] >= 0 &&
+         kwsysProcessReadPipe(cp, j, data, length, &wd))
+        {
+        pg->Next = (i + 1) % pg->NumberOfProcesses;
+        *index = i;
+        return wd.PipeId;
+        }
+      }
+    }
+
+  /* Kill the processes whose timeout has expired, as
+     kwsysProcess_WaitForData does, and poll the pipe reading ends of
+     the others.  Block until the earliest timeout.  */
+  for(i=0; i < pg->NumberOfProcesses; ++i)
+    {
+    kwsysProcess* cp = pg->Processes[i];
+    kwsysProcessTime processTimeoutTime;
+    for(k=0; k < KWSYSPE_PIPE_COUNT; ++k)
+      {
+      pg->PollFds[i * KWSYSPE_PIPE_COUNT + k].fd = -1;
+      }
+    if(!kwsysProcessGroupIsReading(cp))
+      {
+      continue;
+      }
+    kwsysProcessGetTimeoutTime(cp, 0, &processTimeoutTime);
+    if(kwsysProcessGetTimeoutLeft(&processTimeoutTime, 0, &timeoutLength, 0))
+      {
+      kwsysProcess_Kill(cp);
+      cp->Killed = 0;
+      cp->TimeoutExpired = 1;
+      continue;
+      }
+    if(processTimeoutTime.tv_sec >= 0 &&
+       (timeoutTime.tv_sec < 0 ||
+        kwsysProcessTimeLess(processTimeoutTime, timeoutTime)))
+      {
+      timeoutTime = processTimeoutTime;
+      user = 0;
+      }
+    for(k=0; k < KWSYSPE_PIPE_COUNT; ++k)
+      {
+      pg->PollFds[i * KWSYSPE_PIPE_COUNT + k].fd = cp->PipeReadEnds[k];
+      if(cp->PipeReadEnds[k] >= 0)
+        {
+        reading = 1;
+        }
+      }
+    }
+
+  /* Make sure we have a pipe to poll.  */
+  if(!reading)
+    {
+    /* All pipes have closed.  All children have terminated.  */
+    return kwsysProcess_Pipe_None;
+    }
+
+  /* Setup a timeout if required, rounding up to whole milliseconds.  */
+  if(kwsysProcessGetTimeoutLeft(&timeoutTime, user?userTimeout:0,
+                                &timeoutLength, 0))
+    {
+    /* Timeout has already expired.  */
+    return user? kwsysProcess_Pipe_Timeout : -1;
+    }
+  if(timeoutTime.tv_sec >= 0)
+    {
+    timeoutMS = (int)(timeoutLength.tv_sec * 1000 +
+                      (timeoutLength.tv_usec + 999) / 1000);
+    }
+
+  /* Run poll to block until data are available.  Repeat call
+     until it is not interrupted.  */
+  while(((numReady = poll(pg->PollFds,
+                          (nfds_t)(pg->NumberOfProcesses *
+                                   KWSYSPE_PIPE_COUNT),
+                          timeoutMS)) < 0) && (errno == EINTR));
+
+  /* Check result of poll.  */
+  if(numReady == 0)
+    {
+    /* Poll's timeout expired.  */
+    return user? kwsysProcess_Pipe_Timeout : -1;
+    }
+  else if(numReady < 0)
+    {
+    /* Poll returned an error.  Kill all the children now, leaving
+       the error description in their buffers.  */
+    const char* error = strerror(errno);
+    for(i=0; i < pg->NumberOfProcesses; ++i)
+      {
+      kwsysProcess* cp = pg->Processes[i];
+      if(kwsysProcessGroupIsReading(cp))
+        {
+        strncpy(cp->ErrorMessage, error, KWSYSPE_PIPE_BUFFER_SIZE);
+        kwsysProcess_Kill(cp);
+        cp->Killed = 0;
+        cp->SelectError = 1;
+        }
+      }
+    return -1;
+    }
+  return -1;
+#else
+  int reading = 0;
+
+  /* Poll each process for data without blocking since we do not have
+     select.  Start after the process reported last so each gets a
+     turn.  */
+  for(k=0; k < pg->NumberOfProcesses; ++k)
+    {
+    double zero = 0;
+    int pipeId;
+    i = (pg->Next + k) % pg->NumberOfProcesses;
+    if(!kwsysProcessGroupIsReading(pg->Processes[i]))
+      {
+      continue;
+      }
+    reading = 1;
+    pipeId = kwsysProcess_WaitForData(pg->Processes[i], data, length, &zero);
+    if(pipeId == kwsysProcess_Pipe_STDOUT ||
+       pipeId == kwsysProcess_Pipe_STDERR)
+      {
+      pg->Next = (i + 1) % pg->NumberOfProcesses;
+      *index = i;
+      return pipeId;
+      }
+    }
+
+  if(!reading)
+    {
+    /* All pipes have closed.  All children have terminated.  */
+    return kwsysProcess_Pipe_None;
+    }
+
+  if(kwsysProcessGetTimeoutLeft(userTimeoutTime, userTimeout,
+                                &timeoutLength, 1))
+    {
+    /* Timeout has already expired.  */
+    return kwsysProcess_Pipe_Timeout;
+    }
+
+  /* Sleep a little, try again. */
+  kwsysProcess_usleep(10000);
+  return -1;
+#endif
+}
+
 /*--------------------------------------------------------------------------*/
 /* Initialize a process control structure for kwsysProcess_Execute.  */
 static int kwsysProcessInitialize(kwsysProcess* cp)
@@ -308,6 +308,18 @@ struct kwsysProcess_s
   wchar_t* RealWorkingDirectory;
 };
 
+/*--------------------------------------------------------------------------*/
+/* Structure containing data used to wait for a group of processes.  */
+struct kwsysProcessGroup_s
+{
+  /* The processes in the group.  The caller owns them.  */
+  kwsysProcess** Processes;
+  int NumberOfProcesses;
+
+  /* The process to check for data first, so that each gets a turn.  */
+  int Next;
+};
+
 /*--------------------------------------------------------------------------*/
 kwsysProcess* kwsysProcess_New(void)
 {
@@ -1478,6 +1490,282 @@ void kwsysProcessPipeThreadWakePipe(kwsysProcess* cp, kwsysProcessPipeData* td)
     }
 }
 
+/*--------------------------------------------------------------------------*/
+kwsysProcessGroup* kwsysProcessGroup_New(void)
+{
+  /* Allocate a group control structure.  */
+  kwsysProcessGroup* pg =
+    (kwsysProcessGroup*)malloc(sizeof(kwsysProcessGroup));
+  if(!pg)
+    {
+    return 0;
+    }
+  ZeroMemory(pg, sizeof(*pg));
+  return pg;
+}
+
+/*--------------------------------------------------------------------------*/
+void kwsysProcessGroup_Delete(kwsysProcessGroup* pg)
+{
+  if(!pg)
+    {
+    return;
+    }
+  free(pg->Processes);
+  free(pg);
+}
+
+/*--------------------------------------------------------------------------*/
+int kwsysProcessGroup_AddProcess(kwsysProcessGroup* pg, kwsysProcess* cp)
+{
+  int i;
+  kwsysProcess** newProcesses;
+
+  if(!pg || !cp)
+    {
+    return -1;
+    }
+
+  /* Allocate a new array for process pointers.  */
+  if(!(newProcesses = (kwsysProcess**)malloc(
+         sizeof(kwsysProcess*) * (size_t)(pg->NumberOfProcesses + 1))))
+    {
+    /* Out of memory.  */
+    return -1;
+    }
+
+  /* Copy the existing processes into the new array.  */
+  for(i=0; i < pg->NumberOfProcesses; ++i)
+    {
+    newProcesses[i] = pg->Processes[i];
+    }
+  newProcesses[pg->NumberOfProcesses] = cp;
+  free(pg->Processes);
+  pg->Processes = newProcesses;
+  return pg->NumberOfProcesses++;
+}
+
+/*--------------------------------------------------------------------------*/
+void kwsysProcessGroup_Execute(kwsysProcessGroup* pg)
+{
+  int i;
+  if(!pg)
+    {
+    return;
+    }
+  for(i=0; i < pg->NumberOfProcesses; ++i)
+    {
+    if(pg->Processes[i]->State != kwsysProcess_State_Executing)
+      {
+      kwsysProcess_Execute(pg->Processes[i]);
+      }
+    }
+  pg->Next = 0;
+}
+
+/*--------------------------------------------------------------------------*/
+int kwsysProcessGroup_WaitForData(kwsysProcessGroup* pg, int* index,
+                                  char** data, int* length,
+                                  double* userTimeout)
+{
+  HANDLE events[MAXIMUM_WAIT_OBJECTS];
+  kwsysProcess* owners[MAXIMUM_WAIT_OBJECTS];
+  kwsysProcessTime userStartTime;
+  kwsysProcessTime userTimeoutTime;
+  kwsysProcessTime timeoutLength;
+  int pipeId = kwsysProcess_Pipe_None;
+  int i;
+  int k;
+
+  if(!pg)
+    {
+    return kwsysProcess_Pipe_None;
+    }
+
+  /* Record the time at which user timeout period starts and the time
+     at which it will expire.  */
+  userStartTime = kwsysProcessTimeGetCurrent();
+  userTimeoutTime.QuadPart = -1;
+  if(userTimeout)
+    {
+    userTimeoutTime =
+      kwsysProcessTimeAdd(userStartTime,
+                          kwsysProcessTimeFromDouble(*userTimeout));
+    }
+
+  /* Wait for the events of all the processes at once: the semaphore
+     their reading threads signal and their process handles.  */
+  while(pipeId == kwsysProcess_Pipe_None)
+    {
+    kwsysProcessTime timeoutTime = userTimeoutTime;
+    DWORD count = 0;
+    DWORD timeout;
+    DWORD w;
+    int reading = 0;
+    int all = 1;
+    int user = 1;
+
+    /* Start after the process reported last so each gets a turn.  */
+    for(k=0; k < pg->NumberOfProcesses; ++k)
+      {
+      kwsysProcess* cp;
+      kwsysProcessTime processTimeoutTime;
+      int e;
+      i = (pg->Next + k) % pg->NumberOfProcesses;
+      cp = pg->Processes[i];
+      if(cp->State != kwsysProcess_State_Executing || cp->Killed ||
+         cp->TimeoutExpired || cp->PipesLeft <= 0)
+        {
+        continue;
+        }
+      reading = 1;
+
+      /* If we previously got data from a thread, let it know we are
+         done with the data, as kwsysProcess_WaitForData would.  */
+      if(cp->CurrentIndex < KWSYSPE_PIPE_COUNT)
+        {
+        ReleaseSemaphore(cp->Pipe[cp->CurrentIndex].Reader.Go, 1, 0);
+        cp->CurrentIndex = KWSYSPE_PIPE_COUNT;
+        }
+
+      /* A process whose timeout has expired is killed by
+         kwsysProcess_WaitForData.  */
+      kwsysProcessGetTimeoutTime(cp, 0, &processTimeoutTime);
+      if(processTimeoutTime.QuadPart >= 0)
+        {
+        if(kwsysProcessGetTimeoutLeft(&processTimeoutTime, 0,
+                                      &timeoutLength))
+          {
+          double zero = 0;
+          kwsysProcess_WaitForData(cp, 0, 0, &zero);
+          continue;
+          }
+        if(timeoutTime.QuadPart < 0 ||
+           kwsysProcessTimeLess(processTimeoutTime, timeoutTime))
+          {
+          timeoutTime = processTimeoutTime;
+          user = 0;
+          }
+        }
+
+      for(e=0; e < cp->ProcessEventsLength; ++e)
+        {
+        if(count == MAXIMUM_WAIT_OBJECTS)
+          {
+          all = 0;
+          break;
+          }
+        events[count] = cp->ProcessEvents[e];
+        owners[count] = cp;
+        ++count;
+        }
+      }
+
+    if(!reading)
+      {
+      /* All pipes have closed.  All children have terminated.  */
+      break;
+      }
+    if(count == 0)
+      {
+      /* Every process left timed out.  */
+      continue;
+      }
+
+    /* Setup a timeout if required.  Wake up now and then to check the
+       processes whose events did not fit.  */
+    if(kwsysProcessGetTimeoutLeft(&timeoutTime, user?userTimeout:0,
+                                  &timeoutLength))
+      {
+      /* Timeout has already expired.  */
+      if(user)
+        {
+        pipeId = kwsysProcess_Pipe_Timeout;
+        }
+      continue;
+      }
+    timeout = (timeoutTime.QuadPart < 0)? INFINITE :
+      kwsysProcessTimeToDWORD(timeoutLength);
+    if(!all && timeout > 10)
+      {
+      timeout = 10;
+      }
+
+    w = WaitForMultipleObjects(count, events, 0, timeout);
+    if(w == WAIT_TIMEOUT)
+      {
+      /* Check the timeouts again.  */
+      continue;
+      }
+    else if(w < WAIT_OBJECT_0 + count)
+      {
+      kwsysProcess* cp = owners[w - WAIT_OBJECT_0];
+      double zero = 0;
+      int p;
+
+      /* The wait took a count of the semaphore of the reading threads.
+         Give it back for kwsysProcess_WaitForData to take.  */
+      if(events[w - WAIT_OBJECT_0] == cp->Full)
+        {
+        ReleaseSemaphore(cp->Full, 1, 0);
+        }
+      p = kwsysProcess_WaitForData(cp, data, length, &zero);
+      if(p == kwsysProcess_Pipe_STDOUT || p == kwsysProcess_Pipe_STDERR)
+        {
+        for(i=0; pg->Processes[i] != cp; ++i) {}
+        pg->Next = (i + 1) % pg->NumberOfProcesses;
+        *index = i;
+        pipeId = p;
+        }
+      }
+    }
+
+  /* Update the user timeout.  */
+  if(userTimeout)
+    {
+    kwsysProcessTime userEndTime = kwsysProcessTimeGetCurrent();
+    kwsysProcessTime difference = kwsysProcessTimeSubtract(userEndTime,
+                                                           userStartTime);
+    double d = kwsysProcessTimeToDouble(difference);
+    *userTimeout -= d;
+    if(*userTimeout < 0)
+      {
+      *userTimeout = 0;
+      }
+    }
+
+  return pipeId;
+}
+
+/*--------------------------------------------------------------------------*/
+int kwsysProcessGroup_WaitForExit(kwsysProcessGroup* pg, double* userTimeout)
+{
+  int i;
+  int prPipe;
+
+  if(!pg)
+    {
+    return 1;
+    }
+
+  /* Wait for all the pipes to close.  Ignore all data.  */
+  while((prPipe = kwsysProcessGroup_WaitForData(pg, &i, 0, 0,
+                                                userTimeout)) > 0)
+    {
+    if(prPipe == kwsysProcess_Pipe_Timeout)
+      {
+      return 0;
+      }
+    }
+
+  /* Every process has closed its pipes, so this does not block.  */
+  for(i=0; i < pg->NumberOfProcesses; ++i)
+    {
+    kwsysProcess_WaitForExit(pg->Processes[i], 0);
+    }
+  return 1;
+}
+
 /*--------------------------------------------------------------------------*/
 /* Initialize a process control structure for kwsysProcess_Execute.  */
 int kwsysProcessInitialize(kwsysProcess* cp)
@@ -37,14 +37,140 @@
 # include "RegularExpression.hxx.in"
 #endif
 
+#include KWSYS_HEADER(stl/algorithm)
+#include KWSYS_HEADER(stl/map)
+#include KWSYS_HEADER(stl/vector)
+
 #include <stdio.h>
 #include <string.h>
 
 namespace KWSYS_NAMESPACE
 {
 
+/*
+ * RegularExpressionAutomaton matches a compiled program without
+ * backtracking.  The program is translated to the instructions of a
+ * Thompson NFA, in which every STAR, PLUS, and BRANCH becomes a SPLIT
+ * that prefers its first alternative.  A Pike VM runs the instructions
+ * in lock step over the string, keeping at most one thread per
+ * instruction ordered by the preference, so it finds the match that
+ * regmatch() would find in time linear in the length of the string.
+ *
+ * Most strings searched do not match.  Those that lack the longest
+ * literal every match must contain are rejected by a memchr() scan for
+ * its first character, which the C library vectorizes, and a memcmp()
+ * of the rest at each candidate.  Which instructions are live at a
+ * position does not depend on the submatches, so a DFA over sets of
+ * live instructions then decides whether there is a match at all.
+ * Its states are built as the strings reach them and are kept across
+ * calls to find().  Should an expression need too many of them the DFA
+ * is abandoned and the Pike VM runs alone.
+ */
+class RegularExpressionAutomaton
+{
+public:
+  RegularExpressionAutomaton(const char* program, bool anchored,
+                             char start);
+  bool find(const char* string, const char* *startp, const char* *endp);
+
+private:
+  enum OpCode
+  {
+    CHAR,       // Consume character y, then go to x.
+    CLASS,      // Consume a character in Classes[y], then go to x.
+    SPLIT,      // Go to x, or else to y.
+    JUMP,       // Go to x.
+    SAVE,       // Record the position in slot y, then go to x.
+    ATBOL,      // Go to x at the beginning of the string.
+    ATEOL,      // Go to x at the end of the string.
+    MATCH       // Success.
+  };
+  struct Inst
+  {
+    OpCode op;
+    int x;
+    int y;
+  };
+  struct CharClass
+  {
+    unsigned char bits[32];
+  };
+
+  // A set of small integers that clears in constant time.  The dense
+  // array keeps the order of insertion.
+  struct SparseSet
+  {
+    kwsys_stl::vector<int> sparse;
+    kwsys_stl::vector<int> dense;
+    int size;
+    void init(int n) { sparse.resize(n); dense.resize(n); size = 0; }
+    bool insert(int i)
+      {
+      if (sparse[i] < size && dense[sparse[i]] == i)
+        return false;
+      sparse[i] = size;
+      dense[size++] = i;
+      return true;
+      }
+  };
+
+  // Threads of the Pike VM with their submatch positions.
+  struct ThreadList
+  {
+    SparseSet pcs;
+    kwsys_stl::vector<const char*> caps;
+  };
+
+  enum { NSLOT = 2 * RegularExpression::NSUBEXP };
+
+  // DFA states are dead, live, or matching, and may match at the end
+  // of the string.  Their transitions, -1 until computed, are kept in a
+  // table with 256 entries per state.
+  enum { DEAD, LIVE, MATCHES, MAXSTATES = 512 };
+
+  int node(const char* p);
+  void translate(const char* p);
+  int add(OpCode op, int x, int y);
+  int addClass(const char* p);
+  bool consumes(Inst const& inst, unsigned char c) const;
+
+  void addThread(ThreadList& l, int pc, const char* const* caps,
+                 const char* sp, const char* bol);
+  bool pike(const char* string, const char* *startp, const char* *endp);
+
+  void closure(int pc, bool atbol, bool ateol, kwsys_stl::vector<int>& out);
+  int state(kwsys_stl::vector<int>& pcs);
+  int transition(int s, unsigned char c);
+  bool matchesAtEnd(kwsys_stl::vector<int> const& pcs);
+  int dfa(const char* string);
+
+  kwsys_stl::vector<Inst> Insts;
+  kwsys_stl::vector<CharClass> Classes;
+  kwsys_stl::map<const char*, int> Nodes;
+  kwsys_stl::vector<const char*> Pending;
+  const char* Must;             // Literal every match contains, or 0.
+  size_t MustLen;
+  int Entry;
+  int Slots;                    // Submatch positions threads record.
+  bool Anchored;
+  char Start;
+
+  ThreadList Lists[2];
+
+  SparseSet Visited;
+  kwsys_stl::map<kwsys_stl::vector<int>, int> StateIndex;
+  kwsys_stl::vector<kwsys_stl::vector<int> > StatePcs;
+  kwsys_stl::vector<char> StateKinds;
+  kwsys_stl::vector<char> StateEnds;
+  kwsys_stl::vector<int> Transitions;
+  int StartState;
+  bool DfaFailed;
+};
+
 // RegularExpression -- Copies the given regular expression.
 RegularExpression::RegularExpression (const RegularExpression& rxp) {
+  this->engine = rxp.engine;                    // The automaton is rebuilt
+  this->automaton = 0;                          // when first needed
   if ( !rxp.program )
     {
     this->program = 0;
@@ -69,6 +195,7 @@ RegularExpression::RegularExpression (const RegularExpression& rxp) {
   }
   this->regstart = rxp.regstart;                // Copy starting index
   this->reganch = rxp.reganch;                  // Copy remaining private data
+  this->regloop = rxp.regloop;                  // Copy remaining private data
   this->regmlen = rxp.regmlen;                  // Copy remaining private data
 }
 
@@ -79,6 +206,9 @@ RegularExpression& RegularExpression::operator= (const RegularExpression& rxp)
     {
     return *this;
     }
+  this->engine = rxp.engine;
+  delete this->automaton;
+  this->automaton = 0;
   if ( !rxp.program )
     {
     this->program = 0;
@@ -104,11 +234,31 @@ RegularExpression& RegularExpression::operator= (const RegularExpression& rxp)
   }
   this->regstart = rxp.regstart;                // Copy starting index
   this->reganch = rxp.reganch;                  // Copy remaining private data
+  this->regloop = rxp.regloop;                  // Copy remaining private data
   this->regmlen = rxp.regmlen;                  // Copy remaining private data
 
   return *this;
 }
 
+// ~RegularExpression -- Destroys and frees space allocated for the regular
+// expression.
+RegularExpression::~RegularExpression () {
+//#ifndef WIN32
+  delete [] this->program;
+//#endif
+  delete this->automaton;
+}
+
+// set_invalid -- Marks the regular expression as invalid.
+void RegularExpression::set_invalid () {
+//#ifndef WIN32
+  delete [] this->program;
+//#endif
+  this->program = 0;
+  delete this->automaton;
+  this->automaton = 0;
+}
+
 // operator== -- Returns true if two regular expressions have the same
 // compiled program for pattern matching.
 bool RegularExpression::operator== (const RegularExpression& rxp) const {
@@ -174,6 +324,7 @@ bool RegularExpression::deep_equal (const RegularExpression& rxp) const {
  *
  * regstart     char that must begin a match; '\0' if none obvious
  * reganch      is the match anchored (at beginning-of-line only)?
+ * regloop      may backtracking take time polynomial or worse per start?
  * regmust      string (pointer into program) that match must include, or NULL
  * regmlen      length of regmust string
  *
@@ -184,7 +335,12 @@ bool RegularExpression::deep_equal (const RegularExpression& rxp) const {
  * potentially expensive (at present, the only such thing detected is * or +
  * at the start of the r.e., which can involve a lot of backup).  Regmlen is
  * supplied because the test in find() needs it and compile() is computing
- * it anyway.
+ * it anyway.  Regloop tells find() whether backtracking may take time
+ * exponential in the length of the line, or polynomial for each starting
+ * point, in which case it backtracks only within a budget of steps and runs
+ * the automaton instead if that runs out.  That is the case for a repeated
+ * parenthesized expression, whose loop goes through BACK, or for more than
+ * one STAR or PLUS.
  */
 
 /*
@@ -379,6 +535,8 @@ bool RegularExpression::compile (const char* exp) {
 //#ifndef WIN32
     if (this->program != 0) delete [] this->program;
 //#endif
+    delete this->automaton;
+    this->automaton = 0;
     this->program = new char[regsize];
     this->progsize = static_cast<int>(regsize);
 
@@ -398,8 +556,26 @@ bool RegularExpression::compile (const char* exp) {
     // Dig out information for optimizations.
     this->regstart = '\0';              // Worst-case defaults.
     this->reganch = 0;
+    this->regloop = 0;
     this->regmust = 0;
     this->regmlen = 0;
+
+    // Look for loops.  Nodes are laid out in order, each followed by
+    // its string operand, if any.
+    int loops = 0;
+    scan = this->program + 1;
+    while (scan < this->program + this->progsize) {
+        if (OP(scan) == BACK)
+            loops += 2;
+        else if (OP(scan) == STAR || OP(scan) == PLUS)
+            loops += 1;
+        if (OP(scan) == ANYOF || OP(scan) == ANYBUT || OP(scan) == EXACTLY)
+            scan = OPERAND(scan) + strlen(OPERAND(scan)) + 1;
+        else
+            scan = OPERAND(scan);
+    }
+    this->regloop = (loops > 1);
+
     scan = this->program + 1;   // First BRANCH.
     if (OP(regnext(scan)) == END) {     // Only one top-level choice.
         scan = OPERAND(scan);
@@ -852,6 +1028,490 @@ static void regoptail (char* p, const char* val) {
 }
 
 
+////////////////////////////////////////////////////////////////////////
+//
+//  the automaton
+//
+////////////////////////////////////////////////////////////////////////
+
+// The class is declared, and the approach described, at the top of the
+// file so that the RegularExpression members may delete it.
+
+/*
+ - findLiteral - whether a string contains a literal of at least one char
+ */
+static bool findLiteral (const char* s, size_t n, const char* lit,
+                         size_t len) {
+    const char* end = s + n;
+    while (static_cast<size_t>(end - s) >= len) {
+        s = static_cast<const char*>(memchr(s, lit[0], end - s - len + 1));
+        if (s == 0)
+            return false;
+        if (memcmp(s + 1, lit + 1, len - 1) == 0)
+            return true;
+        ++s;
+    }
+    return false;
+}
+
+/*
+ - RegularExpressionAutomaton - translate a compiled program
+ */
+RegularExpressionAutomaton::RegularExpressionAutomaton (const char* program,
+                                                        bool anchored,
+                                                        char start):
+  Must(0), MustLen(0), Slots(2), Anchored(anchored), Start(start),
+  StartState(-1), DfaFailed(false)
+{
+    // With only one top-level choice, the longest literal of its nodes
+    // must appear in every match.
+    if (OP(regnext(program + 1)) == END) {
+        for (const char* p = OPERAND(program + 1); p != 0; p = regnext(p))
+            if (OP(p) == EXACTLY && strlen(OPERAND(p)) >= this->MustLen) {
+                this->Must = OPERAND(p);
+                this->MustLen = strlen(OPERAND(p));
+            }
+    }
+
+    // Translate each node reachable from the first BRANCH once.
+    this->Entry = this->node(program + 1);
+    while (!this->Pending.empty()) {
+        const char* p = this->Pending.back();
+        this->Pending.pop_back();
+        this->translate(p);
+    }
+
+    int n = static_cast<int>(this->Insts.size());
+    for (int i = 0; i < 2; ++i) {
+        this->Lists[i].pcs.init(n);
+        this->Lists[i].caps.resize(n * this->Slots);
+    }
+    this->Visited.init(n);
+}
+
+/*
+ - node - get the instruction of a node, translating it later if new
+ */
+int RegularExpressionAutomaton::node (const char* p) {
+    kwsys_stl::map<const char*, int>::iterator i = this->Nodes.find(p);
+    if (i != this->Nodes.end())
+        return i->second;
+    int pc = this->add(MATCH, 0, 0);
+    this->Nodes[p] = pc;
+    this->Pending.push_back(p);
+    return pc;
+}
+
+/*
+ - add - append an instruction
+ */
+int RegularExpressionAutomaton::add (OpCode op, int x, int y) {
+    Inst inst;
+    inst.op = op;
+    inst.x = x;
+    inst.y = y;
+    this->Insts.push_back(inst);
+    return static_cast<int>(this->Insts.size()) - 1;
+}
+
+/*
+ - addClass - add the class of characters a simple node consumes
+ */
+int RegularExpressionAutomaton::addClass (const char* p) {
+    CharClass cc;
+    const char* opnd = OPERAND(p);
+    memset(cc.bits, (OP(p) == ANY || OP(p) == ANYBUT) ? 0377 : 0,
+           sizeof(cc.bits));
+    switch (OP(p)) {
+        case ANYOF:
+            for (; *opnd != '\0'; ++opnd)
+                cc.bits[UCHARAT(opnd) >> 3] |=
+                    static_cast<unsigned char>(1 << (UCHARAT(opnd) & 7));
+            break;
+        case ANYBUT:
+            for (; *opnd != '\0'; ++opnd)
+                cc.bits[UCHARAT(opnd) >> 3] &=
+                    static_cast<unsigned char>(~(1 << (UCHARAT(opnd) & 7)));
+            break;
+        case EXACTLY:
+            cc.bits[UCHARAT(opnd) >> 3] |=
+                static_cast<unsigned char>(1 << (UCHARAT(opnd) & 7));
+            break;
+    }
+    cc.bits[0] &= 0376;         // Never consume the terminator.
+    this->Classes.push_back(cc);
+    return static_cast<int>(this->Classes.size()) - 1;
+}
+
+/*
+ - translate - emit the instructions of a node
+ */
+void RegularExpressionAutomaton::translate (const char* p) {
+    int         pc = this->Nodes[p];
+    const char* next = regnext(p);
+    Inst        inst;
+
+    inst.op = JUMP;
+    inst.x = 0;
+    inst.y = 0;
+    switch (OP(p)) {
+        case END:
+            inst.op = MATCH;
+            break;
+        case BOL:
+            inst.op = ATBOL;
+            inst.x = this->node(next);
+            break;
+        case EOL:
+            inst.op = ATEOL;
+            inst.x = this->node(next);
+            break;
+        case ANY:
+        case ANYOF:
+        case ANYBUT:
+            inst.op = CLASS;
+            inst.x = this->node(next);
+            inst.y = this->addClass(p);
+            break;
+        case EXACTLY:{
+                // One instruction per character.
+                const char* opnd = OPERAND(p);
+                for (; opnd[1] != '\0'; ++opnd) {
+                    int x = this->add(MATCH, 0, 0);
+                    this->Insts[pc].op = CHAR;
+                    this->Insts[pc].x = x;
+                    this->Insts[pc].y = UCHARAT(opnd);
+                    pc = x;
+                }
+                inst.op = CHAR;
+                inst.x = this->node(next);
+                inst.y = UCHARAT(opnd);
+            }
+            break;
+        case BRANCH:
+            inst.x = this->node(OPERAND(p));
+            if (OP(next) == BRANCH) {
+                inst.op = SPLIT;
+                inst.y = this->node(next);
+            }
+            break;
+        case NOTHING:
+        case BACK:
+            inst.x = this->node(next);
+            break;
+        case STAR:{
+                // Prefer another repetition, as regmatch() does.
+                int cc = this->addClass(OPERAND(p));
+                int x = this->add(CLASS, pc, cc);
+                inst.op = SPLIT;
+                inst.x = x;
+                inst.y = this->node(next);
+            }
+            break;
+        case PLUS:{
+                int y = this->node(next);
+                int x = this->add(SPLIT, pc, y);
+                inst.op = CLASS;
+                inst.x = x;
+                inst.y = this->addClass(OPERAND(p));
+            }
+            break;
+        default:
+            if (OP(p) > OPEN && OP(p) < OPEN + RegularExpression::NSUBEXP) {
+                inst.op = SAVE;
+                inst.x = this->node(next);
+                inst.y = 2 * (OP(p) - OPEN);
+                if (inst.y + 2 > this->Slots)
+                    this->Slots = inst.y + 2;
+            }
+            else if (OP(p) > CLOSE &&
+                     OP(p) < CLOSE + RegularExpression::NSUBEXP) {
+                inst.op = SAVE;
+                inst.x = this->node(next);
+                inst.y = 2 * (OP(p) - CLOSE) + 1;
+                if (inst.y + 1 > this->Slots)
+                    this->Slots = inst.y + 1;
+            }
+            else {
+                // Corrupted; consume nothing.
+                inst.op = CLASS;
+                inst.y = this->addClass(p);
+            }
+            break;
+    }
+    this->Insts[pc] = inst;
+}
+
+/*
+ - consumes - can an instruction consume a character?
+ */
+bool RegularExpressionAutomaton::consumes (Inst const& inst,
+                                           unsigned char c) const {
+    if (inst.op == CHAR)
+        return inst.y == c;
+    if (inst.op == CLASS)
+        return (this->Classes[inst.y].bits[c >> 3] & (1 << (c & 7))) != 0;
+    return false;
+}
+
+/*
+ - addThread - add a thread and those it leads to without consuming
+ */
+void RegularExpressionAutomaton::addThread (ThreadList& l, int pc,
+                                            const char* const* caps,
+                                            const char* sp,
+                                            const char* bol) {
+    if (!l.pcs.insert(pc))
+        return;                 // Already there with higher priority.
+
+    Inst const& inst = this->Insts[pc];
+    switch (inst.op) {
+        case SPLIT:
+            this->addThread(l, inst.x, caps, sp, bol);
+            this->addThread(l, inst.y, caps, sp, bol);
+            break;
+        case JUMP:
+            this->addThread(l, inst.x, caps, sp, bol);
+            break;
+        case SAVE:{
+                const char* saved[NSLOT];
+                memcpy(saved, caps, this->Slots * sizeof(*caps));
+                saved[inst.y] = sp;
+                this->addThread(l, inst.x, saved, sp, bol);
+            }
+            break;
+        case ATBOL:
+            if (sp == bol)
+                this->addThread(l, inst.x, caps, sp, bol);
+            break;
+        case ATEOL:
+            if (*sp == '\0')
+                this->addThread(l, inst.x, caps, sp, bol);
+            break;
+        default:
+            memcpy(&l.caps[l.pcs.sparse[pc] * this->Slots], caps,
+                   this->Slots * sizeof(*caps));
+            break;
+    }
+}
+
+/*
+ - pike - find the match and its submatches with the Pike VM
+ */
+bool RegularExpressionAutomaton::pike (const char* string,
+                                       const char* *startp,
+                                       const char* *endp) {
+    ThreadList* clist = &this->Lists[0];
+    ThreadList* nlist = &this->Lists[1];
+    const char* caps[NSLOT];
+    const char* found[NSLOT];
+    bool        matched = false;
+
+    for (int i = 0; i < NSLOT; ++i)
+        caps[i] = found[i] = 0;
+
+    clist->pcs.size = 0;
+    for (const char* sp = string;; ++sp) {
+        // Until there is a match, try to start one here with the lowest
+        // priority, since regmatch() would try here last.
+        if (!matched && (!this->Anchored || sp == string)) {
+            if (clist->pcs.size == 0 && this->Start != '\0' &&
+                *sp != this->Start) {
+                // We know what char it must start with.
+                sp = strchr(sp, this->Start);
+                if (sp == 0)
+                    break;
+            }
+            caps[0] = sp;
+            this->addThread(*clist, this->Entry, caps, sp, string);
+        }
+
+        nlist->pcs.size = 0;
+        for (int i = 0; i < clist->pcs.size; ++i) {
+            Inst const& inst = this->Insts[clist->pcs.dense[i]];
+            if (inst.op == MATCH) {
+                // Threads of lower priority cannot win.
+                memcpy(found, &clist->caps[i * this->Slots],
+                       this->Slots * sizeof(*found));
+                found[1] = sp;
+                matched = true;
+                break;
+            }
+            if (this->consumes(inst, UCHARAT(sp)))
+                this->addThread(*nlist, inst.x,
+                                &clist->caps[i * this->Slots],
+                                sp + 1, string);
+        }
+        kwsys_stl::swap(clist, nlist);
+
+        if (*sp == '\0' ||
+            (clist->pcs.size == 0 && (matched || this->Anchored)))
+            break;
+    }
+
+    if (!matched)
+        return false;
+    for (int n = 0; n < RegularExpression::NSUBEXP; ++n) {
+        startp[n] = found[2 * n];
+        endp[n] = found[2 * n + 1];
+    }
+    return true;
+}
+
+/*
+ - closure - collect the instructions a thread may wait at
+ */
+void RegularExpressionAutomaton::closure (int pc, bool atbol, bool ateol,
+                                          kwsys_stl::vector<int>& out) {
+    if (!this->Visited.insert(pc))
+        return;
+
+    Inst const& inst = this->Insts[pc];
+    switch (inst.op) {
+        case SPLIT:
+            this->closure(inst.x, atbol, ateol, out);
+            this->closure(inst.y, atbol, ateol, out);
+            break;
+        case JUMP:
+        case SAVE:
+            this->closure(inst.x, atbol, ateol, out);
+            break;
+        case ATBOL:
+            if (atbol)
+                this->closure(inst.x, atbol, ateol, out);
+            break;
+        case ATEOL:
+            if (ateol)
+                this->closure(inst.x, atbol, ateol, out);
+            else
+                out.push_back(pc);
+            break;
+        default:
+            out.push_back(pc);
+            break;
+    }
+}
+
+/*
+ - state - get the DFA state of a set of instructions, or -1 if too many
+ */
+int RegularExpressionAutomaton::state (kwsys_stl::vector<int>& pcs) {
+    kwsys_stl::sort(pcs.begin(), pcs.end());
+    kwsys_stl::map<kwsys_stl::vector<int>, int>::iterator i =
+        this->StateIndex.find(pcs);
+    if (i != this->StateIndex.end())
+        return i->second;
+    if (this->StatePcs.size() >= MAXSTATES)
+        return -1;
+
+    char kind = pcs.empty() ? DEAD : LIVE;
+    for (size_t j = 0; j < pcs.size(); ++j)
+        if (this->Insts[pcs[j]].op == MATCH)
+            kind = MATCHES;
+    int s = static_cast<int>(this->StatePcs.size());
+    this->StateIndex[pcs] = s;
+    this->StatePcs.push_back(pcs);
+    this->StateKinds.push_back(kind);
+    this->StateEnds.push_back(this->matchesAtEnd(pcs));
+    this->Transitions.resize((s + 1) * 256, -1);
+    return s;
+}
+
+/*
+ - transition - compute the DFA state following another on a character
+ */
+int RegularExpressionAutomaton::transition (int s, unsigned char c) {
+    kwsys_stl::vector<int> pcs;
+
+    this->Visited.size = 0;
+    for (size_t i = 0; i < this->StatePcs[s].size(); ++i) {
+        Inst const& inst = this->Insts[this->StatePcs[s][i]];
+        if (this->consumes(inst, c))
+            this->closure(inst.x, false, false, pcs);
+    }
+    if (!this->Anchored)
+        this->closure(this->Entry, false, false, pcs);
+
+    int t = this->state(pcs);
+    if (t >= 0)
+        this->Transitions[s * 256 + c] = t;
+    return t;
+}
+
+/*
+ - matchesAtEnd - does a set of instructions match at the end of the string?
+ */
+bool RegularExpressionAutomaton::matchesAtEnd (
+    kwsys_stl::vector<int> const& pcs) {
+    kwsys_stl::vector<int> end;
+
+    this->Visited.size = 0;
+    for (size_t i = 0; i < pcs.size(); ++i)
+        if (this->Insts[pcs[i]].op == ATEOL)
+            this->closure(pcs[i], false, true, end);
+    for (size_t i = 0; i < end.size(); ++i)
+        if (this->Insts[end[i]].op == MATCH)
+            return true;
+    return false;
+}
+
+/*
+ - dfa - decide whether a non-empty string matches
+   0 no match, 1 match, -1 too many states
+ */
+int RegularExpressionAutomaton::dfa (const char* string) {
+    if (this->StartState < 0) {
+        kwsys_stl::vector<int> pcs;
+        this->Visited.size = 0;
+        this->closure(this->Entry, true, false, pcs);
+        this->StartState = this->state(pcs);
+    }
+
+    int s = this->StartState;
+    for (const char* sp = string; this->StateKinds[s] == LIVE; ++sp) {
+        if (*sp == '\0')
+            return this->StateEnds[s];
+        int t = this->Transitions[s * 256 + UCHARAT(sp)];
+        if (t < 0 && (t = this->transition(s, UCHARAT(sp))) < 0)
+            return -1;
+        s = t;
+    }
+    return this->StateKinds[s] == MATCHES ? 1 : 0;
+}
+
+/*
+ - find - match a string
+ */
+bool RegularExpressionAutomaton::find (const char* string,
+                                       const char* *startp,
+                                       const char* *endp) {
+    for (int n = 0; n < RegularExpression::NSUBEXP; ++n)
+        startp[n] = endp[n] = 0;
+
+    // Reject strings without the literal that must appear.
+    if (this->Must != 0 &&
+        !findLiteral(string, strlen(string), this->Must, this->MustLen))
+        return false;
+
+    // Most strings do not match, so reject them without the submatches.
+    if (!this->DfaFailed && *string != '\0') {
+        int r = this->dfa(string);
+        if (r == 0)
+            return false;
+        if (r < 0) {
+            // Too many states; fall back to the Pike VM for good.
+            this->DfaFailed = true;
+            this->StateIndex.clear();
+            this->StatePcs.clear();
+            this->StateKinds.clear();
+            this->StateEnds.clear();
+            this->Transitions.clear();
+        }
+    }
+    return this->pike(string, startp, endp);
+}
+
+
 
 ////////////////////////////////////////////////////////////////////////
 // 
@@ -867,6 +1527,14 @@ static const char*  reginput;   // String-input pointer.
 static const char*  regbol;     // Beginning of input, for ^ check.
 static const char* *regstartp;  // Pointer to startp array.
 static const char* *regendp;    // Ditto for endp.
+static bool         regbudget;  // Is backtracking limited to regsteps?
+static size_t       regsteps;   // Steps left before backtracking gives up.
+
+/*
+ * Steps of backtracking allowed per character of the string where it may
+ * blow up, before find() runs the automaton instead.
+ */
+#define REGSTEPS 64
 
 /*
  * Forwards.
@@ -886,8 +1554,6 @@ static char* regprop ();
 // Returns true if found, and sets start and end indexes accordingly.
 
 bool RegularExpression::find (const char* string) {
-    const char* s;
-
     this->searchstring = string;
 
     if (!this->program)
@@ -902,6 +1568,29 @@ bool RegularExpression::find (const char* string) {
         return 0;
     }
 
+    // Where backtracking may blow up, backtrack only for a number of
+    // steps linear in the length of the string, which is enough for
+    // most strings, and run the automaton if they run out.  The
+    // automaton looks for the literal that must appear itself.
+    if (this->engine != AUTOMATON) {
+        regbudget = (this->engine == AUTOMATIC && this->regloop);
+        regsteps = regbudget ? REGSTEPS * (strlen(string) + 1) : 0;
+        bool found = this->backtrack(string);
+        if (!regbudget || regsteps != 0)
+            return found;
+    }
+    if (!this->automaton)
+        this->automaton = new RegularExpressionAutomaton(
+            this->program, this->reganch != 0, this->regstart);
+    return this->automaton->find(string, this->startp, this->endp);
+}
+
+// backtrack -- Matches the program by backtracking, giving up with no
+// match once regsteps runs out if regbudget is set.
+
+bool RegularExpression::backtrack (const char* string) {
+    const char* s;
+
     // If there is a "must appear" string, look for it.
     if (this->regmust != 0) {
         s = string;
@@ -928,6 +1617,8 @@ bool RegularExpression::find (const char* string) {
         while ((s = strchr(s, this->regstart)) != 0) {
             if (regtry(s, this->startp, this->endp, this->program))
                 return (1);
+            if (regbudget && regsteps == 0)
+                return (0);
             s++;
 
         }
@@ -936,6 +1627,8 @@ bool RegularExpression::find (const char* string) {
         do {
             if (regtry(s, this->startp, this->endp, this->program))
                 return (1);
+            if (regbudget && regsteps == 0)
+                return (0);
         } while (*s++ != '\0');
 
     // Failure.
@@ -992,6 +1685,13 @@ static int regmatch (const char* prog) {
 
     while (scan != 0) {
 
+        // Give up once the steps allowed run out.
+        if (regbudget) {
+            if (regsteps == 0)
+                return (0);
+            regsteps--;
+        }
+
         next = regnext(scan);
 
         switch (OP(scan)) {
@@ -1130,6 +1830,9 @@ static int regmatch (const char* prog) {
                     min_no = (OP(scan) == STAR) ? 0 : 1;
                     save = reginput;
                     no = regrepeat(OPERAND(scan));
+                    if (regbudget)
+                        regsteps = (size_t(no) < regsteps ?
+                                    regsteps - size_t(no) : 0);
                     while (no >= min_no) {
                         // If it could work, try it.
                         if (nextch == '\0' || *reginput == nextch)
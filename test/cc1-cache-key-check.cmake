@@ -0,0 +1,6 @@
+# Each change should have missed the cache and added an entry.
+file(GLOB entries "${cc1_cache}/*.cc1")
+list(LENGTH entries count)
+if(NOT count EQUAL 3)
+  set(msg "${msg}Expected 3 cc1 cache entries but found ${count}.\n")
+endif()
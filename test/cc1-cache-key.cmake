@@ -0,0 +1,20 @@
+# Populate the cc1 cache with a first run, then change what the driver
+# could see before each later run so that each adds an entry.
+file(REMOVE_RECURSE "${cc1_sysroot}")
+file(MAKE_DIRECTORY "${cc1_sysroot}")
+include(${CMAKE_CURRENT_LIST_DIR}/cc1-cache.cmake)
+
+# A GCC installation appears in the sysroot.
+file(MAKE_DIRECTORY "${cc1_sysroot}/usr/lib/gcc/x86_64-linux-gnu/99")
+execute_process(
+  COMMAND ${command}
+  RESULT_VARIABLE second_result
+  OUTPUT_QUIET
+  ERROR_QUIET
+  )
+if(NOT second_result EQUAL 0)
+  message(FATAL_ERROR "Second run failed")
+endif()
+
+# The environment changes for the tested run.
+set(ENV{CASTXML_TEST_CC1_CACHE_KEY} 1)
@@ -0,0 +1,12 @@
+# Populate the cc1 cache with a first run so the tested run hits it.
+file(REMOVE_RECURSE "${cc1_cache}")
+execute_process(
+  COMMAND ${command}
+  RESULT_VARIABLE first_result
+  OUTPUT_QUIET
+  ERROR_QUIET
+  )
+file(GLOB entries "${cc1_cache}/*.cc1")
+if(NOT first_result EQUAL 0 OR NOT entries)
+  message(FATAL_ERROR "First run did not populate cc1 cache '${cc1_cache}'")
+endif()
@@ -0,0 +1,95 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Measure the run time of castxml with and without freeing all memory
+// before exit.  Usage:
+//   exit-bench [-n <iterations>] <castxml> <castxml-arg>...
+// For example, on a large translation unit using the STL, run
+//   exit-bench castxml --castxml-gccxml --castxml-start start
+//     -std=c++11 test/input/ExitBench.cxx -o ExitBench.xml
+// as one command line.
+
+#include <cxsys/Process.h>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+typedef std::chrono::steady_clock Clock;
+
+//----------------------------------------------------------------------------
+static bool run(std::vector<const char*> const& cmd, double& secs)
+{
+  std::vector<const char*> argv(cmd);
+  argv.push_back(0);
+  cxsysProcess* cp = cxsysProcess_New();
+  cxsysProcess_SetCommand(cp, &*argv.begin());
+  cxsysProcess_SetOption(cp, cxsysProcess_Option_HideWindow, 1);
+  Clock::time_point start = Clock::now();
+  cxsysProcess_Execute(cp);
+  cxsysProcess_WaitForExit(cp, 0);
+  secs = std::chrono::duration<double>(Clock::now() - start).count();
+  bool ok = (cxsysProcess_GetState(cp) == cxsysProcess_State_Exited &&
+             cxsysProcess_GetExitValue(cp) == 0);
+  cxsysProcess_Delete(cp);
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, const char* argv[])
+{
+  int iterations = 5;
+  int i = 1;
+  if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+    iterations = atoi(argv[i + 1]);
+    i += 2;
+  }
+  if (i >= argc || iterations < 1) {
+    std::cerr << "usage: exit-bench [-n <iterations>] "
+                 "<castxml> <castxml-arg>...\n";
+    return 1;
+  }
+  std::vector<const char*> fast(argv + i, argv + argc);
+  std::vector<const char*> full(fast);
+  full.insert(full.begin() + 1, "--castxml-free-at-exit");
+
+  // Alternate the two modes so that both see the same system state.
+  double fastTotal = 0;
+  double fullTotal = 0;
+  for (int n = 0; n < iterations; ++n) {
+    double secs;
+    if (!run(fast, secs)) {
+      std::cerr << "error: castxml failed\n";
+      return 1;
+    }
+    fastTotal += secs;
+    if (!run(full, secs)) {
+      std::cerr << "error: castxml --castxml-free-at-exit failed\n";
+      return 1;
+    }
+    fullTotal += secs;
+  }
+
+  double fastMean = fastTotal / iterations;
+  double fullMean = fullTotal / iterations;
+  std::cout << "  fast exit:    " << fastMean << " s\n"
+            << "  free at exit: " << fullMean << " s\n"
+            << "  saved:        " << (fullMean - fastMean) << " s ("
+            << (100 * (fullMean - fastMean) / fullMean) << "%)\n";
+  return 0;
+}
@@ -0,0 +1,21 @@
+# Check the output written for each source, which references elements
+# of the base document, against its own expectation.  Remove it so that
+# the next run does not see it.
+foreach(src ${sources})
+  set(f "${src}.xml")
+  if(EXISTS "${f}")
+    file(READ "${f}" actual_src)
+    file(REMOVE "${f}")
+  else()
+    set(actual_src "(missing)")
+  endif()
+  file(READ ${CMAKE_CURRENT_LIST_DIR}/expect/gccxml-base.${src}.xml.txt
+    expect_src)
+  string(REGEX REPLACE "\n+$" "" actual_src "${actual_src}")
+  string(REGEX REPLACE "\n+$" "" expect_src "${expect_src}")
+  if(NOT "${actual_src}" MATCHES "${expect_src}")
+    string(REGEX REPLACE "\n" "\n actual-${src}> " actual_src
+      " actual-${src}> ${actual_src}")
+    set(msg "${msg}${f} does not match that expected.\n${actual_src}\n")
+  endif()
+endforeach()
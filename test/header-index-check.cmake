@@ -0,0 +1,13 @@
+# The index should list both include directories.
+file(READ "${header_index}" actual_index)
+foreach(e
+    "\n[0-9]+ [0-9]+ [^\n]*/test/input/HeaderIndex-1\n\ta\\.h\n"
+    "\n[0-9]+ [0-9]+ [^\n]*/test/input/HeaderIndex-2\n\ta\\.h\n\tb\\.h\n"
+    )
+  if(NOT "${actual_index}" MATCHES "${e}")
+    string(REGEX REPLACE "\n" "\n actual-index> " actual_index
+      " actual-index> ${actual_index}")
+    set(msg "${msg}${header_index} does not match that expected.\n${actual_index}\n")
+    break()
+  endif()
+endforeach()
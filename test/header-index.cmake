@@ -0,0 +1,12 @@
+# Populate the header index with a first run so the tested run answers
+# include probes from the listings it holds.
+file(REMOVE "${header_index}")
+execute_process(
+  COMMAND ${command}
+  RESULT_VARIABLE first_result
+  OUTPUT_QUIET
+  ERROR_QUIET
+  )
+if(NOT first_result EQUAL 0 OR NOT EXISTS "${header_index}")
+  message(FATAL_ERROR "First run did not write header index '${header_index}'")
+endif()
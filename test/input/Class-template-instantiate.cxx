@@ -0,0 +1 @@
+template <typename T> struct start { T field; };
@@ -0,0 +1,22 @@
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace start {
+  std::vector<std::string> strings;
+  std::map<std::string, std::vector<int> > map_of_vectors;
+  std::unordered_map<std::string, std::set<double> > hash_of_sets;
+  std::unordered_set<std::shared_ptr<std::list<char> > > hash_of_lists;
+  std::deque<std::function<void(std::ostream&)> > printers;
+  std::unique_ptr<std::stringstream> stream;
+}
@@ -0,0 +1,6 @@
+#include <gccxml-base-1.h>
+#include "GccXmlBase-user.h"
+namespace start {
+  enum User { user };
+  void f() { sysns::use(user); }
+}
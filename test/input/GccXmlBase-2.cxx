@@ -0,0 +1,6 @@
+#include <gccxml-base-1.h>
+#include <gccxml-base-2.h>
+#include "GccXmlBase-user.h"
+namespace start {
+  userns::Count var;
+}
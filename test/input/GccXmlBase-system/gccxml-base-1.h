@@ -0,0 +1,4 @@
+namespace sysns {
+  typedef int Int;
+  template <typename T> void use(T) {}
+}
@@ -0,0 +1,3 @@
+namespace sysns {
+  Int other(Int);
+}
@@ -0,0 +1,4 @@
+namespace userns {
+  typedef sysns::Int Count;
+  Count count();
+}
@@ -0,0 +1 @@
+namespace start { int a2; }
@@ -0,0 +1 @@
+#include "Field.cxx"
@@ -0,0 +1,15 @@
+/* A comment mentioning
+#include "does-not-exist.h"
+*/
+const char* s = "\
+#include \"does-not-exist.h\"";
+int n = 0; /* a comment
+#include "does-not-exist.h" */ #include "does-not-exist.h"
+#define EMPTY_FILE "empty.cxx" // comment with "quote
+#if 0
+# include "does-not-exist.h"
+#endif
+  #  include EMPTY_FILE /* comment
+  spanning lines */
+#include "Field.cxx" // "Field.cxx" again below
+#include "Field.cxx"
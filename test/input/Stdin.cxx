@@ -0,0 +1,5 @@
+#if defined(__cplusplus)
+#define CASTXML_STDIN_CXX 1
+#else
+#define CASTXML_STDIN_C 1
+#endif
@@ -0,0 +1,19 @@
+# The history should keep the measurement it held and add one for the
+# source, with the peak memory reported for the forked child.
+if(EXISTS "${job_history}")
+  file(READ "${job_history}" actual_history)
+else()
+  set(actual_history "(missing)")
+endif()
+foreach(e
+    "^# castxml job history 1\n"
+    "\n2\\.500 1024 100 /no/such/source\\.cxx\n"
+    "\n[0-9]+\\.[0-9][0-9][0-9] [1-9][0-9]* [1-9][0-9]* [^\n]*/test/input/Field\\.cxx\n"
+    )
+  if(NOT "${actual_history}" MATCHES "${e}")
+    string(REGEX REPLACE "\n" "\n actual-history> " actual_history
+      " actual-history> ${actual_history}")
+    set(msg "${msg}${job_history} does not match that expected.\n${actual_history}\n")
+    break()
+  endif()
+endforeach()
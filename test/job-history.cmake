@@ -0,0 +1,5 @@
+# Start with a history holding a measurement of another source.
+file(WRITE "${job_history}"
+  "# castxml job history 1\n"
+  "2.500 1024 100 /no/such/source.cxx\n"
+  )
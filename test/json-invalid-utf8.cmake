@@ -0,0 +1,6 @@
+# Name the source with a byte that is not valid UTF-8.  The XML output
+# carries it in a File element, which cannot be converted to JSON.
+string(ASCII 255 byte)
+set(source "json-invalid-utf8-${byte}.cxx")
+file(WRITE "${source}" "namespace start { int v; }\n")
+list(APPEND command "${source}")
@@ -0,0 +1,6 @@
+# The peak after output can only have grown from that before output.
+if("${actual_stderr}" MATCHES "peak RSS ([0-9]+) KiB before output, ([0-9]+) KiB after")
+  if(CMAKE_MATCH_2 LESS CMAKE_MATCH_1)
+    set(msg "${msg}Peak RSS after output (${CMAKE_MATCH_2} KiB) is less than before output (${CMAKE_MATCH_1} KiB).\n")
+  endif()
+endif()
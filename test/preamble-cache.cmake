@@ -0,0 +1,13 @@
+# Populate the preamble cache with a first run so the tested run loads it.
+file(REMOVE_RECURSE "${preamble_cache}")
+execute_process(
+  COMMAND ${command}
+  RESULT_VARIABLE first_result
+  OUTPUT_QUIET
+  ERROR_QUIET
+  )
+file(GLOB entries "${preamble_cache}/*.pch")
+if(NOT first_result EQUAL 0 OR NOT entries)
+  message(FATAL_ERROR
+    "First run did not populate preamble cache '${preamble_cache}'")
+endif()
@@ -0,0 +1,140 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Check that a cxsysProcessGroup runs its processes concurrently, each
+// with its own timeout.  Usage:
+//   process-group
+//   process-group child <seconds> <text>
+// The second form is run by the first for each process of the group.
+// It writes <text> to stdout, sleeps, and writes <text> to stderr.
+
+#include <cxsys/Process.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef std::chrono::steady_clock Clock;
+
+struct Child
+{
+  const char* Text;
+  const char* Seconds;  // How long the child sleeps.
+  double Timeout;       // Zero for none.
+  int State;            // Expected state once the group is done.
+};
+
+// The children sleep in parallel, and the one with the short timeout
+// is killed without waiting for or disturbing the others.
+static Child const children[] = {
+  { "a", "0.5", 10, cxsysProcess_State_Exited },
+  { "b", "30", 1, cxsysProcess_State_Expired },
+  { "c", "1", 0, cxsysProcess_State_Exited },
+  { "d", "0", 5, cxsysProcess_State_Exited },
+  { "e", "30", 2, cxsysProcess_State_Expired }
+};
+static size_t const numChildren = sizeof(children) / sizeof(children[0]);
+
+//----------------------------------------------------------------------------
+static int child(const char* seconds, const char* text)
+{
+  fprintf(stdout, "%s", text);
+  fflush(stdout);
+  std::this_thread::sleep_for(
+    std::chrono::duration<double>(atof(seconds)));
+  fprintf(stderr, "%s", text);
+  fflush(stderr);
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, const char* argv[])
+{
+  if (argc == 4 && strcmp(argv[1], "child") == 0) {
+    return child(argv[2], argv[3]);
+  }
+
+  std::vector<cxsysProcess*> cps;
+  std::vector<std::string> outs(numChildren);
+  std::vector<std::string> errs(numChildren);
+  cxsysProcessGroup* pg = cxsysProcessGroup_New();
+  for (size_t i = 0; i < numChildren; ++i) {
+    const char* cmd[] = {
+      argv[0], "child", children[i].Seconds, children[i].Text, 0
+    };
+    cxsysProcess* cp = cxsysProcess_New();
+    cxsysProcess_SetCommand(cp, cmd);
+    cxsysProcess_SetTimeout(cp, children[i].Timeout);
+    if (cxsysProcessGroup_AddProcess(pg, cp) != static_cast<int>(i)) {
+      std::cerr << "error: cannot add process " << i << "\n";
+      return 1;
+    }
+    cps.push_back(cp);
+  }
+
+  Clock::time_point start = Clock::now();
+  cxsysProcessGroup_Execute(pg);
+  int index;
+  char* data;
+  int length;
+  int pipe;
+  while ((pipe = cxsysProcessGroup_WaitForData(pg, &index, &data, &length,
+                                               0)) > 0) {
+    if (pipe == cxsysProcess_Pipe_STDOUT) {
+      outs[index].append(data, length);
+    } else if (pipe == cxsysProcess_Pipe_STDERR) {
+      errs[index].append(data, length);
+    }
+  }
+  cxsysProcessGroup_WaitForExit(pg, 0);
+  double seconds =
+    std::chrono::duration<double>(Clock::now() - start).count();
+  cxsysProcessGroup_Delete(pg);
+
+  int failed = 0;
+  for (size_t i = 0; i < numChildren; ++i) {
+    Child const& c = children[i];
+    bool const exited = c.State == cxsysProcess_State_Exited;
+    int const state = cxsysProcess_GetState(cps[i]);
+    if (state != c.State) {
+      std::cerr << "error: child '" << c.Text << "' ended in state "
+                << state << ", expected " << c.State << "\n";
+      if (state == cxsysProcess_State_Error) {
+        std::cerr << cxsysProcess_GetErrorString(cps[i]) << "\n";
+      }
+      ++failed;
+    }
+    if (outs[i] != c.Text || errs[i] != (exited? c.Text : "")) {
+      std::cerr << "error: child '" << c.Text << "' wrote '" << outs[i]
+                << "' and '" << errs[i] << "'\n";
+      ++failed;
+    }
+    cxsysProcess_Delete(cps[i]);
+  }
+
+  // The children run concurrently, so the group takes about as long
+  // as the longest timeout rather than the sum of the sleeps.
+  if (seconds > 10) {
+    std::cerr << "error: the group took " << seconds << " s\n";
+    ++failed;
+  }
+  return failed? 1 : 0;
+}
@@ -0,0 +1,118 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Measure throughput of the castxml reader and of libxml2 on the same
+// files.  Usage: reader-bench [-n <iterations>] <file.xml>...
+
+#include "Reader.h"
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+typedef std::chrono::steady_clock Clock;
+
+//----------------------------------------------------------------------------
+static double seconds(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//----------------------------------------------------------------------------
+static void report(const char* name, size_t bytes, size_t elements,
+                   double secs)
+{
+  std::cout << "  " << name << ": " << elements << " elements, "
+            << (bytes / secs / 1e9) << " GB/s\n";
+}
+
+//----------------------------------------------------------------------------
+static size_t countElements(xmlNodePtr n)
+{
+  size_t count = 0;
+  for (; n; n = n->next) {
+    if (n->type == XML_ELEMENT_NODE) {
+      count += 1 + countElements(n->children);
+    }
+  }
+  return count;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, const char* argv[])
+{
+  int iterations = 5;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-n") == 0 && (i+1) < argc) {
+      iterations = atoi(argv[++i]);
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+  if (files.empty() || iterations < 1) {
+    std::cerr << "usage: reader-bench [-n <iterations>] <file.xml>...\n";
+    return 1;
+  }
+
+  xmlInitParser();
+  for (std::vector<std::string>::const_iterator f = files.begin();
+       f != files.end(); ++f) {
+    std::cout << *f << ":\n";
+
+    size_t elements = 0;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      Reader r;
+      std::string error;
+      if (!r.Open(*f, error)) {
+        std::cerr << "error: " << error << "\n";
+        return 1;
+      }
+      elements = r.GetElements().size();
+    }
+    double castxmlSecs = seconds(start);
+
+    size_t libxmlElements = 0;
+    start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      xmlDocPtr doc = xmlReadFile(f->c_str(), 0, XML_PARSE_NONET |
+                                  XML_PARSE_HUGE | XML_PARSE_COMPACT);
+      if (!doc) {
+        std::cerr << "error: libxml2 could not parse " << *f << "\n";
+        return 1;
+      }
+      libxmlElements = countElements(xmlDocGetRootElement(doc));
+      xmlFreeDoc(doc);
+    }
+    double libxmlSecs = seconds(start);
+
+    std::ifstream fin(f->c_str(), std::ios::in | std::ios::binary);
+    fin.seekg(0, std::ios::end);
+    size_t size = static_cast<size_t>(fin.tellg());
+    report("castxml-reader", size * iterations, elements, castxmlSecs);
+    report("libxml2", size * iterations, libxmlElements, libxmlSecs);
+  }
+  xmlCleanupParser();
+  return 0;
+}
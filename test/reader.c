@@ -0,0 +1,82 @@
+#include "castxml_reader.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static void print(castxml_string s)
+{
+  fwrite(s.data, 1, s.size, stdout);
+}
+
+int main(int argc, const char* argv[])
+{
+  castxml_reader* r;
+  unsigned int e;
+  unsigned int depth = 0;
+  int i;
+  if (argc < 2) {
+    fprintf(stderr, "usage: reader <file> [<id>...]\n");
+    return 1;
+  }
+  r = castxml_reader_open(argv[1]);
+  if (castxml_reader_error(r)) {
+    fprintf(stderr, "error: %s\n", castxml_reader_error(r));
+    castxml_reader_free(r);
+    return 1;
+  }
+
+  /* Print the element tree with the number of attributes of each.  */
+  e = 0;
+  while (e != CASTXML_READER_NONE) {
+    unsigned int next;
+    unsigned int d;
+    for (d = 0; d < depth; ++d) {
+      fputs("  ", stdout);
+    }
+    print(castxml_reader_element_tag(r, e));
+    printf(" %u\n", castxml_reader_attribute_count(r, e));
+    next = castxml_reader_element_first_child(r, e);
+    if (next != CASTXML_READER_NONE) {
+      ++depth;
+    } else {
+      while (e != CASTXML_READER_NONE &&
+             (next = castxml_reader_element_next_sibling(r, e)) ==
+             CASTXML_READER_NONE) {
+        e = castxml_reader_element_parent(r, e);
+        --depth;
+      }
+    }
+    e = next;
+  }
+
+  /* Look up the given ids and print their names.  */
+  for (i = 2; i < argc; ++i) {
+    castxml_string id;
+    castxml_string name;
+    char buf[64];
+    size_t n;
+    id.data = argv[i];
+    id.size = strlen(argv[i]);
+    e = castxml_reader_find_id(r, id);
+    if (e == CASTXML_READER_NONE) {
+      printf("%s: none\n", argv[i]);
+      continue;
+    }
+    name = castxml_reader_get_attribute(r, e, "name");
+    if (!name.data) {
+      printf("%s: (no name)\n", argv[i]);
+      continue;
+    }
+    /* The result is null-terminated only if it fits.  */
+    n = castxml_reader_decode(name, buf, sizeof(buf));
+    if (n >= sizeof(buf)) {
+      fprintf(stderr, "error: name of %s does not fit\n", argv[i]);
+      castxml_reader_free(r);
+      return 1;
+    }
+    printf("%s: %s\n", argv[i], buf);
+  }
+
+  castxml_reader_free(r);
+  return 0;
+}
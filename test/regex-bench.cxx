@@ -0,0 +1,239 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Measure the time cxsys::RegularExpression takes to search qualified
+// C++ names and header paths with each of its engines, and check that
+// the engines find the same matches.  Usage:
+//   regex-bench [-n <iterations>] [<file>]
+// Each line of the file is searched.  Without a file thousands of names
+// and paths are generated.
+
+#include <cxsys/RegularExpression.hxx>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+typedef std::chrono::steady_clock Clock;
+typedef cxsys::RegularExpression RegEx;
+
+static const char* const patterns[] = {
+  "^std::",
+  "::basic_string<",
+  "^(std|boost)::([a-z_]+)<",
+  "^([a-z_]+::)+([A-Za-z_]+)<",
+  "::([a-z_]+)<[^<>]*>::iterator$",
+  "(vector|map|set)<.*(int|char)",
+  "^/usr/(lib/llvm-[0-9.]+/)?include/",
+  "/(bits|sys)/[^/]+\\.h$",
+  "\\.(h|hxx|hpp)$",
+  0
+};
+
+//----------------------------------------------------------------------------
+static double seconds(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//----------------------------------------------------------------------------
+template <size_t N>
+static const char* pick(const char* const (&words)[N], unsigned& seed)
+{
+  seed = seed * 1103515245 + 12345;
+  return words[(seed >> 16) % N];
+}
+
+//----------------------------------------------------------------------------
+static std::string generateType(unsigned& seed, int depth)
+{
+  static const char* const namespaces[] = {
+    "std", "boost", "llvm", "clang", "cxsys", "__gnu_cxx", "detail"
+  };
+  static const char* const templates[] = {
+    "vector", "basic_string", "map", "set", "shared_ptr", "allocator",
+    "char_traits", "unordered_map", "SmallVector", "DenseMap"
+  };
+  static const char* const scalars[] = {
+    "int", "char", "unsigned long", "double", "bool", "void*"
+  };
+  std::string type = pick(namespaces, seed);
+  type += "::";
+  type += pick(templates, seed);
+  type += "<";
+  if (depth > 0 && (seed & 0x100)) {
+    type += generateType(seed, depth - 1);
+  } else {
+    type += pick(scalars, seed);
+  }
+  type += ">";
+  return type;
+}
+
+//----------------------------------------------------------------------------
+static void generate(std::vector<std::string>& lines)
+{
+  static const char* const members[] = {
+    "iterator", "size_type", "value_type", "begin", "operator==", "find"
+  };
+  static const char* const roots[] = {
+    "/usr/include", "/usr/include/c++/4.9", "/usr/lib/llvm-3.6/include",
+    "/usr/local/include", "/opt/local/include"
+  };
+  static const char* const dirs[] = {
+    "bits", "sys", "clang/AST", "llvm/ADT", "boost/detail", "cxsys"
+  };
+  static const char* const files[] = {
+    "stl_vector", "types", "Decl", "SmallVector", "shared_ptr", "Process"
+  };
+  static const char* const exts[] = {
+    ".h", ".hxx", ".hpp", ".def", ".inc", ""
+  };
+  unsigned seed = 1;
+  for (int i = 0; i < 10000; ++i) {
+    std::string name = generateType(seed, 3);
+    name += "::";
+    name += pick(members, seed);
+    lines.push_back(name);
+
+    std::string path = pick(roots, seed);
+    path += "/";
+    path += pick(dirs, seed);
+    path += "/";
+    path += pick(files, seed);
+    path += pick(exts, seed);
+    lines.push_back(path);
+  }
+}
+
+//----------------------------------------------------------------------------
+static bool sameMatch(RegEx& a, RegEx& b, std::string const& line)
+{
+  bool found = a.find(line);
+  if (found != b.find(line)) {
+    return false;
+  }
+  for (int n = 0; found && n < RegEx::NSUBEXP; ++n) {
+    if (a.match(n) != b.match(n)) {
+      return false;
+    }
+  }
+  return !found || (a.start() == b.start() && a.end() == b.end());
+}
+
+//----------------------------------------------------------------------------
+static double search(RegEx& re, std::vector<std::string> const& lines,
+                     int iterations, size_t& matches)
+{
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    matches = 0;
+    for (std::vector<std::string>::const_iterator l = lines.begin();
+         l != lines.end(); ++l) {
+      matches += re.find(*l) ? 1 : 0;
+    }
+  }
+  return seconds(start);
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, const char* argv[])
+{
+  int iterations = 5;
+  const char* file = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-n") == 0 && (i+1) < argc) {
+      iterations = atoi(argv[++i]);
+    } else if (!file) {
+      file = argv[i];
+    } else {
+      iterations = 0;
+    }
+  }
+  if (iterations < 1) {
+    std::cerr << "usage: regex-bench [-n <iterations>] [<file>]\n";
+    return 1;
+  }
+
+  std::vector<std::string> lines;
+  if (file) {
+    std::ifstream fin(file);
+    std::string line;
+    while (std::getline(fin, line)) {
+      lines.push_back(line);
+    }
+    if (lines.empty()) {
+      std::cerr << "error: no lines in " << file << "\n";
+      return 1;
+    }
+  } else {
+    generate(lines);
+  }
+
+  std::cout << lines.size() << " lines, " << iterations
+            << " iterations (default, backtracking, automaton seconds):\n";
+  for (const char* const* p = patterns; *p; ++p) {
+    RegEx automatic(*p);
+    RegEx back(*p);
+    RegEx automaton(*p);
+    back.set_engine(RegEx::BACKTRACKING);
+    automaton.set_engine(RegEx::AUTOMATON);
+    for (std::vector<std::string>::const_iterator l = lines.begin();
+         l != lines.end(); ++l) {
+      if (!sameMatch(back, automaton, *l)) {
+        std::cerr << "error: engines differ on '" << *p << "' in '"
+                  << *l << "'\n";
+        return 1;
+      }
+    }
+
+    size_t matches;
+    double automaticSecs = search(automatic, lines, iterations, matches);
+    double backSecs = search(back, lines, iterations, matches);
+    double automatonSecs = search(automaton, lines, iterations, matches);
+    std::cout << "  " << *p << ": " << matches << " matches, "
+              << automaticSecs << " s, " << backSecs << " s, "
+              << automatonSecs << " s\n";
+  }
+
+  // Nested repetitions make backtracking take exponential time on
+  // strings that almost match.
+  const char* nested = "^(a+)+$";
+  std::cout << "  " << nested << " on a...ab:\n";
+  for (size_t n = 8; n <= 20; n += 4) {
+    std::string line(n, 'a');
+    line += "b";
+    RegEx back(nested);
+    RegEx automaton(nested);
+    back.set_engine(RegEx::BACKTRACKING);
+    automaton.set_engine(RegEx::AUTOMATON);
+    if (!sameMatch(back, automaton, line)) {
+      std::cerr << "error: engines differ on '" << nested << "'\n";
+      return 1;
+    }
+    std::vector<std::string> one(1, line);
+    size_t matches;
+    double backSecs = search(back, one, 1, matches);
+    double automatonSecs = search(automaton, one, 1, matches);
+    std::cout << "    n = " << n << ": " << backSecs << " s, "
+              << automatonSecs << " s\n";
+  }
+  return 0;
+}
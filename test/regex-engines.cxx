@@ -0,0 +1,212 @@
+/*
+  Copyright Kitware, Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Check that each cxsys::RegularExpression engine finds the expected
+// match and first submatch, on patterns in the style of the tests of
+// the original regexp(3) library, including ones that do not match and
+// anchored ones, and that the engines agree on every submatch.
+
+#include <cxsys/RegularExpression.hxx>
+
+#include <iostream>
+#include <string>
+
+typedef cxsys::RegularExpression RegEx;
+
+struct Case
+{
+  const char* Pattern;
+  const char* String;
+  const char* Match;     // The whole match, or 0 for none.
+  const char* Sub;       // The first submatch, or 0 if none or empty.
+};
+
+static Case const cases[] = {
+  // Literals and the "must appear" string.
+  { "abc", "abc", "abc", 0 },
+  { "abc", "xbc", 0, 0 },
+  { "abc", "axc", 0, 0 },
+  { "abc", "xabcy", "abc", 0 },
+  { "abc", "ababc", "abc", 0 },
+  { "abc", "", 0, 0 },
+  { "x*abc", "ababc", "abc", 0 },
+  { "a*bcd", "xaabcabcd", "abcd", 0 },
+  { ".*::iterator", "std::vector<int>::iterato", 0, 0 },
+  { ".*::iterator", "std::vector<int>::iterator",
+    "std::vector<int>::iterator", 0 },
+  // Repetitions.
+  { "ab*c", "abc", "abc", 0 },
+  { "ab*bc", "abbbbc", "abbbbc", 0 },
+  { "ab+bc", "abbc", "abbc", 0 },
+  { "ab+bc", "abc", 0, 0 },
+  { "ab+bc", "abq", 0, 0 },
+  { "ab?bc", "abc", "abc", 0 },
+  { "ab?c", "abbbbc", 0, 0 },
+  { "a.*c", "axyzc", "axyzc", 0 },
+  { "a.*c", "axyzd", 0, 0 },
+  // Anchors.
+  { "^abc$", "abc", "abc", 0 },
+  { "^abc$", "abcc", 0, 0 },
+  { "^abc", "abcc", "abc", 0 },
+  { "^abc$", "aabc", 0, 0 },
+  { "abc$", "aabc", "abc", 0 },
+  { "abc$", "abcx", 0, 0 },
+  { "^", "abc", "", 0 },
+  { "$", "abc", "", 0 },
+  { "^$", "", "", 0 },
+  { "^$", "a", 0, 0 },
+  { "^std::", "boost::std::x", 0, 0 },
+  { "^(a+)+$", "aaaaaaaaaaaaaaaaaaaab", 0, 0 },
+  { "^(a+)+$", "aaaa", "aaaa", "aaaa" },
+  // Classes.
+  { "a[bc]d", "abd", "abd", 0 },
+  { "a[b-d]e", "ace", "ace", 0 },
+  { "a[b-d]", "aac", "ac", 0 },
+  { "a[-b]", "a-", "a-", 0 },
+  { "a]", "a]", "a]", 0 },
+  { "a[]]b", "a]b", "a]b", 0 },
+  { "a[^bc]d", "aed", "aed", 0 },
+  { "a[^bc]d", "abd", 0, 0 },
+  { "a[^-b]c", "a-c", 0, 0 },
+  { "a[^]b]c", "adc", "adc", 0 },
+  { "/(bits|sys)/[^/]+\\.h$", "/usr/include/bits/types.h",
+    "/bits/types.h", "bits" },
+  { "/(bits|sys)/[^/]+\\.h$", "/usr/include/bits/x/types.h", 0, 0 },
+  // Alternation and groups.
+  { "ab|cd", "abc", "ab", 0 },
+  { "ab|cd", "abcd", "ab", 0 },
+  { "ab|cd", "xcd", "cd", 0 },
+  { "ab|cd", "xyz", 0, 0 },
+  { "()ef", "def", "ef", "" },
+  { "$b", "b", 0, 0 },
+  { "a\\(b", "a(b", "a(b", 0 },
+  { "((a))", "abc", "a", "a" },
+  { "(a)b(c)", "abc", "abc", "a" },
+  { "a+b+c", "aabbabc", "abc", 0 },
+  { "(a+|b)*", "ab", "ab", "b" },
+  { "(a+|b)+", "ab", "ab", "b" },
+  { "(a+|b)?", "ab", "a", "a" },
+  { "[^ab]*", "cde", "cde", 0 },
+  { "(ab|cd)e", "abcde", "cde", "cd" },
+  { "(a|b)c*d", "abcd", "bcd", "b" },
+  { "(ab|ab*)bc", "abc", "abc", "a" },
+  { "a([bc]*)c*", "abc", "abc", "bc" },
+  { "a([bc]*)(c*d)", "abcd", "abcd", "bc" },
+  { "a([bc]+)(c*d)", "abcd", "abcd", "bc" },
+  { "a([bc]*)(c+d)", "abcd", "abcd", "b" },
+  { "a[bcd]*dcdcde", "adcdcde", "adcdcde", 0 },
+  { "a[bcd]+dcdcde", "adcdcde", 0, 0 },
+  { "(ab|a)b*c", "abc", "abc", "ab" },
+  { "[a-zA-Z_][a-zA-Z0-9_]*", "alpha", "alpha", 0 },
+  { "^a(bc+|b[eh])g|.h$", "abh", "bh", 0 },
+  { "(bc+d$|ef*g.|h?i(j|k))", "effgz", "effgz", "effgz" },
+  { "(bc+d$|ef*g.|h?i(j|k))", "reffgz", "effgz", "effgz" },
+  { "(bc+d$|ef*g.|h?i(j|k))", "effg", 0, 0 },
+  { "(bc+d$|ef*g.|h?i(j|k))", "bcdd", 0, 0 },
+  { "(((((((((a)))))))))", "a", "a", "a" },
+  { "multiple words of text", "uh-uh", 0, 0 },
+  { "multiple words", "multiple words, yeah", "multiple words", 0 },
+  { "(.*)c(.*)", "abcde", "abcde", "ab" },
+  { "\\((.*), ", "(.*)\\)", 0, 0 },
+  { "[k]", "ab", 0, 0 },
+  { "abcd", "abcd", "abcd", 0 },
+  { "a(bc)d", "abcd", "abcd", "bc" },
+  { "a[-]?c", "ac", "ac", 0 },
+  { "^([a-z_]+::)+([A-Za-z_]+)<", "std::tr::shared_ptr<int>",
+    "std::tr::shared_ptr<", "tr::" },
+  { "^([a-z_]+::)+([A-Za-z_]+)<", "std::tr1::shared_ptr<int>", 0, 0 },
+  { "^([a-z_]+::)+([A-Za-z_]+)<", "std::tr1::shared_ptr", 0, 0 },
+  { 0, 0, 0, 0 }
+};
+
+//----------------------------------------------------------------------------
+static std::string show(const char* s)
+{
+  return s? "'" + std::string(s) + "'" : "no match";
+}
+
+//----------------------------------------------------------------------------
+static bool check(Case const& c, RegEx& re, const char* engine)
+{
+  bool const found = re.find(c.String);
+  std::string const match = found? re.match(0) : "";
+  std::string const sub = found? re.match(1) : "";
+  if (found == (c.Match != 0) &&
+      (!found || (match == c.Match && sub == (c.Sub? c.Sub : "")))) {
+    return true;
+  }
+  std::cerr << "error: " << engine << " finds "
+            << (found? show(match.c_str()) : show(0)) << " with "
+            << show(sub.c_str()) << " for '" << c.Pattern << "' in '"
+            << c.String << "', expected " << show(c.Match) << " with "
+            << show(c.Sub? c.Sub : "") << "\n";
+  return false;
+}
+
+//----------------------------------------------------------------------------
+static bool agree(Case const& c, RegEx& a, RegEx& b)
+{
+  bool const found = a.find(c.String);
+  if (found != b.find(c.String)) {
+    return false;
+  }
+  for (int n = 0; found && n < RegEx::NSUBEXP; ++n) {
+    // Positions are defined only for submatches that matched.
+    if (a.match(n) != b.match(n) ||
+        (!a.match(n).empty() &&
+         (a.start(n) != b.start(n) || a.end(n) != b.end(n)))) {
+      std::cerr << "error: engines differ on submatch " << n << " of '"
+                << c.Pattern << "' in '" << c.String << "'\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+int main()
+{
+  int failed = 0;
+  for (Case const* c = cases; c->Pattern; ++c) {
+    RegEx back(c->Pattern);
+    RegEx automaton(c->Pattern);
+    RegEx automatic(c->Pattern);
+    if (!back.is_valid()) {
+      std::cerr << "error: cannot compile '" << c->Pattern << "'\n";
+      ++failed;
+      continue;
+    }
+    back.set_engine(RegEx::BACKTRACKING);
+    automaton.set_engine(RegEx::AUTOMATON);
+    if (!check(*c, back, "backtracking") ||
+        !check(*c, automaton, "automaton") ||
+        !check(*c, automatic, "default engine") ||
+        !agree(*c, back, automaton)) {
+      ++failed;
+    }
+  }
+
+  // The default engine gives up backtracking where it would take time
+  // exponential in the length of the string, and uses the automaton.
+  Case const blowup = {
+    "^(a+)+$", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab", 0, 0
+  };
+  RegEx automatic(blowup.Pattern);
+  if (!check(blowup, automatic, "default engine")) {
+    ++failed;
+  }
+  return failed? 1 : 0;
+}
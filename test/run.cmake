@@ -18,13 +18,23 @@ cmake_minimum_required(VERSION 2.8.5)
 if(xml)
   file(REMOVE "${xml}")
 endif()
+if(json)
+  file(REMOVE "${json}")
+endif()
 
 if(prologue)
   include(${prologue})
 endif()
 
+if(input_file)
+  set(maybe_input_file INPUT_FILE "${input_file}")
+else()
+  set(maybe_input_file)
+endif()
+
 execute_process(
   COMMAND ${command}
+  ${maybe_input_file}
   OUTPUT_VARIABLE actual_stdout
   ERROR_VARIABLE actual_stderr
   RESULT_VARIABLE actual_result
@@ -39,6 +49,13 @@ if(xml)
   else()
     set(actual_xml "(missing)")
   endif()
+elseif(json)
+  set(maybe_xml json)
+  if(EXISTS "${json}")
+    file(READ "${json}" actual_json)
+  else()
+    set(actual_json "(missing)")
+  endif()
 else()
   set(maybe_xml)
 endif()
@@ -75,6 +92,10 @@ foreach(o result stdout stderr ${maybe_xml})
   endif()
 endforeach()
 
+if(epilogue)
+  include(${epilogue})
+endif()
+
 if(msg)
   if("$ENV{TEST_UPDATE}" AND expect_xml_file AND EXISTS "${xml}")
     set(update_xml "${actual_xml}")
@@ -0,0 +1,15 @@
+# Pack a copy of the input into an archive and remove the copy so that
+# the tested run can read it only from the archive.
+file(REMOVE_RECURSE "${vfs_dir}")
+file(MAKE_DIRECTORY "${vfs_dir}")
+configure_file("${vfs_input}" "${vfs_dir}/Field.cxx" COPYONLY)
+execute_process(
+  COMMAND ${castxml} --castxml-vfs-pack "${vfs_archive}" "${vfs_dir}"
+  RESULT_VARIABLE pack_result
+  OUTPUT_QUIET
+  ERROR_QUIET
+  )
+file(REMOVE_RECURSE "${vfs_dir}")
+if(NOT pack_result EQUAL 0 OR NOT EXISTS "${vfs_archive}")
+  message(FATAL_ERROR "Could not pack archive '${vfs_archive}'")
+endif()
@@ -0,0 +1,54 @@
+# Run castxml in watch mode on a source in a scratch directory while a
+# second process edits the header it includes.  The second process
+# checks that the output follows the edit and then removes the
+# directory, after which castxml has nothing left to watch and exits.
+if(edit)
+  macro(wait_for_output pattern)
+    set(found 0)
+    foreach(i RANGE 300)
+      if(EXISTS "${dir}/watch.xml")
+        file(READ "${dir}/watch.xml" xml)
+        if("${xml}" MATCHES "${pattern}")
+          set(found 1)
+          break()
+        endif()
+      endif()
+      # Write the header again until castxml has started watching it.
+      if(header)
+        file(WRITE "${dir}/watch.h" "${header}")
+      endif()
+      execute_process(COMMAND ${CMAKE_COMMAND} -E sleep 0.1)
+    endforeach()
+    if(NOT found)
+      message(FATAL_ERROR "Output matching '${pattern}' not written.")
+    endif()
+  endmacro()
+
+  set(header)
+  wait_for_output("name=\"before\"")
+  message(STATUS "watch: output written")
+
+  set(header "namespace start { int before; int after; }\n")
+  wait_for_output("name=\"after\"")
+  message(STATUS "watch: output updated after editing the header")
+
+  file(REMOVE_RECURSE "${dir}")
+  message(STATUS "watch: removed the watched directory")
+  return()
+endif()
+
+file(REMOVE_RECURSE "${dir}")
+file(MAKE_DIRECTORY "${dir}")
+file(WRITE "${dir}/watch.h" "namespace start { int before; }\n")
+file(WRITE "${dir}/watch.cxx" "#include \"watch.h\"\n")
+execute_process(
+  COMMAND ${castxml} --castxml-watch --castxml-gccxml --castxml-start start
+          -std=c++98 ${dir}/watch.cxx -o ${dir}/watch.xml
+  COMMAND ${CMAKE_COMMAND} -Dedit=1 -Ddir=${dir}
+          -P ${CMAKE_CURRENT_LIST_FILE}
+  RESULT_VARIABLE result
+  TIMEOUT 60
+  )
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "Editing while watching failed: ${result}")
+endif()